@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+/*
+  Measures the trade-offs of the table layout options on a scratch database
+  directory, which is removed and recreated for every run:
+
+    sharemind-tabledb-hdf5-benchmark <directory> chunking [rows [columns [batch]]]
+
+  inserts the rows in column batches of the given number of rows into a table
+  of uint64 columns with the vertical and with the row-block chunk layout,
+  then reads a single column and all columns back on a reopened connection.
+
+    sharemind-tabledb-hdf5-benchmark <directory> templates [tables [columns]]
+
+  creates the given number of tables of uint64 columns with the same schema,
+  with the table templates disabled and enabled.
+*/
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <LogHard/Backend.h>
+#include <LogHard/CFileAppender.h>
+#include <LogHard/Logger.h>
+#include <memory>
+#include <new>
+#include <sharemind/mod_tabledb/TdbTypesUtil.h>
+#include <string>
+#include <vector>
+#include "TdbHdf5Connection.h"
+#include "TdbHdf5ConnectionConf.h"
+
+
+namespace fs = boost::filesystem;
+
+#define CHUNKING_BATCH         (1000u)
+#define CHUNKING_COLUMNS       (8u)
+#define CHUNKING_ROWS          (1000000u)
+#define TABLE_NAME             "benchmark"
+#define TEMPLATES_COLUMNS      (8u)
+#define TEMPLATES_TABLES       (1000u)
+
+namespace {
+
+using sharemind::TdbHdf5Connection;
+using sharemind::TdbHdf5ConnectionConf;
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(const Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void check(const SharemindTdbError ecode, const char * const operation) {
+    if (ecode == SHAREMIND_TDB_OK)
+        return;
+
+    std::cerr << "Failed to " << operation << " (error " << ecode << ")."
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+}
+
+std::uint64_t argument(const int argc,
+                       char ** const argv,
+                       const int index,
+                       const std::uint64_t defaultValue)
+{
+    return argc > index ? std::strtoull(argv[index], nullptr, 10) : defaultValue;
+}
+
+/* Writes the configuration of a fresh database directory: */
+std::string configure(const fs::path & dir, const std::string & extra) {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    const std::string confPath(dir.string() + ".conf");
+    std::ofstream conf(confPath.c_str());
+    conf << "DatabasePath = " << dir.string() << '\n' << extra;
+    return confPath;
+}
+
+std::unique_ptr<TdbHdf5Connection> connect(const LogHard::Logger & logger,
+                                           const fs::path & dir,
+                                           const std::string & confPath)
+{
+    return std::unique_ptr<TdbHdf5Connection>(
+            new TdbHdf5Connection(logger,
+                                  dir,
+                                  TdbHdf5ConnectionConf(confPath)));
+}
+
+/* Column names and types of a table of uint64 columns: */
+class Schema {
+
+public: /* Methods: */
+
+    explicit Schema(const std::size_t columns) {
+        for (std::size_t i = 0u; i < columns; ++i) {
+            const std::string name("c" + std::to_string(i));
+            m_names.emplace_back(SharemindTdbString_new(name.c_str()));
+            m_types.emplace_back(SharemindTdbType_new("public", "uint64", 8u));
+        }
+    }
+
+    ~Schema() {
+        for (auto * const name : m_names)
+            SharemindTdbString_delete(name);
+        for (auto * const type : m_types)
+            SharemindTdbType_delete(type);
+    }
+
+    Schema(const Schema &) = delete;
+    Schema & operator=(const Schema &) = delete;
+
+    const std::vector<SharemindTdbString *> & names() const noexcept
+    { return m_names; }
+    const std::vector<SharemindTdbType *> & types() const noexcept
+    { return m_types; }
+
+private: /* Fields: */
+
+    std::vector<SharemindTdbString *> m_names;
+    std::vector<SharemindTdbType *> m_types;
+
+}; /* class Schema { */
+
+void insertColumns(TdbHdf5Connection & conn,
+                   const std::size_t columns,
+                   const std::uint64_t firstRow,
+                   const std::uint64_t rows)
+{
+    std::vector<std::vector<SharemindTdbValue *> > valuesBatch(1u);
+    auto & values = valuesBatch.front();
+
+    for (std::size_t c = 0u; c < columns; ++c) {
+        const std::size_t size = rows * sizeof(std::uint64_t);
+        auto * const buffer = static_cast<std::uint64_t *>(::operator new(size));
+        for (std::uint64_t r = 0u; r < rows; ++r)
+            buffer[r] = (firstRow + r) * columns + c;
+        values.emplace_back(
+                SharemindTdbValue_new("public", "uint64", 8u, buffer, size));
+    }
+
+    const SharemindTdbError ecode = conn.insertRow(
+            nullptr,
+            TABLE_NAME,
+            valuesBatch,
+            std::vector<bool>(1u, true),
+            std::vector<std::vector<TdbHdf5Connection::size_type> >(1u));
+
+    for (auto * const value : values)
+        SharemindTdbValue_delete(value);
+
+    check(ecode, "insert rows");
+}
+
+void readColumns(TdbHdf5Connection & conn,
+                 const std::size_t first,
+                 const std::size_t count)
+{
+    std::vector<SharemindTdbIndex *> colIdBatch;
+    for (std::size_t c = first; c < first + count; ++c)
+        colIdBatch.emplace_back(SharemindTdbIndex_new(c));
+
+    std::vector<std::vector<SharemindTdbValue *> > valuesBatch;
+    const SharemindTdbError ecode =
+            conn.readColumn(nullptr, TABLE_NAME, colIdBatch, valuesBatch);
+
+    for (auto * const colId : colIdBatch)
+        SharemindTdbIndex_delete(colId);
+    for (auto const & values : valuesBatch) {
+        for (auto * const value : values)
+            SharemindTdbValue_delete(value);
+    }
+
+    check(ecode, "read columns");
+}
+
+int benchmarkChunking(const LogHard::Logger & logger,
+                      const fs::path & dir,
+                      const std::uint64_t rows,
+                      const std::size_t columns,
+                      const std::uint64_t batch)
+{
+    const Schema schema(columns);
+
+    std::cout << "chunking   insert (s)  rows/s      1 column (s)  "
+                 "all columns (s)  file (MiB)" << std::endl;
+
+    typedef TdbHdf5Connection::ChunkLayout ChunkLayout;
+    for (const ChunkLayout layout : {ChunkLayout::Columns, ChunkLayout::Rows}) {
+        const std::string confPath(configure(dir, std::string()));
+
+        double insertTime = 0.0;
+        {
+            auto conn(connect(logger, dir, confPath));
+
+            TdbHdf5Connection::TableOptions options;
+            options.chunkLayout = layout;
+            check(conn->tblCreate(nullptr,
+                                  TABLE_NAME,
+                                  schema.names(),
+                                  schema.types(),
+                                  options),
+                  "create table");
+
+            const Clock::time_point start(Clock::now());
+            for (std::uint64_t row = 0u; row < rows; row += batch)
+                insertColumns(*conn, columns, row, std::min(batch, rows - row));
+            insertTime = secondsSince(start);
+        }
+
+        // Read on a new connection, with no table file or chunk cached
+        double columnTime = 0.0;
+        double tableTime = 0.0;
+        {
+            auto conn(connect(logger, dir, confPath));
+
+            Clock::time_point start(Clock::now());
+            readColumns(*conn, columns / 2u, 1u);
+            columnTime = secondsSince(start);
+
+            start = Clock::now();
+            readColumns(*conn, 0u, columns);
+            tableTime = secondsSince(start);
+        }
+
+        const double fileSize =
+                static_cast<double>(fs::file_size(dir / (TABLE_NAME ".h5")))
+                / 1048576.0;
+
+        std::cout << std::left << std::setw(11)
+                  << (layout == ChunkLayout::Columns ? "columns" : "rows")
+                  << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << insertTime
+                  << std::setw(12) << std::setprecision(0)
+                  << static_cast<double>(rows) / insertTime
+                  << std::setw(14) << std::setprecision(3) << columnTime
+                  << std::setw(17) << tableTime
+                  << std::setw(12) << std::setprecision(1) << fileSize
+                  << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int benchmarkTemplates(const LogHard::Logger & logger,
+                       const fs::path & dir,
+                       const std::uint64_t tables,
+                       const std::size_t columns)
+{
+    const Schema schema(columns);
+
+    std::cout << "templates  create (s)  tables/s" << std::endl;
+
+    for (const bool templates : {false, true}) {
+        const std::string confPath(
+                configure(dir,
+                          templates ? "TableTemplates = true\n"
+                                    : "TableTemplates = false\n"));
+        auto conn(connect(logger, dir, confPath));
+
+        const Clock::time_point start(Clock::now());
+        for (std::uint64_t i = 0u; i < tables; ++i) {
+            check(conn->tblCreate(nullptr,
+                                  TABLE_NAME + std::to_string(i),
+                                  schema.names(),
+                                  schema.types(),
+                                  TdbHdf5Connection::TableOptions()),
+                  "create table");
+        }
+        const double createTime = secondsSince(start);
+
+        std::cout << std::left << std::setw(11) << (templates ? "on" : "off")
+                  << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << createTime
+                  << std::setw(10) << std::setprecision(0)
+                  << static_cast<double>(tables) / createTime
+                  << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+} /* namespace { */
+
+int main(int argc, char * argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <directory> chunking [rows [columns [batch]]]\n"
+                  << "       " << argv[0]
+                  << " <directory> templates [tables [columns]]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto backend(std::make_shared<LogHard::Backend>());
+    backend->addAppender(std::make_shared<LogHard::CFileAppender>(stderr));
+    const LogHard::Logger logger(backend, "[Benchmark]");
+
+    const fs::path dir(fs::absolute(argv[1]));
+
+    try {
+        if (std::strcmp(argv[2], "chunking") == 0) {
+            const std::uint64_t batch = argument(argc, argv, 5, CHUNKING_BATCH);
+            if (!batch) {
+                std::cerr << "The batch must have at least one row."
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            return benchmarkChunking(logger,
+                                     dir,
+                                     argument(argc, argv, 3, CHUNKING_ROWS),
+                                     argument(argc, argv, 4, CHUNKING_COLUMNS),
+                                     batch);
+        }
+
+        if (std::strcmp(argv[2], "templates") == 0)
+            return benchmarkTemplates(logger,
+                                      dir,
+                                      argument(argc, argv, 3, TEMPLATES_TABLES),
+                                      argument(argc, argv, 4, TEMPLATES_COLUMNS));
+    } catch (const std::exception & e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cerr << "Unknown benchmark \"" << argv[2] << "\"." << std::endl;
+    return EXIT_FAILURE;
+}
@@ -21,19 +21,36 @@
 #define SHAREMINDCOMMON_KEYVALUECACHE_H
 
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <sharemind/DebugOnly.h>
+#include <thread>
 #include <utility>
+#include <vector>
 
 
 namespace sharemind {
 
+/*
+  Caches values by key for as long as they are referenced. Optionally, values
+  can be retained for a while after the last reference to them has been
+  dropped, so that they need not be reconstructed when requested again
+  shortly after. Retained values are released by a background thread when
+  their retention period has expired, or when more than the given maximum
+  number of values are retained, in which case the ones expiring first are
+  released.
+*/
 template<typename K, typename V>
 class KeyValueCache {
 
+public: /* Types: */
+
+    using Clock = std::chrono::steady_clock;
+
 private: /* Types: */
 
     class Inner {
@@ -66,28 +83,89 @@ private: /* Types: */
 
         };
 
-        using ValuePtr = std::pair<V *, std::weak_ptr<V> >;
+        /* Deleter of the references given out, handing the owning reference
+           back to the cache when the last of them is dropped: */
+        class ReleaseActor {
+
+        public: /* Methods: */
+
+            ReleaseActor(ReleaseActor &&) noexcept = default;
+            ReleaseActor(ReleaseActor const &) noexcept = default;
+
+            ReleaseActor(std::weak_ptr<Inner> cache,
+                         std::shared_ptr<V> value) noexcept
+                : m_cache(std::move(cache))
+                , m_value(std::move(value))
+            {}
+
+            ReleaseActor & operator=(ReleaseActor &&) noexcept = default;
+            ReleaseActor & operator=(ReleaseActor const &) noexcept = default;
+
+            void operator()(V * const) noexcept {
+                if (std::shared_ptr<Inner> cache = m_cache.lock()) {
+                    cache->releaseValue(std::move(m_value));
+                } else {
+                    m_value.reset();
+                }
+            }
+
+        private: /* Fields: */
+
+            std::weak_ptr<Inner> m_cache;
+            std::shared_ptr<V> m_value;
+
+        };
+
+        struct ValuePtr {
+            V * first;
+            /* The references given out: */
+            std::weak_ptr<V> second;
+            /* The owning reference, while no references are given out: */
+            std::shared_ptr<V> retained;
+            Clock::time_point retainedUntil;
+            Clock::duration retainFor;
+        };
         using ValueMap = std::map<K, ValuePtr>;
         using DeleterMap = std::map<V *, typename ValueMap::iterator>;
 
     public: /* Methods: */
 
+        Inner(std::size_t const maxRetained) noexcept
+            : m_maxRetained(maxRetained)
+        {}
+
         template <typename ValueFactory>
         std::shared_ptr<V> get(K const & key,
                                std::shared_ptr<Inner> const & self,
-                               ValueFactory valueFactory)
+                               ValueFactory valueFactory,
+                               Clock::duration const retainFor)
         {
+            /* Released values must be destroyed only after the mutex has been
+               unlocked, because their deleter calls removePtr(): */
+            std::vector<std::shared_ptr<V> > released;
             std::lock_guard<std::mutex> lock(m_mutex);
 
+            releaseExpired(Clock::now(), released);
+
             // Check if we already have the value in cache
             {
                 auto const it(m_valueMap.find(key));
                 if (it != m_valueMap.end()) {
                     // Check if the value is valid
                     ValuePtr & valPtr = it->second;
+                    if (valPtr.retainFor < retainFor)
+                        valPtr.retainFor = retainFor;
+
                     if (auto ptr = valPtr.second.lock())
                         return ptr;
 
+                    // Hand out a value retained since its last release
+                    if (valPtr.retained) {
+                        assert(m_retainedCount > 0u);
+                        --m_retainedCount;
+                        return share(valPtr, self, std::move(valPtr.retained));
+                    }
+
                     SHAREMIND_DEBUG_ONLY(auto const c =)
                             m_deleterMap.erase(valPtr.first);
                     assert(c > 0u);
@@ -96,22 +174,144 @@ private: /* Types: */
             }
 
             // Create a new value
-            std::shared_ptr<V> ptr(valueFactory(key), DeleteActor(self));
+            std::shared_ptr<V> value(valueFactory(key), DeleteActor(self));
             auto const it(
                         m_valueMap.insert(
                             typename ValueMap::value_type(
                                 key,
-                                ValuePtr(ptr.get(), ptr))).first);
+                                ValuePtr{value.get(),
+                                         std::weak_ptr<V>(),
+                                         nullptr,
+                                         Clock::time_point(),
+                                         retainFor})).first);
             SHAREMIND_DEBUG_ONLY(auto const r =)
                     m_deleterMap.insert(
-                        typename DeleterMap::value_type(ptr.get(), it))
+                        typename DeleterMap::value_type(value.get(), it))
                     SHAREMIND_DEBUG_ONLY(.second);
             assert(r);
-            return ptr;
+            return share(it->second, self, std::move(value));
+        }
+
+        /* Releases the retained values and stops the background thread: */
+        void stop() {
+            std::vector<std::shared_ptr<V> > released;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+                for (auto & vp : m_valueMap)
+                    if (vp.second.retained)
+                        release(vp.second, released);
+            }
+
+            m_condition.notify_all();
+            if (m_releaser.joinable())
+                m_releaser.join();
         }
 
     private: /* Methods: */
 
+        std::shared_ptr<V> share(ValuePtr & valPtr,
+                                 std::shared_ptr<Inner> const & self,
+                                 std::shared_ptr<V> value)
+        {
+            V * const ptr = value.get();
+            std::shared_ptr<V> shared(ptr,
+                                      ReleaseActor(self, std::move(value)));
+            valPtr.second = shared;
+            return shared;
+        }
+
+        /* Keeps the owning reference of a value no longer referenced for its
+           retention period, if any: */
+        void releaseValue(std::shared_ptr<V> value) noexcept {
+            std::vector<std::shared_ptr<V> > released;
+            try {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                auto const it(m_deleterMap.find(value.get()));
+                if (it == m_deleterMap.end())
+                    return;
+
+                ValuePtr & valPtr = it->second->second;
+                if (m_stopping
+                    || !m_maxRetained
+                    || valPtr.retainFor <= Clock::duration::zero())
+                    return;
+
+                assert(!valPtr.retained);
+                valPtr.retained = std::move(value);
+                valPtr.retainedUntil = Clock::now() + valPtr.retainFor;
+                ++m_retainedCount;
+
+                // Release the values expiring first if over the limit
+                while (m_retainedCount > m_maxRetained) {
+                    ValuePtr * first = nullptr;
+                    for (auto & vp : m_valueMap)
+                        if (vp.second.retained
+                            && (!first
+                                || vp.second.retainedUntil
+                                   < first->retainedUntil))
+                            first = &vp.second;
+                    assert(first);
+                    release(*first, released);
+                }
+
+                if (!m_releaser.joinable())
+                    m_releaser = std::thread(&Inner::releaseLoop, this);
+            } catch (...) {
+                // Without a retention, the value is released right away
+                return;
+            }
+
+            m_condition.notify_all();
+        }
+
+        /* Releases the retained values as their retention periods expire: */
+        void releaseLoop() noexcept {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_stopping) {
+                if (!m_retainedCount) {
+                    m_condition.wait(lock);
+                    continue;
+                }
+
+                std::vector<std::shared_ptr<V> > released;
+                releaseExpired(Clock::now(), released);
+                if (!released.empty()) {
+                    lock.unlock();
+                    released.clear();
+                    lock.lock();
+                    continue;
+                }
+
+                Clock::time_point until(Clock::time_point::max());
+                for (auto const & vp : m_valueMap)
+                    if (vp.second.retained && vp.second.retainedUntil < until)
+                        until = vp.second.retainedUntil;
+                m_condition.wait_until(lock, until);
+            }
+        }
+
+        void releaseExpired(Clock::time_point const now,
+                            std::vector<std::shared_ptr<V> > & released)
+        {
+            if (!m_retainedCount)
+                return;
+
+            for (auto & vp : m_valueMap)
+                if (vp.second.retained && vp.second.retainedUntil <= now)
+                    release(vp.second, released);
+        }
+
+        void release(ValuePtr & valPtr,
+                     std::vector<std::shared_ptr<V> > & released)
+        {
+            assert(valPtr.retained);
+            assert(m_retainedCount > 0u);
+            released.emplace_back(std::move(valPtr.retained));
+            --m_retainedCount;
+        }
+
         void removePtr(V * const ptr) {
             std::lock_guard<std::mutex> lock(m_mutex);
 
@@ -126,25 +326,60 @@ private: /* Types: */
     private: /* Fields: */
 
         std::mutex m_mutex;
+        std::condition_variable m_condition;
 
         ValueMap m_valueMap;
         DeleterMap m_deleterMap;
 
+        std::size_t const m_maxRetained;
+        std::size_t m_retainedCount = 0u;
+
+        bool m_stopping = false;
+        std::thread m_releaser;
+
     };
 
 public: /* Methods: */
 
+    KeyValueCache(std::size_t const maxRetained = 0u)
+        : m_inner(std::make_shared<Inner>(maxRetained))
+    {}
+
+    KeyValueCache(KeyValueCache &&) noexcept = default;
+    KeyValueCache(KeyValueCache const &) = delete;
+
+    ~KeyValueCache() noexcept {
+        if (m_inner)
+            m_inner->stop();
+    }
+
+    KeyValueCache & operator=(KeyValueCache &&) noexcept = delete;
+    KeyValueCache & operator=(KeyValueCache const &) = delete;
+
     template <typename ValueFactory>
     std::shared_ptr<V> get(K const & key, ValueFactory && valueFactory) {
+        return get(key,
+                   std::forward<ValueFactory>(valueFactory),
+                   Clock::duration::zero());
+    }
+
+    /* Like get() above, but keeps the value for at least retainFor after the
+       last reference to it has been dropped: */
+    template <typename ValueFactory>
+    std::shared_ptr<V> get(K const & key,
+                           ValueFactory && valueFactory,
+                           Clock::duration const retainFor)
+    {
         assert(m_inner);
         return m_inner->get(key,
                             m_inner,
-                            std::forward<ValueFactory>(valueFactory));
+                            std::forward<ValueFactory>(valueFactory),
+                            retainFor);
     }
 
 private: /* Fields: */
 
-    std::shared_ptr<Inner> m_inner{std::make_shared<Inner>()};
+    std::shared_ptr<Inner> m_inner;
 
 };
 
@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "TdbHdf5Catalog.h"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+
+namespace fs = boost::filesystem;
+
+#define CATALOG_FILE           "catalog"
+#define CATALOG_TMP_FILE       "catalog.tmp"
+#define CATALOG_MAGIC          "SHTDBC02"
+#define CATALOG_MAGIC_SIZE     (8u)
+#define COMPACT_MIN_RECORDS    (1024u)
+#define FNV_OFFSET_BASIS       (UINT64_C(14695981039346656037))
+#define FNV_PRIME              (UINT64_C(1099511628211))
+#define RECORD_CLOSED          'E'
+#define RECORD_CREATE          'C'
+#define RECORD_DELETE          'D'
+#define RECORD_ROW_COUNT       'R'
+
+namespace {
+
+template <typename T>
+void appendPod(std::string & buf, const T value) {
+    static_assert(std::is_pod<T>::value, "");
+    buf.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readPod(const char *& pos, const char * const end, T & value) {
+    static_assert(std::is_pod<T>::value, "");
+    if (static_cast<std::size_t>(end - pos) < sizeof(value))
+        return false;
+    std::memcpy(&value, pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+std::string makeRecord(const char kind, const std::string & tbl) {
+    std::string record;
+    appendPod(record, kind);
+    appendPod(record, static_cast<std::uint32_t>(tbl.size()));
+    record.append(tbl);
+    return record;
+}
+
+std::string makeCreateRecord(const std::string & tbl,
+                             const sharemind::TdbHdf5Catalog::Entry & entry)
+{
+    std::string record(makeRecord(RECORD_CREATE, tbl));
+    appendPod(record, entry.schemaHash);
+    appendPod(record, entry.rowCount);
+    appendPod(record, entry.created);
+    appendPod(record, entry.modified);
+    appendPod(record, static_cast<std::uint8_t>(entry.rowCountVerified));
+    return record;
+}
+
+std::uint64_t fnv1a(std::uint64_t hash, const char * data, std::size_t size) {
+    for (; size; --size, ++data) {
+        hash ^= static_cast<unsigned char>(*data);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+bool writeAll(const int fd, const char * data, std::size_t size) {
+    while (size) {
+        const ssize_t r = ::write(fd, data, size);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += r;
+        size -= static_cast<std::size_t>(r);
+    }
+    return true;
+}
+
+} /* namespace { */
+
+namespace sharemind {
+
+TdbHdf5Catalog::TdbHdf5Catalog(const LogHard::Logger & logger,
+                               const TdbHdf5Storage & storage,
+                               const std::map<std::string, fs::path> &
+                                       containerTables)
+    : m_logger(logger, "[TdbHdf5Catalog]")
+    , m_path(storage.path() / CATALOG_FILE)
+    , m_dbPath(storage.path())
+    , m_storage(storage)
+{
+    if (!load())
+        reconcile(containerTables);
+
+    if (!writeSnapshot())
+        m_logger.error() << "Failed to write table catalog "
+                         << m_path.string() << '.';
+}
+
+TdbHdf5Catalog::~TdbHdf5Catalog() {
+    if (m_fd < 0)
+        return;
+
+    // Mark the log as complete, so that it can be trusted on the next load
+    if (m_consistent) {
+        const std::string record(makeRecord(RECORD_CLOSED, std::string()));
+        if (!writeAll(m_fd, record.data(), record.size()))
+            m_logger.warning() << "Failed to close table catalog cleanly.";
+    }
+
+    if (::close(m_fd) != 0)
+        m_logger.warning() << "Error while closing table catalog.";
+}
+
+const TdbHdf5Catalog::Entry * TdbHdf5Catalog::find(const std::string & tbl)
+        const
+{
+    auto const it(m_entries.find(tbl));
+    return it != m_entries.cend() ? &it->second : nullptr;
+}
+
+void TdbHdf5Catalog::names(const std::string & prefix,
+                           const std::size_t offset,
+                           const std::size_t limit,
+                           std::vector<std::string> & names) const
+{
+    std::size_t skip = offset;
+    for (auto it = m_entries.lower_bound(prefix);
+         it != m_entries.cend() && names.size() < limit;
+         ++it)
+    {
+        if (it->first.compare(0u, prefix.size(), prefix) != 0)
+            break;
+
+        if (skip) {
+            --skip;
+            continue;
+        }
+
+        names.emplace_back(it->first);
+    }
+}
+
+void TdbHdf5Catalog::recentNames(const std::size_t count,
+                                 std::vector<std::string> & names) const
+{
+    if (!count)
+        return;
+
+    // Keep the most recently modified tables in a min-heap
+    typedef std::pair<std::int64_t, const std::string *> Item;
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item> > recent;
+    for (auto const & vp : m_entries) {
+        recent.emplace(vp.second.modified, &vp.first);
+        if (recent.size() > count)
+            recent.pop();
+    }
+
+    const std::size_t first = names.size();
+    for (; !recent.empty(); recent.pop())
+        names.emplace_back(*recent.top().second);
+    std::reverse(names.begin() + static_cast<std::ptrdiff_t>(first),
+                 names.end());
+}
+
+void TdbHdf5Catalog::add(const std::string & tbl, const Entry & entry) {
+    m_entries[tbl] = entry;
+    append(makeCreateRecord(tbl, entry));
+}
+
+void TdbHdf5Catalog::remove(const std::string & tbl) {
+    if (!m_entries.erase(tbl))
+        return;
+    append(makeRecord(RECORD_DELETE, tbl));
+}
+
+void TdbHdf5Catalog::setRowCount(const std::string & tbl,
+                                 const std::uint64_t rowCount)
+{
+    auto const it(m_entries.find(tbl));
+    if (it == m_entries.end())
+        return;
+
+    it->second.rowCount = rowCount;
+    it->second.modified = std::time(nullptr);
+    it->second.rowCountVerified = true;
+
+    std::string record(makeRecord(RECORD_ROW_COUNT, tbl));
+    appendPod(record, rowCount);
+    appendPod(record, it->second.modified);
+    append(record);
+}
+
+void TdbHdf5Catalog::verifyRowCount(const std::string & tbl,
+                                    const std::uint64_t rowCount)
+{
+    auto const it(m_entries.find(tbl));
+    if (it == m_entries.end())
+        return;
+
+    it->second.rowCount = rowCount;
+    it->second.rowCountVerified = true;
+}
+
+std::uint64_t TdbHdf5Catalog::schemaHash(
+        const std::vector<SharemindTdbString *> & names,
+        const std::vector<SharemindTdbType *> & types)
+{
+    assert(names.size() == types.size());
+
+    std::uint64_t hash = FNV_OFFSET_BASIS;
+    for (std::size_t i = 0u; i < names.size(); ++i) {
+        const SharemindTdbType & type = *types[i];
+        hash = fnv1a(hash, names[i]->str, std::strlen(names[i]->str) + 1u);
+        hash = fnv1a(hash, type.domain, std::strlen(type.domain) + 1u);
+        hash = fnv1a(hash, type.name, std::strlen(type.name) + 1u);
+        hash = fnv1a(hash,
+                     reinterpret_cast<const char *>(&type.size),
+                     sizeof(type.size));
+    }
+
+    // Reserve 0 for unknown schemas
+    return hash ? hash : 1u;
+}
+
+bool TdbHdf5Catalog::load() {
+    std::ifstream in(m_path.string(), std::ios::binary);
+    if (!in) {
+        m_logger.fullDebug() << "No table catalog found in "
+                             << m_dbPath.string() << '.';
+        return false;
+    }
+
+    const std::string data((std::istreambuf_iterator<char>(in)),
+                           std::istreambuf_iterator<char>());
+    if (in.bad()) {
+        m_logger.warning() << "Failed to read table catalog "
+                           << m_path.string() << '.';
+        return false;
+    }
+
+    if (data.compare(0u, CATALOG_MAGIC_SIZE, CATALOG_MAGIC) != 0) {
+        m_logger.warning() << "Invalid table catalog " << m_path.string()
+                           << '.';
+        return false;
+    }
+
+    bool closed = false;
+    const char * pos = data.data() + CATALOG_MAGIC_SIZE;
+    const char * const end = data.data() + data.size();
+    while (pos != end) {
+        char kind;
+        std::uint32_t nameSize;
+        if (!readPod(pos, end, kind)
+            || !readPod(pos, end, nameSize)
+            || static_cast<std::size_t>(end - pos) < nameSize)
+            return false;
+
+        std::string tbl(pos, nameSize);
+        pos += nameSize;
+
+        closed = false;
+        switch (kind) {
+        case RECORD_CREATE: {
+            Entry entry;
+            std::uint8_t verified;
+            if (!readPod(pos, end, entry.schemaHash)
+                || !readPod(pos, end, entry.rowCount)
+                || !readPod(pos, end, entry.created)
+                || !readPod(pos, end, entry.modified)
+                || !readPod(pos, end, verified))
+                return false;
+            entry.rowCountVerified = verified;
+            m_entries[std::move(tbl)] = entry;
+            break;
+        }
+        case RECORD_DELETE:
+            m_entries.erase(tbl);
+            break;
+        case RECORD_ROW_COUNT: {
+            std::uint64_t rowCount;
+            std::int64_t modified;
+            if (!readPod(pos, end, rowCount) || !readPod(pos, end, modified))
+                return false;
+            auto const it(m_entries.find(tbl));
+            if (it != m_entries.end()) {
+                it->second.rowCount = rowCount;
+                it->second.modified = modified;
+                it->second.rowCountVerified = true;
+            }
+            break;
+        }
+        case RECORD_CLOSED:
+            closed = true;
+            break;
+        default:
+            m_logger.warning() << "Invalid record in table catalog "
+                               << m_path.string() << '.';
+            m_entries.clear();
+            return false;
+        }
+    }
+
+    return closed;
+}
+
+void TdbHdf5Catalog::reconcile(
+        const std::map<std::string, fs::path> & containerTables)
+{
+    m_logger.fullDebug() << "Rebuilding table catalog from the table files in "
+                         << m_dbPath.string() << '.';
+
+    std::map<std::string, fs::path> files(containerTables);
+    m_storage.tableFiles(files);
+
+    for (auto const & vp : files) {
+        if (m_entries.find(vp.first) == m_entries.end()) {
+            boost::system::error_code ec;
+            const std::time_t modified = fs::last_write_time(vp.second, ec);
+            m_entries.emplace(vp.first,
+                              Entry{0u,
+                                    0u,
+                                    ec ? 0 : modified,
+                                    ec ? 0 : modified,
+                                    false});
+        }
+    }
+
+    // Forget the tables whose files are gone and distrust the row counts, as
+    // the changes made after the last logged record are unknown
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (files.find(it->first) == files.end()) {
+            it = m_entries.erase(it);
+        } else {
+            it->second.rowCountVerified = false;
+            ++it;
+        }
+    }
+}
+
+bool TdbHdf5Catalog::writeSnapshot() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    std::string data(CATALOG_MAGIC, CATALOG_MAGIC_SIZE);
+    for (auto const & vp : m_entries)
+        data.append(makeCreateRecord(vp.first, vp.second));
+
+    // Replace the catalog atomically
+    const fs::path tmpPath(m_dbPath / CATALOG_TMP_FILE);
+    const int fd = ::open(tmpPath.c_str(),
+                          O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                          S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        m_consistent = false;
+        return false;
+    }
+
+    const bool written = writeAll(fd, data.data(), data.size())
+                         && ::fsync(fd) == 0;
+    if (::close(fd) != 0 || !written
+        || std::rename(tmpPath.c_str(), m_path.c_str()) != 0)
+    {
+        ::unlink(tmpPath.c_str());
+        m_consistent = false;
+        return false;
+    }
+
+    m_fd = ::open(m_path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (m_fd < 0) {
+        m_consistent = false;
+        return false;
+    }
+
+    m_records = m_entries.size();
+    m_consistent = true;
+    return true;
+}
+
+void TdbHdf5Catalog::append(const std::string & record) {
+    // Once a record is lost, the log is rebuilt on the next start anyway
+    if (!m_consistent)
+        return;
+
+    if (m_fd < 0 || !writeAll(m_fd, record.data(), record.size())) {
+        m_logger.error() << "Failed to update table catalog "
+                         << m_path.string()
+                         << ", it will be rebuilt on the next start.";
+        m_consistent = false;
+        return;
+    }
+
+    // Compact the log if it is mostly superseded records
+    if (++m_records > 2u * m_entries.size() + COMPACT_MIN_RECORDS
+        && !writeSnapshot())
+        m_logger.error() << "Failed to compact table catalog "
+                         << m_path.string() << '.';
+}
+
+} /* namespace sharemind { */
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5CATALOG_H
+#define SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5CATALOG_H
+
+#include <boost/filesystem/path.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <LogHard/Logger.h>
+#include <map>
+#include <sharemind/mod_tabledb/tdbtypes.h>
+#include <string>
+#include <vector>
+#include "TdbHdf5Storage.h"
+
+
+namespace sharemind {
+
+/*
+  Persistent index of the tables in a data source directory. The catalog is an
+  append-only log of table creations, deletions and row count changes, which is
+  loaded into memory when the connection is opened and compacted into a
+  snapshot when it grows too large. If the catalog is missing or was not closed
+  cleanly, it is reconciled with the table files in the storage paths and the
+  tables in the container file.
+*/
+class __attribute__ ((visibility("internal"))) TdbHdf5Catalog {
+
+public: /* Types: */
+
+    struct Entry {
+        std::uint64_t schemaHash; /* 0 if not known. */
+        std::uint64_t rowCount;
+        std::int64_t created; /* Seconds since the epoch. */
+        std::int64_t modified; /* Time of the last insertion, if any. */
+        bool rowCountVerified; /* Whether rowCount is known to be current. */
+    };
+
+    typedef std::map<std::string, Entry> EntryMap;
+
+public: /* Methods: */
+
+    TdbHdf5Catalog(const LogHard::Logger & logger,
+                   const TdbHdf5Storage & storage,
+                   const std::map<std::string, boost::filesystem::path> &
+                           containerTables);
+    ~TdbHdf5Catalog();
+
+    TdbHdf5Catalog(const TdbHdf5Catalog &) = delete;
+    TdbHdf5Catalog & operator=(const TdbHdf5Catalog &) = delete;
+
+    const Entry * find(const std::string & tbl) const;
+    void names(const std::string & prefix,
+               const std::size_t offset,
+               const std::size_t limit,
+               std::vector<std::string> & names) const;
+    void recentNames(const std::size_t count,
+                     std::vector<std::string> & names) const;
+
+    void add(const std::string & tbl, const Entry & entry);
+    void remove(const std::string & tbl);
+    void setRowCount(const std::string & tbl, const std::uint64_t rowCount);
+    void verifyRowCount(const std::string & tbl, const std::uint64_t rowCount);
+
+    static std::uint64_t schemaHash(
+            const std::vector<SharemindTdbString *> & names,
+            const std::vector<SharemindTdbType *> & types);
+
+private: /* Methods: */
+
+    bool load();
+    void reconcile(const std::map<std::string, boost::filesystem::path> &
+                           containerTables);
+    bool writeSnapshot();
+    void append(const std::string & record);
+
+private: /* Fields: */
+
+    const LogHard::Logger m_logger;
+
+    const boost::filesystem::path m_path;
+    const boost::filesystem::path m_dbPath;
+    const TdbHdf5Storage & m_storage;
+
+    EntryMap m_entries;
+
+    /* File descriptor of the log, opened for appending: */
+    int m_fd = -1;
+    std::size_t m_records = 0u;
+
+    /* Whether the log is known to be complete and may be closed cleanly: */
+    bool m_consistent = true;
+
+}; /* class TdbHdf5Catalog { */
+
+} /* namespace sharemind { */
+
+#endif // SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5CATALOG_H
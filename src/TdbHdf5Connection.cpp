@@ -20,38 +20,83 @@
 #include "TdbHdf5Connection.h"
 
 #include <algorithm>
+#include <atomic>
 #include <boost/filesystem.hpp>
 #include <boost/scope_exit.hpp>
+#include <cerrno>
 #include <cstring>
+#include <ctime>
+#include <fcntl.h>
 #include <H5Apublic.h>
+#include <H5Dpublic.h>
 #include <H5Epublic.h>
 #include <H5Fpublic.h>
+#include <H5FDcore.h>
+#include <H5FDsec2.h>
 #include <H5Gpublic.h>
+#include <H5Lpublic.h>
 #include <H5Opublic.h>
 #include <H5Ppublic.h>
+#include <H5public.h>
 #include <H5Spublic.h>
 #include <H5Tpublic.h>
+#include <iterator>
+#include <linux/fs.h>
+#include <limits>
 #include <memory>
 #include <set>
 #include <sharemind/Concat.h>
 #include <sharemind/mod_tabledb/TdbTypesUtil.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <system_error>
+#include <thread>
 #include <type_traits>
+#include <unistd.h>
+#include "TdbHdf5Filters.h"
+#include "TdbHdf5IoUringDriver.h"
 
 
 namespace fs = boost::filesystem;
 
-#define COL_INDEX_DATASET      "/meta/column_index"
-#define COL_INDEX_TYPE         "/meta/column_index_type"
+#if defined(SHAREMIND_TDB_HDF5_ASYNC_VOL) && H5_VERSION_GE(1,13,0)
+#include <H5VLpublic.h>
+#define ASYNC_VOL_CONNECTOR    "async"
+#endif
+
+/* Table objects are named relative to the root group of the table, which is
+   either the root group of the table file or a group in the container file: */
+#define COL_INDEX_DATASET      "meta/column_index"
+#define COL_INDEX_TYPE         "meta/column_index_type"
 #define COL_NAME_SIZE_MAX      (64u)
 #define CHUNK_SIZE             (static_cast<size_t>(4096u))
+#define COLUMN_GROUP           "columns"
+#define COMPACT_BLOCK_SIZE     (static_cast<size_t>(1048576u))
+#define DIRECT_BATCH_SIZE      (static_cast<size_t>(16777216u))
+#define DIRECT_THREAD_SIZE     (static_cast<size_t>(1048576u))
+#define ENCODED_CHUNK_SIZE     (static_cast<size_t>(65536u))
+#define COMPACT_FILE_EXT       ".compact"
+#define COPY_BUFFER_SIZE       (static_cast<size_t>(65536u))
+#define CORE_INCREMENT         (static_cast<size_t>(1048576u))
+#define CONTAINER_DELETED_GROUP "deleted"
+#define CONTAINER_FILE         "container"
+#define CONTAINER_TABLE_GROUP  "tables"
 #define DATASET_TYPE_ATTR      "type"
-#define DATASET_TYPE_ATTR_TYPE "/meta/dataset_type"
+#define DATASET_TYPE_ATTR_TYPE "meta/dataset_type"
+#define DELETED_FILE_EXT       ".deleted"
 #define ERR_MSG_SIZE_MAX       (64u)
 #define FILE_EXT               ".h5"
-#define META_GROUP             "/meta"
-#define USR_ATTR_GROUP         "/user_attributes"
+#define META_GROUP             "meta"
+#define PARTITION_ROWS_ATTR    "partition_rows"
+#define PROMOTE_FILE_EXT       ".promote"
+#define USR_ATTR_GROUP         "user_attributes"
 #define ROW_COUNT_ATTR         "row_count"
+#define TEMPLATE_DIR           "templates"
+#define TEMPORARY_DIR          "temporary"
 #define TBL_NAME_SIZE_MAX      (64u)
+#define UNCOMPACTED_FILE_EXT   ".uncompacted"
+#define VLEN_BYTES_ATTR        "bytes"
+#define VLEN_BYTES_EXT         ".bytes"
 
 extern "C" {
 
@@ -163,6 +208,241 @@ struct SharemindTdbTypeLess {
 inline bool isVariableLengthType(SharemindTdbType const * const type)
 { return !type->size; }
 
+inline fs::path partitionsPath(fs::path const & tblPath)
+{ return sharemind::TdbHdf5Storage::partitionsPath(tblPath); }
+
+inline fs::path partitionPath(fs::path const & tblPath, hsize_t const partition)
+{ return partitionsPath(tblPath) / (std::to_string(partition) + FILE_EXT); }
+
+inline std::string containerTableName(std::string const & tbl)
+{ return CONTAINER_TABLE_GROUP "/" + tbl; }
+
+inline std::string containerDeletedName(std::string const & tbl)
+{ return CONTAINER_DELETED_GROUP "/" + tbl; }
+
+/* Identifies the tables which can be copied from the same template: */
+std::string tableTemplateKey(
+        std::vector<SharemindTdbString *> const & names,
+        std::vector<SharemindTdbType *> const & types,
+        sharemind::TdbHdf5Connection::TableOptions const & options)
+{
+    assert(names.size() == types.size());
+
+    std::string key;
+    key.push_back(static_cast<char>(options.layout));
+    key.push_back(static_cast<char>(options.chunkLayout));
+    key.push_back(static_cast<char>(options.vlenLayout));
+    key.push_back(static_cast<char>(options.packBits));
+    for (auto const encoding : options.encodings)
+        key.push_back(static_cast<char>(encoding));
+    key.push_back('\0');
+    for (size_t i = 0u; i < names.size(); ++i) {
+        key.append(names[i]->str).push_back('\0');
+        key.append(types[i]->domain).push_back('\0');
+        key.append(types[i]->name).push_back('\0');
+        key.append(std::to_string(types[i]->size)).push_back('\0');
+    }
+    return key;
+}
+
+/* Copies a file, sharing the data blocks if the file system supports it: */
+bool copyFile(fs::path const & from, fs::path const & to) {
+    int const in = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return false;
+
+    BOOST_SCOPE_EXIT_ALL(in) {
+        ::close(in);
+    };
+
+    int const out = ::open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (out < 0)
+        return false;
+
+    bool copied = false;
+    #ifdef FICLONE
+    copied = ::ioctl(out, FICLONE, in) == 0;
+    #endif
+
+    if (!copied) {
+        std::vector<char> buffer(COPY_BUFFER_SIZE);
+        copied = true;
+        for (;;) {
+            ssize_t r = ::read(in, buffer.data(), buffer.size());
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                copied = false;
+                break;
+            }
+
+            if (r == 0)
+                break;
+
+            for (char const * data = buffer.data(); r > 0;) {
+                ssize_t const w = ::write(out, data, static_cast<size_t>(r));
+                if (w < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    copied = false;
+                    break;
+                }
+                data += w;
+                r -= w;
+            }
+
+            if (!copied)
+                break;
+        }
+    }
+
+    if (::close(out) != 0)
+        copied = false;
+
+    if (!copied)
+        ::unlink(to.c_str());
+
+    return copied;
+}
+
+/* Escapes the printf-like format of virtual dataset source names: */
+std::string escapeSourceName(std::string const & name) {
+    std::string escaped;
+    escaped.reserve(name.size());
+    for (char const c : name) {
+        if (c == '%')
+            escaped.push_back('%');
+        escaped.push_back(c);
+    }
+    return escaped;
+}
+
+bool isContiguousDataset(hid_t const dId) {
+    const hid_t plistId = H5Dget_create_plist(dId);
+    if (plistId < 0)
+        return false;
+
+    BOOST_SCOPE_EXIT_ALL(plistId) {
+        H5Pclose(plistId);
+    };
+
+    return H5Pget_layout(plistId) == H5D_CONTIGUOUS;
+}
+
+/* Whether rows can still be appended to the dataset: */
+bool isExtendibleDataset(hid_t const dId) {
+    const hid_t sId = H5Dget_space(dId);
+    if (sId < 0)
+        return false;
+
+    BOOST_SCOPE_EXIT_ALL(sId) {
+        H5Sclose(sId);
+    };
+
+    hsize_t maxdims[2];
+    if (H5Sget_simple_extent_dims(sId, nullptr, maxdims) < 1)
+        return false;
+
+    return maxdims[0] == H5S_UNLIMITED;
+}
+
+/* Variable length values stored as offsets into a byte dataset, instead of
+   as HDF5 variable length values: */
+bool isVlenOffsetsDataset(hid_t const dId) {
+    const hid_t tId = H5Dget_type(dId);
+    if (tId < 0)
+        return false;
+
+    BOOST_SCOPE_EXIT_ALL(tId) {
+        H5Tclose(tId);
+    };
+
+    return H5Tget_class(tId) == H5T_INTEGER;
+}
+
+/* Types of a single bit stored in a byte, which can be packed into bits: */
+inline bool isBitType(SharemindTdbType const * const type)
+{ return type->size == 1u && !strcmp(type->name, "bool"); }
+
+/* Calls f(i, scratch) for each i below count on up to the given number of
+   threads, the calling thread included. Returns false if any call did: */
+template <typename F>
+bool parallelFor(size_t const count, size_t const threads, F const & f) {
+    std::atomic<size_t> next(0u);
+    std::atomic<bool> ok(true);
+    auto const work = [&next, &ok, count, &f]() noexcept {
+        std::vector<unsigned char> scratch;
+        try {
+            for (size_t i; ok && (i = next++) < count;)
+                if (!f(i, scratch))
+                    ok = false;
+        } catch (...) {
+            ok = false;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    try {
+        for (size_t t = 1u; t < std::min(threads, count); ++t)
+            workers.emplace_back(work);
+    } catch (const std::system_error &) {
+        // Make do with the threads started
+    } catch (const std::bad_alloc &) {
+    }
+
+    work();
+    for (std::thread & worker : workers)
+        worker.join();
+    return ok;
+}
+
+/* Types of which the columns can be encoded: */
+inline bool isEncodableType(SharemindTdbType const * const type) {
+    return !strcmp(type->domain, "public")
+           && (type->size == 1u || type->size == 2u
+               || type->size == 4u || type->size == 8u);
+}
+
+inline bool isSignedType(SharemindTdbType const * const type)
+{ return !strncmp(type->name, "int", 3u); }
+
+inline sharemind::TdbHdf5Encoding filterEncoding(
+        sharemind::TdbHdf5Connection::ColumnEncoding const encoding)
+{
+    using E = sharemind::TdbHdf5Connection::ColumnEncoding;
+    switch (encoding) {
+        case E::Auto: return sharemind::TdbHdf5Encoding::Auto;
+        case E::Dictionary: return sharemind::TdbHdf5Encoding::Dictionary;
+        case E::Delta: return sharemind::TdbHdf5Encoding::Delta;
+        case E::FrameOfReference:
+            return sharemind::TdbHdf5Encoding::FrameOfReference;
+        case E::None: break;
+    }
+    return sharemind::TdbHdf5Encoding::Raw;
+}
+
+/* Checks the filter pipeline without pushing HDF5 errors on the stack: */
+bool hasFilter(hid_t const dId, H5Z_filter_t const filter) {
+    const hid_t plistId = H5Dget_create_plist(dId);
+    if (plistId < 0)
+        return false;
+
+    BOOST_SCOPE_EXIT_ALL(plistId) {
+        H5Pclose(plistId);
+    };
+
+    const int nfilters = H5Pget_nfilters(plistId);
+    for (int i = 0; i < nfilters; ++i) {
+        unsigned flags;
+        size_t cdNelmts = 0u;
+        if (H5Pget_filter2(plistId, static_cast<unsigned>(i), &flags,
+                           &cdNelmts, nullptr, 0u, nullptr, nullptr) == filter)
+            return true;
+    }
+
+    return false;
+}
+
 bool cleanupType(hid_t const aId, SharemindTdbType & type) {
     // Open the type attribute type
     const hid_t aTId = H5Aget_type(aId);
@@ -204,21 +484,55 @@ SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
         TdbHdf5Connection::,
         FailedToSetHdf5LoggingHandlerException,
         "Failed to set HDF5 logging handler.");
+SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
+        InitializationException,
+        TdbHdf5Connection::,
+        FailedToCreateFileAccessPropertyListException,
+        "Failed to create HDF5 file access property list.");
+SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
+        InitializationException,
+        TdbHdf5Connection::,
+        SwmrNotSupportedException,
+        "SWMR mode requires HDF5 1.10 or newer.");
+SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
+        InitializationException,
+        TdbHdf5Connection::,
+        FailedToOpenContainerFileException,
+        "Failed to open the table container file.");
+SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
+        InitializationException,
+        TdbHdf5Connection::,
+        FailedToRegisterHdf5FiltersException,
+        "Failed to register the HDF5 filters.");
 
 BOOST_STATIC_ASSERT(sizeof(TdbHdf5Connection::size_type) == sizeof(hsize_t));
 
 TdbHdf5Connection::TdbHdf5Connection(const LogHard::Logger & logger,
-                                     const fs::path & path)
+                                     const fs::path & path,
+                                     const TdbHdf5ConnectionConf & config)
     : m_logger(logger, "[TdbHdf5Connection]")
     , m_path(path)
+    , m_storage(logger,
+                path,
+                config.storagePaths(),
+                config.storagePlacement(),
+                config.storageLayout(),
+                FILE_EXT,
+                config.swmrMode() != TdbHdf5ConnectionConf::SwmrMode::Read)
+    , m_swmrMode(config.swmrMode())
+    , m_fileAccessPlist(H5P_DEFAULT)
+    , m_containerTableMaxRows(config.containerTableMaxRows())
+    , m_maxOpenTableFiles(config.maxOpenTableFiles())
+    , m_chunkWorkerThreads(config.chunkWorkerThreads() > 0u
+                           ? config.chunkWorkerThreads()
+                           : std::max(std::thread::hardware_concurrency(), 1u))
 {
     // TODO Needs some refactoring. It is getting unreadable.
 
-    // TODO need two kinds of rollback:
-    // 1) Per operation rollback stack - so that the operation leaves the
-    // database in a consistent state.
-    // 2) Rollback function for the last database operation. When we succeed,
-    // but other miners fail.
+    // TODO Per operation rollback stack - so that the operation leaves the
+    // database in a consistent state. Rolling back the last successful
+    // operation (when we succeed, but other miners fail) is done using
+    // UndoRecord.
 
     // TODO Check the given path.
     // TODO Some stuff probably should be allocated on the heap.
@@ -234,38 +548,237 @@ TdbHdf5Connection::TdbHdf5Connection(const LogHard::Logger & logger,
         m_logger.error() << "Failed to set HDF5 logging handler.";
         throw FailedToSetHdf5LoggingHandlerException();
     }
+
+    if (!registerTdbHdf5Filters()) {
+        m_logger.error() << "Failed to register the HDF5 filters.";
+        throw FailedToRegisterHdf5FiltersException();
+    }
+
+    if (m_swmrMode != TdbHdf5ConnectionConf::SwmrMode::Disabled) {
+        #if H5_VERSION_GE(1,10,0)
+        /*
+          SWMR needs the file format introduced in HDF5 1.10. Note that this
+          makes the table files unreadable by older versions of the library and
+          that tables created without SWMR enabled can not be opened in SWMR
+          mode. Concurrent readers do not see the effects of an operation before
+          the writer has flushed the table file.
+        */
+        m_fileAccessPlist = H5Pcreate(H5P_FILE_ACCESS);
+        if (m_fileAccessPlist < 0) {
+            m_logger.error() << "Failed to create file access property list.";
+            throw FailedToCreateFileAccessPropertyListException();
+        }
+
+        if (H5Pset_libver_bounds(m_fileAccessPlist,
+                                 H5F_LIBVER_LATEST,
+                                 H5F_LIBVER_LATEST) < 0)
+        {
+            H5Pclose(m_fileAccessPlist);
+            m_logger.error() << "Failed to set file format version bounds.";
+            throw FailedToCreateFileAccessPropertyListException();
+        }
+        #else
+        m_logger.error() << "SWMR mode requires HDF5 1.10 or newer.";
+        throw SwmrNotSupportedException();
+        #endif
+    }
+
+    if (config.fileDriver() == TdbHdf5ConnectionConf::FileDriver::IoUring) {
+        if (!ioUringAvailable()) {
+            m_logger.warning() << "io_uring is not available, using the "
+                                  "default file driver.";
+        } else {
+            if (m_fileAccessPlist == H5P_DEFAULT) {
+                m_fileAccessPlist = H5Pcreate(H5P_FILE_ACCESS);
+                if (m_fileAccessPlist < 0) {
+                    m_logger.error() << "Failed to create file access property list.";
+                    throw FailedToCreateFileAccessPropertyListException();
+                }
+            }
+
+            if (!setIoUringFileDriver(m_fileAccessPlist, config.directIo())) {
+                H5Pclose(m_fileAccessPlist);
+                m_logger.error() << "Failed to set the io_uring file driver.";
+                throw FailedToCreateFileAccessPropertyListException();
+            }
+        }
+    }
+
+    #ifdef ASYNC_VOL_CONNECTOR
+    // Issue the batched dataset I/O through the asynchronous VOL connector,
+    // given that it can be loaded
+    {
+        const hid_t volId = H5VLregister_connector_by_name(ASYNC_VOL_CONNECTOR,
+                                                           H5P_DEFAULT);
+        if (volId < 0) {
+            m_logger.warning() << "The HDF5 asynchronous VOL connector is not "
+                                  "available, doing synchronous I/O.";
+        } else {
+            BOOST_SCOPE_EXIT_ALL(this, volId) {
+                if (H5VLclose(volId) < 0)
+                    m_logger.fullDebug() << "Error while cleaning up VOL connector.";
+            };
+
+            if (m_fileAccessPlist == H5P_DEFAULT) {
+                m_fileAccessPlist = H5Pcreate(H5P_FILE_ACCESS);
+                if (m_fileAccessPlist < 0) {
+                    m_logger.error() << "Failed to create file access property list.";
+                    throw FailedToCreateFileAccessPropertyListException();
+                }
+            }
+
+            if (H5Pset_vol(m_fileAccessPlist, volId, nullptr) < 0) {
+                H5Pclose(m_fileAccessPlist);
+                m_logger.error() << "Failed to set the asynchronous VOL connector.";
+                throw FailedToCreateFileAccessPropertyListException();
+            }
+
+            m_asyncVol = true;
+        }
+    }
+    #endif
+
+    // Start with no table templates, as the table file format may change
+    if (m_swmrMode != TdbHdf5ConnectionConf::SwmrMode::Read) {
+        try {
+            const fs::path templatePath(m_path / TEMPLATE_DIR);
+            fs::remove_all(templatePath);
+            if (config.tableTemplates()) {
+                fs::create_directory(templatePath);
+                m_templatePath = templatePath;
+            }
+        } catch (const fs::filesystem_error & e) {
+            m_logger.warning() << "Failed to create table template directory: "
+                               << e.what();
+        }
+
+        // Remove the spilled temporary tables left over by earlier connections
+        try {
+            const fs::path temporaryPath(m_path / TEMPORARY_DIR);
+            fs::remove_all(temporaryPath);
+            fs::create_directory(temporaryPath);
+        } catch (const fs::filesystem_error & e) {
+            m_logger.warning() << "Failed to create temporary table directory: "
+                               << e.what();
+        }
+    }
+
+    if (!openContainer()) {
+        if (m_fileAccessPlist != H5P_DEFAULT)
+            H5Pclose(m_fileAccessPlist);
+        throw FailedToOpenContainerFileException();
+    }
+
+    if (m_swmrMode != TdbHdf5ConnectionConf::SwmrMode::Read) {
+        std::map<std::string, fs::path> tables;
+        containerTables(tables);
+        m_catalog.reset(new TdbHdf5Catalog(m_logger, m_storage, tables));
+    }
 }
 
 TdbHdf5Connection::~TdbHdf5Connection() {
+    logTableFileCacheStats("Table file cache");
+
     for (auto & vp : m_tableFiles) {
-        if (H5Fclose(vp.second) < 0)
+        if (!closeTableHandle(vp.second.id))
             m_logger.warning() << "Error while closing handle to table file \""
                                << nameToPath(vp.first).string() << "\".";
     }
 
     m_tableFiles.clear();
+    m_tableFileLru.clear();
+
+    // Drop the temporary tables of the owners which did not drop them
+    for (auto const & op : m_temporaryTables) {
+        for (auto const & vp : op.second) {
+            if (!closeTemporaryTable(vp.first, vp.second))
+                m_logger.warning() << "Error while closing temporary table \""
+                                   << vp.first << "\".";
+        }
+    }
+
+    m_temporaryTables.clear();
+
+    if (m_containerId >= 0 && H5Fclose(m_containerId) < 0)
+        m_logger.warning() << "Error while closing table container file.";
+
+    if (m_fileAccessPlist != H5P_DEFAULT && H5Pclose(m_fileAccessPlist) < 0)
+        m_logger.warning() << "Error while closing file access property list.";
+}
+
+SharemindTdbError TdbHdf5Connection::tblNames(const void * const owner,
+        std::vector<SharemindTdbString *> & names)
+{
+    return tblNames(owner,
+                    std::string(),
+                    0u,
+                    std::numeric_limits<size_type>::max(),
+                    names);
 }
 
-SharemindTdbError TdbHdf5Connection::tblNames(std::vector<SharemindTdbString *> & names) {
+SharemindTdbError TdbHdf5Connection::tblNames(const void * const owner,
+        const std::string & prefix,
+        const size_type offset,
+        const size_type limit,
+        std::vector<SharemindTdbString *> & names)
+{
     try {
         namespace fs = boost::filesystem;
         assert(names.empty());
-        fs::directory_iterator it(m_path);
-        while (it != fs::directory_iterator()) {
-            fs::path filepath(it->path());
-            if (filepath.extension().string().compare(FILE_EXT) == 0) {
-                auto const stemString(filepath.stem().string());
-                auto * const str =
-                        SharemindTdbString_new2(stemString.c_str(),
-                                                stemString.size());
-                try {
-                    names.emplace_back(str);
-                } catch (...) {
-                    SharemindTdbString_delete(str);
-                    throw;
+
+        auto const tIt(m_temporaryTables.find(owner));
+        const bool temporaries = tIt != m_temporaryTables.end()
+                                 && !tIt->second.empty();
+
+        std::vector<std::string> tables;
+        if (m_catalog && !temporaries) {
+            m_catalog->names(prefix, offset, limit, tables);
+        } else {
+            if (m_catalog) {
+                m_catalog->names(prefix,
+                                 0u,
+                                 std::numeric_limits<size_type>::max(),
+                                 tables);
+            } else {
+                std::map<std::string, fs::path> files;
+                m_storage.tableFiles(files);
+
+                for (auto const & vp : files) {
+                    if (vp.first.compare(0u, prefix.size(), prefix) == 0)
+                        tables.emplace_back(vp.first);
+                }
+            }
+
+            // List the temporary tables among the others, once if they
+            // shadow a table of another process
+            if (temporaries) {
+                for (auto const & vp : tIt->second) {
+                    if (vp.first.compare(0u, prefix.size(), prefix) == 0)
+                        tables.emplace_back(vp.first);
                 }
+                std::sort(tables.begin(), tables.end());
+                tables.erase(std::unique(tables.begin(), tables.end()),
+                             tables.end());
+            }
+
+            // Paginate in the same order as the catalog
+            tables.erase(tables.begin(),
+                         tables.begin() + static_cast<std::ptrdiff_t>(
+                             std::min<size_type>(offset, tables.size())));
+            if (tables.size() > limit)
+                tables.resize(limit);
+        }
+
+        names.reserve(tables.size());
+        for (auto const & tbl : tables) {
+            auto * const str = SharemindTdbString_new2(tbl.c_str(),
+                                                       tbl.size());
+            try {
+                names.emplace_back(str);
+            } catch (...) {
+                SharemindTdbString_delete(str);
+                throw;
             }
-            ++it;
         }
     } catch (...) {
         for (auto * const name : names)
@@ -276,9 +789,11 @@ SharemindTdbError TdbHdf5Connection::tblNames(std::vector<SharemindTdbString *>
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
+SharemindTdbError TdbHdf5Connection::tblCreate(const void * const owner,
+        const std::string & tbl,
         const std::vector<SharemindTdbString *> & names,
-        const std::vector<SharemindTdbType *> & types)
+        const std::vector<SharemindTdbType *> & types,
+        const TableOptions & options)
 {
     H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
 
@@ -290,6 +805,9 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
             m_logger.fullDebug() << "Failed to create table \"" << tbl << "\".";
     };
 
+    if (!checkWritable("create table"))
+        return SHAREMIND_TDB_GENERAL_ERROR;
+
     // Do some simple checks on the parameters
     if (names.empty()) {
         m_logger.error() << "No column names given.";
@@ -306,6 +824,11 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
         return SHAREMIND_TDB_INVALID_ARGUMENT;
     }
 
+    if (!options.encodings.empty() && options.encodings.size() != types.size()) {
+        m_logger.error() << "Differing number of column encodings and column types.";
+        return SHAREMIND_TDB_INVALID_ARGUMENT;
+    }
+
     if (!validateTableName(tbl))
         return SHAREMIND_TDB_INVALID_ARGUMENT;
 
@@ -313,6 +836,23 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
     if (!validateColumnNames(names))
         return SHAREMIND_TDB_INVALID_ARGUMENT;
 
+    if (options.partitionRows > 0u) {
+        #if H5_VERSION_GE(1,10,0)
+        if (m_swmrMode != TdbHdf5ConnectionConf::SwmrMode::Disabled) {
+            m_logger.error() << "Partitioned tables are not supported in SWMR mode.";
+            return SHAREMIND_TDB_INVALID_ARGUMENT;
+        }
+        #else
+        m_logger.error() << "Partitioned tables require HDF5 1.10 or later.";
+        return SHAREMIND_TDB_INVALID_ARGUMENT;
+        #endif
+
+        if (options.temporary) {
+            m_logger.error() << "Temporary tables can not be partitioned.";
+            return SHAREMIND_TDB_INVALID_ARGUMENT;
+        }
+    }
+
     // Check for duplicate column names
     {
         std::set<SharemindTdbString const *, SharemindTdbStringLess> namesSet;
@@ -327,12 +867,14 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
     fs::path tblPath = nameToPath(tbl);
 
     // Check if table exists
-    if (m_tableFiles.find(tbl) != m_tableFiles.end()) {
+    if (m_tableFiles.find(tbl) != m_tableFiles.end()
+        || findTemporaryTable(owner, tbl))
+    {
         m_logger.error() << "Table already exists.";
         return SHAREMIND_TDB_TABLE_ALREADY_EXISTS;
     } else {
         bool exists = false;
-        if (!pathExists(tblPath, exists))
+        if (!pathExists(tblPath, exists) || (!exists && !inContainer(tbl, exists)))
             return SHAREMIND_TDB_GENERAL_ERROR;
 
         if (exists) {
@@ -341,23 +883,93 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
         }
     }
 
-    // Create a new file handle
-    // H5F_ACC_EXCL - Fail if file already exists.
-    const hid_t fileId = H5Fcreate(tblPath.c_str(), H5F_ACC_EXCL, H5P_DEFAULT, H5P_DEFAULT);
-    if (fileId < 0) {
-        m_logger.error() << "Failed to create table file with path "
-                         << tblPath.string() << '.';
-        return SHAREMIND_TDB_IO_ERROR;
+    // Small tables start out in the container file, partitioned tables need
+    // a file of their own for the virtual datasets
+    const bool contained = m_containerId >= 0
+            && m_containerTableMaxRows > 0u
+            && options.partitionRows == 0u
+            && !options.temporary;
+
+    // Copy the empty table file kept for the same schema, if any
+    std::string templateKey;
+    if (!contained
+        && options.partitionRows == 0u
+        && !options.temporary
+        && !m_templatePath.empty())
+    {
+        templateKey = tableTemplateKey(names, types, options);
+
+        auto const it(m_tableTemplates.find(templateKey));
+        if (it != m_tableTemplates.end()) {
+            tblPath = m_storage.placeTable(tbl);
+            if (copyFile(it->second, tblPath)) {
+                if (openTableFile(owner, tbl) >= 0) {
+                    releaseTableFile(owner, tbl);
+                    addCreatedTable(owner, tbl, names, types);
+
+                    success = true;
+
+                    return SHAREMIND_TDB_OK;
+                }
+
+                try {
+                    fs::remove(tblPath);
+                } catch (const fs::filesystem_error & e) {
+                    m_logger.fullDebug() << "Error while removing table file: " << e.what();
+                }
+            }
+
+            // Replace the template with the new table file
+            m_logger.warning() << "Failed to copy table template "
+                               << it->second.string() << '.';
+            m_tableTemplates.erase(it);
+        }
+    }
+
+    hid_t fileId = H5I_INVALID_HID;
+    if (contained) {
+        fileId = H5Gcreate(m_containerId, containerTableName(tbl).c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        if (fileId < 0) {
+            m_logger.error() << "Failed to create table group in the container file.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    } else if (options.temporary) {
+        fileId = createTemporaryFile();
+        if (fileId < 0) {
+            m_logger.error() << "Failed to create temporary table file.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    } else {
+        // Choose the storage path for the table file
+        tblPath = m_storage.placeTable(tbl);
+
+        // Create a new file handle
+        // H5F_ACC_EXCL - Fail if file already exists.
+        fileId = H5Fcreate(tblPath.c_str(), H5F_ACC_EXCL, H5P_DEFAULT, m_fileAccessPlist);
+        if (fileId < 0) {
+            m_logger.error() << "Failed to create table file with path "
+                             << tblPath.string() << '.';
+            return SHAREMIND_TDB_IO_ERROR;
+        }
     }
 
     // Set cleanup handler for the file
-    BOOST_SCOPE_EXIT_ALL(&success, this, &tblPath, fileId) {
+    BOOST_SCOPE_EXIT_ALL(&success, this, &tbl, &tblPath, &options, contained, fileId) {
         if (!success) {
             // Close the file
-            if (H5Fclose(fileId) < 0)
+            if (!closeTableHandle(fileId))
                 m_logger.fullDebug() << "Error while closing table file.";
 
             // Delete the file
+            if (contained) {
+                if (H5Ldelete(m_containerId, containerTableName(tbl).c_str(), H5P_DEFAULT) < 0)
+                    m_logger.fullDebug() << "Error while removing table group from the container file.";
+                return;
+            }
+
+            if (options.temporary)
+                return;
+
             try {
                 fs::remove(tblPath);
             } catch (const fs::filesystem_error & e) {
@@ -366,18 +978,94 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
         }
     };
 
+    // Create the first partition file of a partitioned table
+    hid_t partitionId = H5I_INVALID_HID;
+    std::string partitionPattern;
+
+    if (options.partitionRows > 0u) {
+        const fs::path partsPath(partitionsPath(tblPath));
+        try {
+            // Drop any partitions left behind by an earlier table
+            fs::remove_all(partsPath);
+            fs::create_directory(partsPath);
+        } catch (const fs::filesystem_error & e) {
+            m_logger.error() << "Failed to create table partitions directory: " << e.what();
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        partitionId = H5Fcreate(partitionPath(tblPath, 0u).c_str(), H5F_ACC_EXCL, H5P_DEFAULT, m_fileAccessPlist);
+        if (partitionId < 0) {
+            m_logger.error() << "Failed to create table partition file.";
+            try {
+                fs::remove_all(partsPath);
+            } catch (const fs::filesystem_error & e) {
+                m_logger.fullDebug() << "Error while removing table partitions: " << e.what();
+            }
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        // Source file names are relative to the table file
+        fs::path pattern(escapeSourceName(partsPath.filename().string()));
+        pattern /= "%b" FILE_EXT;
+        partitionPattern = pattern.string();
+    }
+
+    BOOST_SCOPE_EXIT_ALL(&success, this, &tblPath, partitionId) {
+        if (partitionId >= 0) {
+            if (H5Fclose(partitionId) < 0)
+                m_logger.fullDebug() << "Error while closing table partition file.";
+
+            if (!success) {
+                try {
+                    fs::remove_all(partitionsPath(tblPath));
+                } catch (const fs::filesystem_error & e) {
+                    m_logger.fullDebug() << "Error while removing table partitions: " << e.what();
+                }
+            }
+        }
+    };
+
+    // The partitions are filled row by row, which the byte datasets of the
+    // variable length columns do not fit
+    const bool vlenOffsets =
+            options.vlenLayout == VlenLayout::Offsets
+            && options.partitionRows == 0u;
+
     // Check the provided types
     typedef std::vector<std::pair<std::string, size_type> > ColInfoVector;
     ColInfoVector colInfoVector;
     typedef std::map<SharemindTdbType *, size_t, SharemindTdbTypeLess> TypeMap;
     TypeMap typeMap;
+    bool columnGroup = options.layout == TableLayout::ColumnDatasets;
+
+    // Encodings of the columns, and whether the columns are stored in
+    // datasets of their own
+    std::vector<ColumnEncoding> encodings(types.size(), ColumnEncoding::None);
+    std::vector<bool> ownDatasets(types.size(), columnGroup);
+
+    for (size_t i = 0; i < types.size(); ++i) {
+        SharemindTdbType * const type = types[i];
+
+        // Count the columns stored in the dataset of the type
+        auto rv(typeMap.emplace(type, 0u));
 
-    for (SharemindTdbType * const type : types) {
-        auto rv(typeMap.emplace(type, 1));
-        if (!rv.second)
-            ++rv.first->second;
+        if (!options.encodings.empty() && isEncodableType(type))
+            encodings[i] = options.encodings[i];
 
-        colInfoVector.emplace_back(tagFromType(*type), rv.first->second - 1);
+        // Variable length values and encoded values are stored column by
+        // column
+        if ((vlenOffsets && isVariableLengthType(type))
+            || encodings[i] != ColumnEncoding::None)
+        {
+            ownDatasets[i] = true;
+            columnGroup = true;
+        }
+
+        if (ownDatasets[i]) {
+            colInfoVector.emplace_back(COLUMN_GROUP "/" + std::to_string(i), 0u);
+        } else {
+            colInfoVector.emplace_back(tagFromType(*type), rv.first->second++);
+        }
     }
 
     const size_t ntypes = typeMap.size();
@@ -403,7 +1091,14 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
 
             hid_t tId = H5I_INVALID_HID;
 
-            if (isVariableLengthType(type)) {
+            if (isVariableLengthType(type) && vlenOffsets) {
+                // Offsets into the byte dataset of the column
+                tId = H5Tcopy(H5T_NATIVE_UINT64);
+                if (tId < 0) {
+                    m_logger.error() << "Failed to create dataset type.";
+                    return SHAREMIND_TDB_GENERAL_ERROR;
+                }
+            } else if (isVariableLengthType(type)) {
                 // Create a variable length type
                 tId = H5Tvlen_create(H5T_NATIVE_CHAR);
                 if (tId < 0) {
@@ -435,6 +1130,44 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
         }
     }
 
+    // Decide on the datasets to create
+    struct DatasetInfo {
+        std::string path;
+        SharemindTdbType * type;
+        hid_t typeId;
+        size_t columns;
+        ColumnEncoding encoding;
+    };
+    std::vector<DatasetInfo> datasets;
+
+    assert(memTypes.size() == ntypes);
+    assert(colSizes.size() == ntypes);
+
+    // The columns of a type not stored in datasets of their own share a
+    // dataset
+    datasets.reserve(types.size());
+    for (size_t i = 0; i < ntypes; ++i)
+        if (colSizes[i] > 0u)
+            datasets.push_back(DatasetInfo{tagFromType(*memTypes[i].first),
+                                           memTypes[i].first,
+                                           memTypes[i].second,
+                                           colSizes[i],
+                                           ColumnEncoding::None});
+
+    for (size_t i = 0; i < types.size(); ++i) {
+        if (!ownDatasets[i])
+            continue;
+
+        auto const & vp =
+                memTypes[static_cast<size_t>(
+                    std::distance(typeMap.begin(), typeMap.find(types[i])))];
+        datasets.push_back(DatasetInfo{colInfoVector[i].first,
+                                       vp.first,
+                                       vp.second,
+                                       1u,
+                                       encodings[i]});
+    }
+
     // Create some meta info objects
     {
         // Create a meta data group
@@ -482,6 +1215,26 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
             m_logger.error() << "Failed to write row count attribute.";
             return SHAREMIND_TDB_GENERAL_ERROR;
         }
+
+        // Record the partition size of partitioned tables
+        if (options.partitionRows > 0u) {
+            const hid_t pAId = H5Acreate(gId, PARTITION_ROWS_ATTR, H5T_NATIVE_HSIZE, aSId, H5P_DEFAULT, H5P_DEFAULT);
+            if (pAId < 0) {
+                m_logger.error() << "Failed to create partition rows attribute.";
+                return SHAREMIND_TDB_GENERAL_ERROR;
+            }
+
+            BOOST_SCOPE_EXIT_ALL(this, pAId) {
+                if (H5Aclose(pAId) < 0)
+                    m_logger.fullDebug() << "Error while cleaning up partition rows attribute.";
+            };
+
+            const hsize_t partitionRows = options.partitionRows;
+            if (H5Awrite(pAId, H5T_NATIVE_HSIZE, &partitionRows) < 0) {
+                m_logger.error() << "Failed to write partition rows attribute.";
+                return SHAREMIND_TDB_GENERAL_ERROR;
+            }
+        }
     }
 
     // Create user attributes group
@@ -495,7 +1248,18 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
             m_logger.fullDebug() << "Error while closing user attributes group.";
     }
 
-    // Create a dataset for each unique column type
+    // Create the group for the column datasets
+    if (columnGroup) {
+        const hid_t gId = H5Gcreate(fileId, COLUMN_GROUP, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        if (gId < 0) {
+            m_logger.error() << "Failed to create column datasets group.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+        if (H5Gclose(gId) < 0)
+            m_logger.fullDebug() << "Error while closing column datasets group.";
+    }
+
+    // Create a dataset for each unique column type, or for each column
     {
         // Set dataset creation properties
         const hid_t plistId = H5Pcreate(H5P_DATASET_CREATE);
@@ -569,35 +1333,80 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
             return SHAREMIND_TDB_GENERAL_ERROR;
         }
 
-        assert(memTypes.size() == ntypes);
-        assert(colSizes.size() == ntypes);
-
-        auto typeIt(memTypes.cbegin());
-        auto sizeIt(colSizes.cbegin());
+        for (auto const & dataset : datasets) {
+            SharemindTdbType * const type = dataset.type;
+            const hid_t & tId = dataset.typeId;
 
-        for (size_t i = 0; i < ntypes; ++i, ++typeIt, ++sizeIt) {
-            SharemindTdbType * const type = typeIt->first;
-            const hid_t & tId = typeIt->second;
+            const bool vlenColumn = vlenOffsets && isVariableLengthType(type);
+            const size_t size =
+                    !isVariableLengthType(type) ? type->size
+                    : vlenColumn ? sizeof(std::uint64_t) : sizeof(hvl_t);
 
-            const size_t size = isVariableLengthType(type) ? sizeof(hvl_t) : type->size;
+            auto const & tag = dataset.path;
 
-            auto const tag(tagFromType(*type));
+            // Encoded chunks are larger for the encodings to pay off
+            const bool encoded = dataset.encoding != ColumnEncoding::None;
+            const size_t chunkSize = encoded ? ENCODED_CHUNK_SIZE : CHUNK_SIZE;
 
             // TODO take CHUNK_SIZE from configuration?
-            // TODO what about the chunk shape?
             // Set chunk size
-            const hsize_t chunkSize = std::max(CHUNK_SIZE / size, static_cast<size_t>(1u));
             hsize_t dimsChunk[2];
-            dimsChunk[0] = chunkSize; dimsChunk[1] = 1; // TODO are vertical chunks OK?
+            if (options.chunkLayout == ChunkLayout::Rows) {
+                // Horizontal chunks holding whole rows of the dataset
+                const size_t rowSize = size * dataset.columns;
+                dimsChunk[0] = std::max(chunkSize / rowSize, static_cast<size_t>(1u));
+                dimsChunk[1] = dataset.columns;
+            } else {
+                // Vertical chunks holding a single column
+                dimsChunk[0] = std::max(chunkSize / size, static_cast<size_t>(1u));
+                dimsChunk[1] = 1;
+            }
+            // Packed chunks are an eighth of the size
+            const bool packBits =
+                    options.packBits && options.partitionRows == 0u
+                    && !encoded && isBitType(type);
+            if (packBits)
+                dimsChunk[0] *= 8u;
+            if (options.partitionRows > 0u)
+                dimsChunk[0] = std::min<hsize_t>(dimsChunk[0], options.partitionRows);
             if (H5Pset_chunk(plistId, 2, dimsChunk) < 0)
                 return SHAREMIND_TDB_GENERAL_ERROR;
 
+            // The property list is shared by the datasets
+            if (packBits) {
+                if (H5Pset_filter(plistId, TDB_HDF5_FILTER_BITPACK,
+                                  H5Z_FLAG_MANDATORY, 0u, nullptr) < 0)
+                {
+                    m_logger.error() << "Failed to set the bit packing filter.";
+                    return SHAREMIND_TDB_GENERAL_ERROR;
+                }
+            }
+            BOOST_SCOPE_EXIT_ALL(this, packBits, plistId) {
+                if (packBits && H5Premove_filter(plistId, TDB_HDF5_FILTER_BITPACK) < 0)
+                    m_logger.fullDebug() << "Error while cleaning up dataset creation property list.";
+            };
+
+            if (encoded) {
+                if (!setEncodingFilter(plistId,
+                                       filterEncoding(dataset.encoding),
+                                       type->size,
+                                       isSignedType(type)))
+                {
+                    m_logger.error() << "Failed to set the encoding filter.";
+                    return SHAREMIND_TDB_GENERAL_ERROR;
+                }
+            }
+            BOOST_SCOPE_EXIT_ALL(this, encoded, plistId) {
+                if (encoded && H5Premove_filter(plistId, TDB_HDF5_FILTER_ENCODING) < 0)
+                    m_logger.fullDebug() << "Error while cleaning up dataset creation property list.";
+            };
+
             // TODO set compression? Probably only useful for some public types
             // (variable length strings cannot be compressed as far as I know).
 
             // Create a simple two dimensional data space
             hsize_t dims[2];
-            dims[0] = 0; dims[1] = *sizeIt;
+            dims[0] = 0; dims[1] = dataset.columns;
 
             const hsize_t maxdims[2] = { H5S_UNLIMITED, H5S_UNLIMITED };
 
@@ -614,7 +1423,23 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
             };
 
             // Create the dataset
-            const hid_t dId = H5Dcreate(fileId, tag.c_str(), tId, sId, H5P_DEFAULT, plistId, H5P_DEFAULT);
+            hid_t dId = H5I_INVALID_HID;
+            if (partitionId >= 0) {
+                const SharemindTdbError ecode =
+                        createVirtualDataset(fileId,
+                                             partitionId,
+                                             tag,
+                                             partitionPattern,
+                                             tId,
+                                             plistId,
+                                             dataset.columns,
+                                             options.partitionRows,
+                                             dId);
+                if (ecode != SHAREMIND_TDB_OK)
+                    return ecode;
+            } else {
+                dId = H5Dcreate(fileId, tag.c_str(), tId, sId, H5P_DEFAULT, plistId, H5P_DEFAULT);
+            }
             if (dId < 0) {
                 m_logger.error() << "Failed to create dataset type \"" << tag << "\".";
                 return SHAREMIND_TDB_GENERAL_ERROR;
@@ -658,6 +1483,9 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
                 m_logger.error() << "Failed to write dataset type attribute.";
                 return SHAREMIND_TDB_IO_ERROR;
             }
+
+            if (vlenColumn && !createVlenBytes(fileId, dId, tag + VLEN_BYTES_EXT))
+                return SHAREMIND_TDB_GENERAL_ERROR;
         }
     }
 
@@ -796,52 +1624,248 @@ SharemindTdbError TdbHdf5Connection::tblCreate(const std::string & tbl,
     if (H5Fflush(fileId, H5F_SCOPE_LOCAL) < 0)
         m_logger.fullDebug() << "Error while flushing buffers.";
 
+    // The temporary tables stay open and out of the catalog until deleted
+    if (options.temporary) {
+        m_temporaryTables[owner].emplace(tbl,
+                                                TemporaryTable{
+                                                    fileId,
+                                                    options.spillRows,
+                                                    0u,
+                                                    fs::path()});
+
+        addCreatedTable(owner, tbl, names, types);
+
+        success = true;
+
+        return SHAREMIND_TDB_OK;
+    }
+
+    #if H5_VERSION_GE(1,10,0)
+    // All the objects are in place, let the readers in
+    if (m_swmrMode == TdbHdf5ConnectionConf::SwmrMode::Write
+        && H5Fstart_swmr_write(fileId) < 0)
+    {
+        m_logger.error() << "Failed to switch the table file to SWMR mode.";
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+    #endif
+
     // Add the file handler to the map
+    m_tableFileLru.emplace_front(tbl);
     #ifndef NDEBUG
     const bool r =
     #endif
-            m_tableFiles.emplace(tbl, fileId)
+            m_tableFiles.emplace(tbl,
+                                 TableFile{fileId, 0u, m_tableFileLru.begin()})
             #ifndef NDEBUG
                 .second
             #endif
             ;
     assert(r);
+    evictTableFiles();
+
+    addCreatedTable(owner, tbl, names, types);
 
     success = true;
 
+    if (!templateKey.empty())
+        saveTableTemplate(tbl, templateKey, tblPath);
+
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::tblDelete(const std::string & tbl) {
+void TdbHdf5Connection::addCreatedTable(const void * const owner,
+        const std::string & tbl,
+        const std::vector<SharemindTdbString *> & names,
+        const std::vector<SharemindTdbType *> & types)
+{
+    if (m_undo)
+        m_undo->createdTables.emplace(tbl);
+
+    if (m_catalog && !findTemporaryTable(owner, tbl)) {
+        const std::int64_t now = std::time(nullptr);
+        m_catalog->add(tbl,
+                       TdbHdf5Catalog::Entry{
+                           TdbHdf5Catalog::schemaHash(names, types),
+                           0u,
+                           now,
+                           now,
+                           true});
+    }
+}
+
+void TdbHdf5Connection::saveTableTemplate(const std::string & tbl,
+        const std::string & key,
+        const fs::path & tblPath)
+{
+    // The table file is consistent on disk only when closed
+    closeTableFile(tbl);
+
+    fs::path templatePath(m_templatePath);
+    templatePath /= std::to_string(m_templateCount++) + FILE_EXT;
+
+    if (!copyFile(tblPath, templatePath)) {
+        m_logger.warning() << "Failed to save table template "
+                           << templatePath.string() << '.';
+        return;
+    }
+
+    m_tableTemplates.emplace(key, std::move(templatePath));
+}
+
+SharemindTdbError TdbHdf5Connection::tblDelete(const void * const owner,
+        const std::string & tbl)
+{
     H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
 
+    if (!checkWritable("delete table"))
+        return SHAREMIND_TDB_GENERAL_ERROR;
+
     if (!validateTableName(tbl))
         return SHAREMIND_TDB_INVALID_ARGUMENT;
 
+    // Drop a temporary table, or keep it until the operation is committed
+    if (TemporaryTable * const temporary = findTemporaryTable(owner, tbl)) {
+        if (m_undo) {
+            m_undo->deletedTemporaryTables.emplace(tbl, *temporary);
+            m_temporaryTables[owner].erase(tbl);
+        } else if (!dropTemporaryTable(owner, tbl)) {
+            m_logger.error() << "Failed to delete temporary table \""
+                             << tbl << "\".";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+        return SHAREMIND_TDB_OK;
+    }
+
     // Close the table, if open:
     closeTableFile(tbl);
 
+    // Delete the table group from the container file
+    bool contained = false;
+    if (!inContainer(tbl, contained))
+        return SHAREMIND_TDB_GENERAL_ERROR;
+
+    if (contained) {
+        const std::string name(containerTableName(tbl));
+        if (m_undo) {
+            // Keep the group around until the operation is committed
+            const std::string deletedName(containerDeletedName(tbl));
+            if ((H5Lexists(m_containerId, deletedName.c_str(), H5P_DEFAULT) > 0
+                 && H5Ldelete(m_containerId, deletedName.c_str(), H5P_DEFAULT) < 0)
+                || H5Lmove(m_containerId, name.c_str(), m_containerId, deletedName.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0)
+            {
+                m_logger.error() << "Failed to delete table \"" << tbl
+                                 << "\" from the container file.";
+                return SHAREMIND_TDB_IO_ERROR;
+            }
+
+            UndoRecord::DeletedTable deleted{fs::path(),
+                                             false,
+                                             TdbHdf5Catalog::Entry(),
+                                             fs::path(),
+                                             true};
+
+            if (m_catalog) {
+                if (auto const * const entry = m_catalog->find(tbl)) {
+                    deleted.inCatalog = true;
+                    deleted.catalogEntry = *entry;
+                }
+            }
+            m_undo->deletedTables.emplace(tbl, std::move(deleted));
+        } else if (H5Ldelete(m_containerId, name.c_str(), H5P_DEFAULT) < 0) {
+            m_logger.error() << "Failed to delete table \"" << tbl
+                             << "\" from the container file.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        if (H5Fflush(m_containerId, H5F_SCOPE_LOCAL) < 0)
+            m_logger.fullDebug() << "Error while flushing buffers.";
+    }
+
     // Get table path
     const fs::path tblPath = nameToPath(tbl);
 
-    // Delete the table file
+    // Delete the table file, a copy left behind by an interrupted promotion
+    // of a table in the container file can go right away
     try {
-        fs::remove(tblPath);
+        if (m_undo && !contained) {
+            // Keep the file around until the operation is committed
+            if (fs::exists(tblPath)) {
+                fs::path deletedPath(tblPath);
+                deletedPath += DELETED_FILE_EXT;
+                fs::rename(tblPath, deletedPath);
+
+                UndoRecord::DeletedTable deleted{std::move(deletedPath),
+                                                 false,
+                                                 TdbHdf5Catalog::Entry(),
+                                                 fs::path(),
+                                                 false};
+
+                // A failed operation is neither committed nor rolled back, so
+                // put the file back if the partitions can not be moved aside
+                const fs::path partsPath(partitionsPath(tblPath));
+                try {
+                    if (fs::exists(partsPath)) {
+                        deleted.partitionsPath = partsPath;
+                        deleted.partitionsPath += DELETED_FILE_EXT;
+                        fs::rename(partsPath, deleted.partitionsPath);
+                    }
+                } catch (const fs::filesystem_error &) {
+                    fs::rename(deleted.path, tblPath);
+                    throw;
+                }
+
+                if (m_catalog) {
+                    if (auto const * const entry = m_catalog->find(tbl)) {
+                        deleted.inCatalog = true;
+                        deleted.catalogEntry = *entry;
+                    }
+                }
+                m_undo->deletedTables.emplace(tbl, std::move(deleted));
+            }
+        } else {
+            fs::remove(tblPath);
+            fs::remove_all(partitionsPath(tblPath));
+        }
     } catch (const fs::filesystem_error & e) {
         m_logger.error() << "Error while deleting table \"" << tbl << "\" file "
                          << tblPath.string() << ": " << e.what() << ".";
         return SHAREMIND_TDB_IO_ERROR;
     }
 
+    if (m_catalog)
+        m_catalog->remove(tbl);
+
+    m_storage.forgetTable(tbl);
+
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::tblExists(const std::string & tbl, bool & status) {
+SharemindTdbError TdbHdf5Connection::tblExists(const void * const owner,
+        const std::string & tbl, bool & status)
+{
     H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
 
     if (!validateTableName(tbl))
         return SHAREMIND_TDB_INVALID_ARGUMENT;
 
+    if (findTemporaryTable(owner, tbl)) {
+        status = true;
+        return SHAREMIND_TDB_OK;
+    }
+
+    // The catalog lists exactly the existing tables
+    if (m_catalog) {
+        status = m_catalog->find(tbl);
+        return SHAREMIND_TDB_OK;
+    }
+
+    if (!inContainer(tbl, status))
+        return SHAREMIND_TDB_GENERAL_ERROR;
+
+    if (status)
+        return SHAREMIND_TDB_OK;
+
     // Get table path
     const fs::path tblPath = nameToPath(tbl);
 
@@ -868,7 +1892,9 @@ SharemindTdbError TdbHdf5Connection::tblExists(const std::string & tbl, bool & s
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::tblColCount(const std::string & tbl, size_type & count) {
+SharemindTdbError TdbHdf5Connection::tblColCount(const void * const owner,
+        const std::string & tbl, size_type & count)
+{
     H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
 
     // Set the cleanup flag
@@ -885,7 +1911,7 @@ SharemindTdbError TdbHdf5Connection::tblColCount(const std::string & tbl, size_t
     // Check if table exists
     {
         bool exists = false;
-        const SharemindTdbError ecode = tblExists(tbl, exists);
+        const SharemindTdbError ecode = tblExists(owner, tbl, exists);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
 
@@ -896,12 +1922,16 @@ SharemindTdbError TdbHdf5Connection::tblColCount(const std::string & tbl, size_t
     }
 
     // Open the table file
-    const hid_t fileId = openTableFile(tbl);
+    const hid_t fileId = openTableFile(owner, tbl);
     if (fileId < 0) {
         m_logger.error() << "Failed to open table file.";
         return SHAREMIND_TDB_IO_ERROR;
     }
 
+    BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+        releaseTableFile(owner, tbl);
+    };
+
     // Read column meta info
     hsize_t ncols = 0;
     {
@@ -917,7 +1947,9 @@ SharemindTdbError TdbHdf5Connection::tblColCount(const std::string & tbl, size_t
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::tblColNames(const std::string & tbl, std::vector<SharemindTdbString *> & names) {
+SharemindTdbError TdbHdf5Connection::tblColNames(const void * const owner,
+        const std::string & tbl, std::vector<SharemindTdbString *> & names)
+{
     H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
 
     // Set the cleanup flag
@@ -935,7 +1967,7 @@ SharemindTdbError TdbHdf5Connection::tblColNames(const std::string & tbl, std::v
     // Check if table exists
     {
         bool exists = false;
-        const SharemindTdbError ecode = tblExists(tbl, exists);
+        const SharemindTdbError ecode = tblExists(owner, tbl, exists);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
 
@@ -946,12 +1978,16 @@ SharemindTdbError TdbHdf5Connection::tblColNames(const std::string & tbl, std::v
     }
 
     // Open the table file
-    const hid_t fileId = openTableFile(tbl);
+    const hid_t fileId = openTableFile(owner, tbl);
     if (fileId < 0) {
         m_logger.error() << "Failed to open table file.";
         return SHAREMIND_TDB_IO_ERROR;
     }
 
+    BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+        releaseTableFile(owner, tbl);
+    };
+
     // Get table column count
     hsize_t colCount = 0;
     {
@@ -1064,7 +2100,9 @@ SharemindTdbError TdbHdf5Connection::tblColNames(const std::string & tbl, std::v
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::tblColTypes(const std::string & tbl, std::vector<SharemindTdbType *> & types) {
+SharemindTdbError TdbHdf5Connection::tblColTypes(const void * const owner,
+        const std::string & tbl, std::vector<SharemindTdbType *> & types)
+{
     H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
 
     // Set the cleanup flag
@@ -1082,7 +2120,7 @@ SharemindTdbError TdbHdf5Connection::tblColTypes(const std::string & tbl, std::v
     // Check if table exists
     {
         bool exists = false;
-        const SharemindTdbError ecode = tblExists(tbl, exists);
+        const SharemindTdbError ecode = tblExists(owner, tbl, exists);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
 
@@ -1093,12 +2131,16 @@ SharemindTdbError TdbHdf5Connection::tblColTypes(const std::string & tbl, std::v
     }
 
     // Open the table file
-    const hid_t fileId = openTableFile(tbl);
+    const hid_t fileId = openTableFile(owner, tbl);
     if (fileId < 0) {
         m_logger.error() << "Failed to open table file.";
         return SHAREMIND_TDB_IO_ERROR;
     }
 
+    BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+        releaseTableFile(owner, tbl);
+    };
+
     // Get table column count
     hsize_t colCount = 0;
     {
@@ -1264,7 +2306,9 @@ SharemindTdbError TdbHdf5Connection::tblColTypes(const std::string & tbl, std::v
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::tblRowCount(const std::string & tbl, size_type & count) {
+SharemindTdbError TdbHdf5Connection::tblRowCount(const void * const owner,
+        const std::string & tbl, size_type & count)
+{
     H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
 
     // Set the cleanup flag
@@ -1281,7 +2325,7 @@ SharemindTdbError TdbHdf5Connection::tblRowCount(const std::string & tbl, size_t
     // Check if table exists
     {
         bool exists = false;
-        const SharemindTdbError ecode = tblExists(tbl, exists);
+        const SharemindTdbError ecode = tblExists(owner, tbl, exists);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
 
@@ -1291,21 +2335,54 @@ SharemindTdbError TdbHdf5Connection::tblRowCount(const std::string & tbl, size_t
         }
     }
 
+    const TemporaryTable * const temporary = findTemporaryTable(owner, tbl);
+
+    // Serve the row count tracked for a temporary table or from the catalog,
+    // if it is known to be current
+    if (temporary
+        && m_committedRowCounts.find(tbl) == m_committedRowCounts.end())
+    {
+        count = temporary->rowCount;
+        success = true;
+        return SHAREMIND_TDB_OK;
+    }
+
+    if (m_catalog
+        && !temporary
+        && m_committedRowCounts.find(tbl) == m_committedRowCounts.end())
+    {
+        auto const * const entry = m_catalog->find(tbl);
+        if (entry && entry->rowCountVerified) {
+            count = entry->rowCount;
+            success = true;
+            return SHAREMIND_TDB_OK;
+        }
+    }
+
     // Open the table file
-    const hid_t fileId = openTableFile(tbl);
+    const hid_t fileId = openTableFile(owner, tbl);
     if (fileId < 0) {
         m_logger.error() << "Failed to open table file.";
         return SHAREMIND_TDB_IO_ERROR;
     }
 
+    BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+        releaseTableFile(owner, tbl);
+    };
+
     // Read row meta info
     hsize_t nrows = 0;
     {
-        const SharemindTdbError ecode = getRowCount(fileId, nrows);
+        const SharemindTdbError ecode = getCommittedRowCount(tbl, fileId, nrows);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
     }
 
+    if (m_catalog
+        && !temporary
+        && m_committedRowCounts.find(tbl) == m_committedRowCounts.end())
+        m_catalog->verifyRowCount(tbl, nrows);
+
     count = nrows;
 
     success = true;
@@ -1313,9 +2390,170 @@ SharemindTdbError TdbHdf5Connection::tblRowCount(const std::string & tbl, size_t
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
+SharemindTdbError TdbHdf5Connection::tblCompact(const void * const owner,
+        const std::string & tbl)
+{
+    H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
+
+    // Set the cleanup flag
+    bool success = false;
+
+    BOOST_SCOPE_EXIT_ALL(&success, this, &tbl) {
+        if (!success)
+            m_logger.error() << "Failed to compact table \"" << tbl << "\".";
+    };
+
+    if (!checkWritable("compact table"))
+        return SHAREMIND_TDB_GENERAL_ERROR;
+
+    if (!validateTableName(tbl))
+        return SHAREMIND_TDB_INVALID_ARGUMENT;
+
+    // Check if table exists
+    {
+        bool exists = false;
+        const SharemindTdbError ecode = tblExists(owner, tbl, exists);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+
+        if (!exists) {
+            m_logger.error() << "Table \"" << tbl << "\" does not exist.";
+            return SHAREMIND_TDB_TABLE_NOT_FOUND;
+        }
+    }
+
+    // The rows of an uncommitted insertion could not be rolled back later
+    if (m_committedRowCounts.find(tbl) != m_committedRowCounts.end()) {
+        m_logger.error() << "Table \"" << tbl << "\" has uncommitted changes.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    // The in-memory files of the temporary tables are dropped as a whole
+    if (findTemporaryTable(owner, tbl)) {
+        success = true;
+        return SHAREMIND_TDB_OK;
+    }
+
+    const fs::path tblPath = nameToPath(tbl);
+    fs::path compactPath(tblPath);
+    compactPath += COMPACT_FILE_EXT;
+
+    // Remove the compacted copy, unless it replaced the table file
+    bool swapped = false;
+
+    BOOST_SCOPE_EXIT_ALL(&swapped, this, &compactPath) {
+        if (!swapped) {
+            try {
+                fs::remove(compactPath);
+            } catch (const fs::filesystem_error & e) {
+                m_logger.fullDebug() << "Error while removing compacted table file: " << e.what();
+            }
+        }
+    };
+
+    // Write the compacted copy of the table next to the table file
+    {
+        const hid_t srcId = openTableFile(owner, tbl);
+        if (srcId < 0) {
+            m_logger.error() << "Failed to open table file.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+            releaseTableFile(owner, tbl);
+        };
+
+        hsize_t partitionRows = 0u;
+        {
+            const SharemindTdbError ecode = getPartitionRows(srcId, partitionRows);
+            if (ecode != SHAREMIND_TDB_OK)
+                return ecode;
+        }
+
+        if (partitionRows > 0u) {
+            m_logger.error() << "Partitioned tables can not be compacted.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        if (H5Iget_type(srcId) == H5I_GROUP) {
+            m_logger.error() << "Tables in the container file can not be compacted.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        const hid_t dstId = H5Fcreate(compactPath.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, m_fileAccessPlist);
+        if (dstId < 0) {
+            m_logger.error() << "Failed to create table file with path "
+                             << compactPath.string() << '.';
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        bool closed = false;
+
+        BOOST_SCOPE_EXIT_ALL(&closed, this, dstId) {
+            if (!closed && H5Fclose(dstId) < 0)
+                m_logger.fullDebug() << "Error while closing compacted table file.";
+        };
+
+        const SharemindTdbError ecode = copyTable(srcId, dstId, true);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+
+        closed = true;
+        if (H5Fclose(dstId) < 0) {
+            m_logger.error() << "Failed to close compacted table file.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    // Swap the compacted copy in place of the table file
+    closeTableFile(tbl);
+
+    // Keep the table file around until the operation is committed
+    fs::path uncompactedPath;
+    if (m_undo
+        && m_undo->compactedTables.find(tbl) == m_undo->compactedTables.end())
+    {
+        uncompactedPath = tblPath;
+        uncompactedPath += UNCOMPACTED_FILE_EXT;
+
+        try {
+            fs::rename(tblPath, uncompactedPath);
+        } catch (const fs::filesystem_error & e) {
+            m_logger.error() << "Failed to move table file aside: " << e.what();
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    try {
+        fs::rename(compactPath, tblPath);
+    } catch (const fs::filesystem_error & e) {
+        m_logger.error() << "Failed to replace table file: " << e.what();
+
+        if (!uncompactedPath.empty()) {
+            try {
+                fs::rename(uncompactedPath, tblPath);
+            } catch (const fs::filesystem_error & e) {
+                m_logger.error() << "Failed to restore table file: " << e.what();
+            }
+        }
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
+    swapped = true;
+
+    if (!uncompactedPath.empty())
+        m_undo->compactedTables.emplace(tbl, std::move(uncompactedPath));
+
+    success = true;
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::insertRow(const void * const owner,
+        const std::string & tbl,
         const std::vector<std::vector<SharemindTdbValue *> > & valuesBatch,
-        const std::vector<bool> & valueAsColumnBatch)
+        const std::vector<bool> & valueAsColumnBatch,
+        const std::vector<std::vector<size_type> > & lengthsBatch)
 {
     H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
 
@@ -1327,12 +2565,17 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
             m_logger.error() << "Failed to insert row(s) into table \"" << tbl << "\".";
     };
 
+    if (!checkWritable("insert rows"))
+        return SHAREMIND_TDB_GENERAL_ERROR;
+
     if (valuesBatch.empty()) {
         m_logger.error() << "No values given.";
         return SHAREMIND_TDB_INVALID_ARGUMENT;
     }
 
-    if (valuesBatch.size() != valueAsColumnBatch.size()) {
+    if (valuesBatch.size() != valueAsColumnBatch.size()
+        || valuesBatch.size() != lengthsBatch.size())
+    {
         m_logger.error() << "Incomplete arguments given.";
         return SHAREMIND_TDB_INVALID_ARGUMENT;
     }
@@ -1356,7 +2599,7 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
     // Check if table exists
     {
         bool exists = false;
-        const SharemindTdbError ecode = tblExists(tbl, exists);
+        const SharemindTdbError ecode = tblExists(owner, tbl, exists);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
 
@@ -1366,13 +2609,29 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
         }
     }
 
+    // Move a table that has outgrown the container file to a file of its
+    // own, likewise a temporary table that has outgrown the memory
+    TemporaryTable * const temporary = findTemporaryTable(owner, tbl);
+    if (!temporary) {
+        if (promoteTable(owner, tbl) != SHAREMIND_TDB_OK)
+            m_logger.warning() << "Failed to move table \"" << tbl
+                               << "\" out of the container file.";
+    } else if (spillTable(owner, tbl) != SHAREMIND_TDB_OK) {
+        m_logger.warning() << "Failed to move temporary table \"" << tbl
+                           << "\" to a file.";
+    }
+
     // Open the table file
-    const hid_t fileId = openTableFile(tbl);
+    const hid_t fileId = openTableFile(owner, tbl);
     if (fileId < 0) {
         m_logger.error() << "Failed to open table file.";
         return SHAREMIND_TDB_IO_ERROR;
     }
 
+    BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+        releaseTableFile(owner, tbl);
+    };
+
     // Get table row count
     hsize_t rowCount = 0u;
     {
@@ -1389,6 +2648,14 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
             return ecode;
     }
 
+    // Get table partition size
+    hsize_t partitionRows = 0u;
+    {
+        const SharemindTdbError ecode = getPartitionRows(fileId, partitionRows);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+    }
+
     // Get column types
     typedef std::map<hobj_ref_t, std::pair<SharemindTdbType *, hid_t> > RefTypeMap;
     RefTypeMap refTypes;
@@ -1396,6 +2663,15 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
     typedef std::map<SharemindTdbType *, size_type, SharemindTdbTypeLess> TypeCountMap;
     TypeCountMap typeCounts;
 
+    // Columns of a dataset, relative to all the columns of the same type
+    struct DatasetColumns {
+        size_type typeOffset;
+        size_type count;
+    };
+
+    typedef std::map<hobj_ref_t, DatasetColumns> DatasetColumnsMap;
+    DatasetColumnsMap dsetColumns;
+
     BOOST_SCOPE_EXIT_ALL(this, &refTypes) {
         for (auto & pair : refTypes) {
             SharemindTdbType * const type = pair.second.first;
@@ -1451,41 +2727,49 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
 
         // Resolve references to types
         for (size_type i = 0u; i < colCount; ++i) {
+            SharemindTdbType * type = nullptr;
+
             auto const it(const_cast<RefTypeMap const &>(refTypes).find(
                               dsetRefs[i]));
             if (it == refTypes.end()) {
                 hid_t aId = H5I_INVALID_HID;
 
                 // Read the type attribute
-                auto type(std::make_unique<SharemindTdbType>());
-                const SharemindTdbError ecode = objRefToType(fileId, dsetRefs[i], aId, *type);
+                auto newType(std::make_unique<SharemindTdbType>());
+                const SharemindTdbError ecode = objRefToType(fileId, dsetRefs[i], aId, *newType);
                 if (ecode != SHAREMIND_TDB_OK) {
                     m_logger.error() << "Failed to get type info from dataset reference.";
                     return ecode;
                 }
 
+                type = newType.get();
                 #ifndef NDEBUG
                 const bool r =
                 #endif
-                        typeCounts.emplace(type.get(), 1)
+                        refTypes.emplace(dsetRefs[i], RefTypeMap::mapped_type(newType.release(), aId))
                         #ifndef NDEBUG
                             .second
                         #endif
                         ;
                 assert(r);
-                #ifndef NDEBUG
-                const bool r2 =
-                #endif
-                        refTypes.emplace(dsetRefs[i], RefTypeMap::mapped_type(type.release(), aId))
-                        #ifndef NDEBUG
-                            .second
-                        #endif
-                        ;
-                assert(r2);
             } else {
-                SharemindTdbType * const type = it->second.first;
-                ++typeCounts[type];
+                type = it->second.first;
+            }
+
+            // Several datasets may hold columns of the same type, each of them
+            // holding a contiguous range of these columns.
+            size_type & typeCount = typeCounts[type];
+
+            auto const rv(dsetColumns.emplace(dsetRefs[i],
+                                              DatasetColumns{typeCount, 0u}));
+            DatasetColumns & dsetCols = rv.first->second;
+            if (dsetCols.typeOffset + dsetCols.count != typeCount) {
+                m_logger.error() << "Unsupported column layout.";
+                return SHAREMIND_TDB_GENERAL_ERROR;
             }
+
+            ++dsetCols.count;
+            ++typeCount;
         }
     }
 
@@ -1493,6 +2777,9 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
     struct ValuesInfo {
         std::vector<SharemindTdbValue *> values;
         std::vector<bool> valueAsColumn;
+        /* Row lengths of the variable length values given as columns: */
+        std::vector<const size_type *> lengths;
+        std::vector<size_type> rowCounts;
     };
 
     typedef std::vector<SharemindTdbValue *> ValuesVector;
@@ -1502,27 +2789,73 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
     size_type insertedRowCount = 0u;
 
     auto vacIt(valueAsColumnBatch.cbegin());
+    auto lIt(lengthsBatch.cbegin());
     for (const ValuesVector & values : valuesBatch) {
         size_type batchColCount = 0u;
 
+        const std::vector<size_type> & lengths = *lIt;
+        if (!lengths.empty() && !*vacIt) {
+            m_logger.error() << "Value lengths given for a batch not inserted as columns.";
+            return SHAREMIND_TDB_INVALID_ARGUMENT;
+        }
+
         // Get the row count for this batch
-        const size_type batchRowCount =
-            !*vacIt || isVariableLengthType(values.front()->type) ?
-            1u : values.front()->size / values.front()->type->size;
+        size_type batchRowCount = 1u;
+        if (!lengths.empty()) {
+            // The lengths are split evenly between the variable length values
+            const size_type vlenCount =
+                    static_cast<size_type>(
+                        std::count_if(values.cbegin(),
+                                      values.cend(),
+                                      [](SharemindTdbValue const * const val)
+                                      { return isVariableLengthType(val->type); }));
+            if (vlenCount == 0u || lengths.size() % vlenCount != 0u) {
+                m_logger.error() << "Value lengths do not match the variable length values.";
+                return SHAREMIND_TDB_INVALID_ARGUMENT;
+            }
+
+            batchRowCount = lengths.size() / vlenCount;
+        } else if (*vacIt && !isVariableLengthType(values.front()->type)) {
+            batchRowCount = values.front()->size / values.front()->type->size;
+        }
 
         typedef std::map<SharemindTdbType *, size_t, SharemindTdbTypeLess> BatchTypeCountMap;
         BatchTypeCountMap batchTypeCount;
 
+        auto batchLengthsIt(lengths.cbegin());
+
         for (SharemindTdbValue * const val : values) {
             SharemindTdbType * const type = val->type;
 
+            ValuesInfo & valInfo = typeValues[type];
+            const size_type * valueLengths = nullptr;
+
             if (isVariableLengthType(type)) {
-                if (*vacIt && batchRowCount != 1u) {
+                if (!lengths.empty()) {
+                    // The rows of the value are packed back to back
+                    valueLengths = &*batchLengthsIt;
+                    batchLengthsIt += static_cast<std::ptrdiff_t>(batchRowCount);
+
+                    // Check each length against what is left of the value,
+                    // as their sum may wrap around
+                    size_type remaining = val->size;
+                    for (size_type i = 0u; i < batchRowCount; ++i) {
+                        if (valueLengths[i] > remaining) {
+                            m_logger.error() << "Value lengths exceed the value size.";
+                            return SHAREMIND_TDB_INVALID_ARGUMENT;
+                        }
+                        remaining -= valueLengths[i];
+                    }
+
+                    if (remaining != 0u) {
+                        m_logger.error() << "Value lengths do not add up to the value size.";
+                        return SHAREMIND_TDB_INVALID_ARGUMENT;
+                    }
+                } else if (*vacIt && batchRowCount != 1u) {
                     m_logger.error() << "Inconsistent row count for a value batch.";
                     return SHAREMIND_TDB_INVALID_ARGUMENT;
                 }
 
-                // For variable length types we do not support arrays
                 batchColCount += 1u;
                 batchTypeCount[type] += 1u;
             } else {
@@ -1557,9 +2890,10 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
                 }
             }
 
-            ValuesInfo & valInfo = typeValues[type];
             valInfo.values.push_back(val);
             valInfo.valueAsColumn.push_back(*vacIt);
+            valInfo.lengths.push_back(valueLengths);
+            valInfo.rowCounts.push_back(batchRowCount);
         }
 
         // Check if we have values for all the columns
@@ -1586,46 +2920,171 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
 
         insertedRowCount += batchRowCount;
         ++vacIt;
+        ++lIt;
     }
 
     // Set cleanup handler to restore the initial state if something goes wrong
-    typedef std::map<hobj_ref_t, std::pair<hsize_t, hsize_t> > CleanupMap;
-    CleanupMap cleanup;
+    DatasetExtentMap cleanup;
 
     BOOST_SCOPE_EXIT_ALL(&success, this, &cleanup, fileId) {
         if (!success) {
-            for (auto const & vp : cleanup) {
-                const hobj_ref_t dsetRef = vp.first;
+            restoreExtents(fileId, cleanup);
+            cleanup.clear();
+        }
+    };
 
-                // Get dataset from reference
-                const hid_t oId = H5Rdereference(fileId, H5R_OBJECT, &dsetRef);
-                if (oId < 0) {
-                    m_logger.error() << "Error while restoring initial state: Failed to open dataset reference.";
-                    break;
-                }
+    // Each partition file is opened once for all the datasets, the ones
+    // created for the rows go if the rows do
+    PartitionFileMap partitionFiles;
+    std::vector<fs::path> createdPartitions;
 
-                // Set the size of the dataset back to the original
-                const hsize_t dims[] = { vp.second.first, vp.second.second };
-                if (H5Dset_extent(oId, dims) < 0) {
-                    m_logger.error() << "Error while restoring initial state: Failed to clean up changes to the table.";
+    BOOST_SCOPE_EXIT_ALL(&success, this, &partitionFiles, &createdPartitions) {
+        for (auto const & vp : partitionFiles) {
+            if (H5Fclose(vp.second) < 0)
+                m_logger.fullDebug() << "Error while closing table partition file.";
+        }
 
-                    if (H5Oclose(oId) < 0)
-                        m_logger.fullDebug() << "Error while cleaning up dataset object.";
+        if (!success)
+            removePartitions(createdPartitions);
+    };
 
-                    break;
-                }
+    // Aggregate the values of each type into a single buffer
+    struct TypeBuffer {
+        void * data;
+        bool owned;
+    };
 
-                if (H5Oclose(oId) < 0)
-                    m_logger.fullDebug() << "Error while cleaning up dataset object.";
-            }
+    typedef std::map<SharemindTdbType *, TypeBuffer, SharemindTdbTypeLess> TypeBufferMap;
+    TypeBufferMap typeBuffers;
 
-            cleanup.clear();
-        }
+    BOOST_SCOPE_EXIT_ALL(&typeBuffers) {
+        for (auto & pair : typeBuffers)
+            if (pair.second.owned)
+                ::operator delete(pair.second.data);
+        typeBuffers.clear();
     };
 
-    // For each dataset, write the data
+    {
+        for (auto const & pair : typeValues) {
+            SharemindTdbType * const type = pair.first;
+
+            // Get the number of columns for this type
+            auto const tIt(const_cast<TypeCountMap const &>(typeCounts).find(
+                               type));
+            assert(tIt != typeCounts.end());
+
+            const size_type typeCols = tIt->second;
+
+            const std::vector<SharemindTdbValue *> & values = pair.second.values;
+            const std::vector<bool> & vac = pair.second.valueAsColumn;
+            const std::vector<const size_type *> & lengths = pair.second.lengths;
+            const std::vector<size_type> & rowCounts = pair.second.rowCounts;
+
+            TypeBuffer & typeBuffer =
+                    typeBuffers.emplace(type, TypeBuffer{nullptr, false})
+                        .first->second;
+            void * & buffer = typeBuffer.data;
+            bool & delBuffer = typeBuffer.owned;
+
+            if (isVariableLengthType(type)) {
+                assert(values.size() % typeCols == 0u);
+
+                buffer = ::operator new(insertedRowCount * typeCols * sizeof(hvl_t));
+                delBuffer = true;
+
+                // Each batch gives a value for every column of the type,
+                // holding either a single row or the rows packed back to back
+                hvl_t * const hvlBuffer = static_cast<hvl_t *>(buffer);
+                size_type row = 0u;
+                for (size_t i = 0u; i < values.size(); i += typeCols) {
+                    for (size_type col = 0u; col < typeCols; ++col) {
+                        SharemindTdbValue const * const val = values[i + col];
+                        const size_type * const valueLengths = lengths[i + col];
+
+                        if (!valueLengths) {
+                            hvl_t & hvl = hvlBuffer[row * typeCols + col];
+                            hvl.len = val->size;
+                            hvl.p = val->buffer;
+                            continue;
+                        }
+
+                        char * p = static_cast<char *>(val->buffer);
+                        for (size_type r = 0u; r < rowCounts[i + col]; ++r) {
+                            hvl_t & hvl = hvlBuffer[(row + r) * typeCols + col];
+                            hvl.len = valueLengths[r];
+                            hvl.p = p;
+                            p += valueLengths[r];
+                        }
+                    }
+
+                    row += rowCounts[i];
+                }
+
+                assert(row == insertedRowCount);
+            } else {
+                if (values.size() == 1u) {
+                    // Since we don't have to aggregate anything, we can use the
+                    // existing buffer.
+                    buffer = values.back()->buffer;
+                } else {
+                    // Copy the values into a continuous buffer
+                    buffer = ::operator new(insertedRowCount * typeCols * type->size);
+                    delBuffer = true;
+
+                    if (typeCols > 1u) {
+                        size_t offset = 0u;
+                        size_t transposeOffset = 0u;
+
+                        bool lastAsColumn = false;
+                        auto vacIt(vac.cbegin());
+
+                        for (SharemindTdbValue const * const val : values) {
+                            const bool asColumn = *vacIt++;
+                            std::memcpy(static_cast<char *>(buffer) + offset, val->buffer, val->size);
+
+                            // Check if we are at the beginning of a transposed
+                            // block
+                            if (!lastAsColumn && asColumn)
+                                transposeOffset = offset;
+
+                            // Check if we are at the end of a transposed block
+                            if (lastAsColumn && !asColumn)
+                                transposeBlock(static_cast<char *>(buffer) + transposeOffset,
+                                        static_cast<char *>(buffer) + offset,
+                                        (offset - transposeOffset) / (type->size * typeCols),
+                                        type->size);
+
+                            offset += val->size;
+                            lastAsColumn = asColumn;
+                        }
+
+                        // Check if we still need to transpose the last block
+                        if (lastAsColumn)
+                            transposeBlock(static_cast<char *>(buffer) + transposeOffset,
+                                    static_cast<char *>(buffer) + offset,
+                                    (offset - transposeOffset) / (type->size * typeCols),
+                                    type->size);
+                    } else {
+                        size_t offset = 0u;
+
+                        for (SharemindTdbValue const * const val : values) {
+                            std::memcpy(static_cast<char *>(buffer) + offset, val->buffer, val->size);
+                            offset += val->size;
+                        }
+                    }
+                }
+            }
+
+            assert(buffer);
+        }
+    }
+
+    // For each dataset, write the data
     // TODO move to a separate function
     {
+        // The values of the datasets are written together in the end
+        TdbHdf5DatasetBatch writes;
+
         for (auto const & pair : refTypes) {
             const hobj_ref_t dsetRef = pair.first;
             SharemindTdbType * const type = pair.second.first;
@@ -1635,7 +3094,15 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
                                type));
             assert(tIt != typeCounts.end());
 
-            const size_type dsetCols = tIt->second;
+            const size_type typeCols = tIt->second;
+
+            // Get the columns of the type stored in this dataset
+            auto const dcIt(
+                        const_cast<DatasetColumnsMap const &>(dsetColumns).find(
+                            dsetRef));
+            assert(dcIt != dsetColumns.end());
+
+            const size_type dsetCols = dcIt->second.count;
             // TODO sanity checks for row and column counts
 
             // Get dataset from reference. We already checked earlier if this is
@@ -1664,7 +3131,7 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
             };
 
             // Create a simple memory data space
-            const hsize_t mDims[] = { insertedRowCount, dsetCols };
+            const hsize_t mDims[] = { insertedRowCount, typeCols };
             const hid_t mSId = H5Screate_simple(2, mDims, nullptr);
             if (mSId < 0) {
                 m_logger.error() << "Failed to create memory data space for type \"" << type->domain << "::" << type->name << "\".";
@@ -1676,6 +3143,88 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
                     m_logger.fullDebug() << "Error while cleaning up memory data space.";
             };
 
+            // Select the columns of this dataset from the values of the type
+            if (dsetCols != typeCols) {
+                const hsize_t mStart[] = { 0u, dcIt->second.typeOffset };
+                const hsize_t mCount[] = { insertedRowCount, dsetCols };
+                if (H5Sselect_hyperslab(mSId, H5S_SELECT_SET, mStart, nullptr, mCount, nullptr) < 0) {
+                    m_logger.error() << "Failed to do selection in memory data space for type \"" << type->domain << "::" << type->name << "\".";
+                    return SHAREMIND_TDB_GENERAL_ERROR;
+                }
+            }
+
+            // Partitioned tables take the rows straight into the partitions
+            if (partitionRows > 0u) {
+                auto const tbIt(
+                            const_cast<TypeBufferMap const &>(typeBuffers).find(
+                                type));
+                assert(tbIt != typeBuffers.end());
+
+                const SharemindTdbError ecode =
+                        writePartitionRows(nameToPath(tbl),
+                                           oId,
+                                           tId,
+                                           mSId,
+                                           partitionRows,
+                                           rowCount,
+                                           insertedRowCount,
+                                           dcIt->second.typeOffset,
+                                           dsetCols,
+                                           tbIt->second.data,
+                                           partitionFiles,
+                                           createdPartitions);
+                if (ecode != SHAREMIND_TDB_OK)
+                    return ecode;
+                continue;
+            }
+
+            // Compacted tables can not grow any more
+            if (!isExtendibleDataset(oId)) {
+                m_logger.error() << "Table has been compacted, no more rows can be inserted.";
+                return SHAREMIND_TDB_GENERAL_ERROR;
+            }
+
+            // Append the values of a variable length column to its offsets
+            // and byte datasets
+            if (isVariableLengthType(type) && H5Tget_class(tId) == H5T_INTEGER) {
+                assert(dsetCols == 1u);
+
+                auto const tbIt(
+                            const_cast<TypeBufferMap const &>(typeBuffers).find(
+                                type));
+                assert(tbIt != typeBuffers.end());
+
+                // Register this dataset for cleanup
+                cleanup.emplace(dsetRef, std::pair<hsize_t, hsize_t>(rowCount, dsetCols));
+
+                const SharemindTdbError ecode =
+                        writeVlenColumn(fileId,
+                                        oId,
+                                        rowCount,
+                                        insertedRowCount,
+                                        static_cast<const hvl_t *>(tbIt->second.data)
+                                            + dcIt->second.typeOffset,
+                                        typeCols,
+                                        cleanup);
+                if (ecode != SHAREMIND_TDB_OK)
+                    return ecode;
+                continue;
+            }
+
+            auto const tbIt(
+                        const_cast<TypeBufferMap const &>(typeBuffers).find(
+                            type));
+            assert(tbIt != typeBuffers.end());
+
+            // The bit packing filter fails on other values
+            if (isBitType(type)
+                && hasFilter(oId, TDB_HDF5_FILTER_BITPACK)
+                && !isBitPackable(tbIt->second.data, insertedRowCount * typeCols))
+            {
+                m_logger.error() << "Bit packed columns only take the values 0 and 1.";
+                return SHAREMIND_TDB_INVALID_ARGUMENT;
+            }
+
             // Extend the dataset
             const hsize_t dims[] = { rowCount + insertedRowCount, dsetCols };
             if (H5Dset_extent(oId, dims) < 0) {
@@ -1686,6 +3235,36 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
             // Register this dataset for cleanup
             cleanup.emplace(dsetRef, std::pair<hsize_t, hsize_t>(rowCount, dsetCols));
 
+            // Write the whole chunks of the new rows directly, except for
+            // variable length values kept in the heap
+            hsize_t directRows = 0u;
+            if (!isVariableLengthType(type)) {
+                const SharemindTdbError ecode =
+                        writeDirectChunks(oId,
+                                          rowCount,
+                                          insertedRowCount,
+                                          typeCols,
+                                          dcIt->second.typeOffset,
+                                          dsetCols,
+                                          type->size,
+                                          tbIt->second.data,
+                                          directRows);
+                if (ecode != SHAREMIND_TDB_OK)
+                    return ecode;
+            }
+
+            if (directRows == insertedRowCount)
+                continue;
+
+            if (directRows > 0u) {
+                const hsize_t mStart[] = { directRows, dcIt->second.typeOffset };
+                const hsize_t mCount[] = { insertedRowCount - directRows, dsetCols };
+                if (H5Sselect_hyperslab(mSId, H5S_SELECT_SET, mStart, nullptr, mCount, nullptr) < 0) {
+                    m_logger.error() << "Failed to do selection in memory data space for type \"" << type->domain << "::" << type->name << "\".";
+                    return SHAREMIND_TDB_GENERAL_ERROR;
+                }
+            }
+
             // Get dataset data space
             const hid_t sId = H5Dget_space(oId);
             if (tId < 0) {
@@ -1699,104 +3278,26 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
             };
 
             // Select a hyperslab in the data space to write to
-            const hsize_t start[] = { rowCount, 0 };
-            const hsize_t count[] = { insertedRowCount, dsetCols };
+            const hsize_t start[] = { rowCount + directRows, 0 };
+            const hsize_t count[] = { insertedRowCount - directRows, dsetCols };
             if (H5Sselect_hyperslab(sId, H5S_SELECT_SET, start, nullptr, count, nullptr) < 0) {
                 m_logger.error() << "Failed to do selection in data space for type \"" << type->domain << "::" << type->name << "\".";
                 return SHAREMIND_TDB_GENERAL_ERROR;
             }
 
-            // Serialize the values
-            auto const tvIt(const_cast<TypeValueMap const &>(typeValues).find(
-                                type));
-            assert(tvIt != typeValues.end());
-            const std::vector<SharemindTdbValue *> & values = tvIt->second.values;
-            const std::vector<bool> & vac = tvIt->second.valueAsColumn;
-
-            // Aggregate the values into a single buffer
-            void * buffer = nullptr;
-            bool delBuffer = false;
-
-            if (isVariableLengthType(type)) {
-                assert(insertedRowCount * dsetCols == values.size());
-
-                buffer = ::operator new(insertedRowCount * dsetCols * sizeof(hvl_t));
-                delBuffer = true;
-
-                hvl_t * cursor = static_cast<hvl_t *>(buffer);
-                for (SharemindTdbValue const * const val : values) {
-                    cursor->len = val->size;
-                    cursor->p = val->buffer;
-                    ++cursor;
-                }
-            } else {
-                if (values.size() == 1u) {
-                    // Since we don't have to aggregate anything, we can use the
-                    // existing buffer.
-                    buffer = values.back()->buffer;
-                } else {
-                    // Copy the values into a continuous buffer
-                    buffer = ::operator new(insertedRowCount * dsetCols * type->size);
-                    delBuffer = true;
-
-                    if (dsetCols > 1u) {
-                        size_t offset = 0u;
-                        size_t transposeOffset = 0u;
-
-                        bool lastAsColumn = false;
-                        auto vacIt(vac.cbegin());
-
-                        for (SharemindTdbValue const * const val : values) {
-                            const bool asColumn = *vacIt++;
-                            std::memcpy(static_cast<char *>(buffer) + offset, val->buffer, val->size);
-
-                            // Check if we are at the beginning of a transposed
-                            // block
-                            if (!lastAsColumn && asColumn)
-                                transposeOffset = offset;
-
-                            // Check if we are at the end of a transposed block
-                            if (lastAsColumn && !asColumn)
-                                transposeBlock(static_cast<char *>(buffer) + transposeOffset,
-                                        static_cast<char *>(buffer) + offset,
-                                        (offset - transposeOffset) / (type->size * dsetCols),
-                                        type->size);
-
-                            offset += val->size;
-                            lastAsColumn = asColumn;
-                        }
-
-                        // Check if we still need to transpose the last block
-                        if (lastAsColumn)
-                            transposeBlock(static_cast<char *>(buffer) + transposeOffset,
-                                    static_cast<char *>(buffer) + offset,
-                                    (offset - transposeOffset) / (type->size * dsetCols),
-                                    type->size);
-                    } else {
-                        size_t offset = 0u;
-
-                        for (SharemindTdbValue const * const val : values) {
-                            std::memcpy(static_cast<char *>(buffer) + offset, val->buffer, val->size);
-                            offset += val->size;
-                        }
-                    }
-                }
-            }
-
-            assert(buffer);
-
-            BOOST_SCOPE_EXIT_ALL(&buffer, &delBuffer) {
-                if (delBuffer)
-                    ::operator delete(buffer);
-            };
-
-            // Write the values
-            if (H5Dwrite(oId, tId, mSId, sId, H5P_DEFAULT, buffer) < 0) {
-                m_logger.error() << "Failed to write values for type \""
+            // Queue the values for writing
+            if (!writes.add(oId, tId, mSId, sId, tbIt->second.data)) {
+                m_logger.error() << "Failed to queue values for type \""
                     << type->domain << "::" << type->name << "\".";
-                return SHAREMIND_TDB_IO_ERROR;
+                return SHAREMIND_TDB_GENERAL_ERROR;
             }
         }
+
+        // Write the values
+        if (writes.write() < 0) {
+            m_logger.error() << "Failed to write values.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
     }
 
     // Update row count
@@ -1810,12 +3311,34 @@ SharemindTdbError TdbHdf5Connection::insertRow(const std::string & tbl,
     if (H5Fflush(fileId, H5F_SCOPE_LOCAL) < 0)
         m_logger.fullDebug() << "Error while flushing buffers.";
 
+    if (temporary)
+        temporary->rowCount = rowCount + insertedRowCount;
+    else if (m_catalog)
+        m_catalog->setRowCount(tbl, rowCount + insertedRowCount);
+
+    if (m_undo) {
+        // Keep the pre-image of the first insertion of the operation
+        auto & inserted = m_undo->insertedRows.emplace(
+                    tbl,
+                    UndoRecord::InsertedRows{rowCount,
+                                             std::move(cleanup),
+                                             std::vector<fs::path>()}
+                    ).first->second;
+        inserted.createdPartitions.insert(inserted.createdPartitions.end(),
+                                          createdPartitions.begin(),
+                                          createdPartitions.end());
+
+        // Hide the new rows from readers until the insertion is committed
+        m_committedRowCounts.emplace(tbl, rowCount);
+    }
+
     success = true;
 
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
+SharemindTdbError TdbHdf5Connection::readColumn(const void * const owner,
+        const std::string & tbl,
         const std::vector<SharemindTdbString *> & colIdBatch,
         std::vector<std::vector<SharemindTdbValue *> > & valuesBatch)
 {
@@ -1841,7 +3364,7 @@ SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
     // Check if table exists
     {
         bool exists = false;
-        const SharemindTdbError ecode = tblExists(tbl, exists);
+        const SharemindTdbError ecode = tblExists(owner, tbl, exists);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
 
@@ -1852,12 +3375,26 @@ SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
     }
 
     // Open the table file
-    const hid_t fileId = openTableFile(tbl);
+    const hid_t fileId = openTableFile(owner, tbl);
     if (fileId < 0) {
         m_logger.error() << "Failed to open table file.";
         return SHAREMIND_TDB_IO_ERROR;
     }
 
+    BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+        releaseTableFile(owner, tbl);
+    };
+
+    // Read up to the committed row count, leaving out the rows of insertions
+    // still waiting for the consensus result. Operations on the connection
+    // are serialized by the caller, this is no lock against writers.
+    hsize_t rowCount = 0u;
+    {
+        const SharemindTdbError ecode = getCommittedRowCount(tbl, fileId, rowCount);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+    }
+
     // Check the column names
     if (!validateColumnNames(colIdBatch))
         return SHAREMIND_TDB_INVALID_ARGUMENT;
@@ -1876,7 +3413,7 @@ SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
     // Get the table column names
     std::vector<SharemindTdbString *> colNames;
     {
-        const SharemindTdbError ecode = tblColNames(tbl, colNames);
+        const SharemindTdbError ecode = tblColNames(owner, tbl, colNames);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
     }
@@ -1925,7 +3462,7 @@ SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
     }
 
     {
-        const SharemindTdbError ecode = readColumn(fileId, colNrBatch, valuesBatch);
+        const SharemindTdbError ecode = readColumn(fileId, rowCount, colNrBatch, valuesBatch);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
     }
@@ -1935,7 +3472,8 @@ SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
+SharemindTdbError TdbHdf5Connection::readColumn(const void * const owner,
+        const std::string & tbl,
         const std::vector<SharemindTdbIndex *> & colIdBatch,
         std::vector<std::vector<SharemindTdbValue *> > & valuesBatch)
 {
@@ -1961,7 +3499,7 @@ SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
     // Check if table exists
     {
         bool exists = false;
-        const SharemindTdbError ecode = tblExists(tbl, exists);
+        const SharemindTdbError ecode = tblExists(owner, tbl, exists);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
 
@@ -1972,12 +3510,26 @@ SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
     }
 
     // Open the table file
-    const hid_t fileId = openTableFile(tbl);
+    const hid_t fileId = openTableFile(owner, tbl);
     if (fileId < 0) {
         m_logger.error() << "Failed to open table file.";
         return SHAREMIND_TDB_IO_ERROR;
     }
 
+    BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+        releaseTableFile(owner, tbl);
+    };
+
+    // Read up to the committed row count, leaving out the rows of insertions
+    // still waiting for the consensus result. Operations on the connection
+    // are serialized by the caller, this is no lock against writers.
+    hsize_t rowCount = 0u;
+    {
+        const SharemindTdbError ecode = getCommittedRowCount(tbl, fileId, rowCount);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+    }
+
     // Get table column count
     hsize_t colCount = 0;
     {
@@ -2004,7 +3556,7 @@ SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
     }
 
     {
-        const SharemindTdbError ecode = readColumn(fileId, colIdBatch, valuesBatch);
+        const SharemindTdbError ecode = readColumn(fileId, rowCount, colIdBatch, valuesBatch);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
     }
@@ -2015,6 +3567,7 @@ SharemindTdbError TdbHdf5Connection::readColumn(const std::string & tbl,
 }
 
 SharemindTdbError TdbHdf5Connection::setAttributes(
+    const void * const owner,
     const std::string & tbl,
     const std::vector<std::pair<SharemindTdbString *, SharemindTdbString *>> & attributes)
 {
@@ -2028,10 +3581,23 @@ SharemindTdbError TdbHdf5Connection::setAttributes(
             m_logger.error() << "Failed to set attribute(s) in table \"" << tbl << "\".";
     };
 
+    if (!checkWritable("set attributes"))
+        return SHAREMIND_TDB_GENERAL_ERROR;
+
+    // SWMR does not allow creating attributes in a file open for writing,
+    // only the in-memory files of the temporary tables are not in SWMR mode
+    if (m_swmrMode == TdbHdf5ConnectionConf::SwmrMode::Write
+        && !findTemporaryTable(owner, tbl))
+    {
+        m_logger.error() << "Failed to set attributes: Connection is in SWMR "
+                            "write mode.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
     // Check if table exists
     {
         bool exists = false;
-        const SharemindTdbError ecode = tblExists(tbl, exists);
+        const SharemindTdbError ecode = tblExists(owner, tbl, exists);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
 
@@ -2042,12 +3608,16 @@ SharemindTdbError TdbHdf5Connection::setAttributes(
     }
 
     // Open the table file
-    const hid_t fileId = openTableFile(tbl);
+    const hid_t fileId = openTableFile(owner, tbl);
     if (fileId < 0) {
         m_logger.error() << "Failed to open table file.";
         return SHAREMIND_TDB_IO_ERROR;
     }
 
+    BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+        releaseTableFile(owner, tbl);
+    };
+
     hid_t gId = H5Gopen(fileId, USR_ATTR_GROUP, H5P_DEFAULT);
     if (gId < 0) {
         m_logger.error() << "Failed to open group " << USR_ATTR_GROUP;
@@ -2179,6 +3749,7 @@ herr_t getAttr(hid_t location_id,
 } /* namespace { */
 
 SharemindTdbError TdbHdf5Connection::getAttributes(
+    const void * const owner,
     const std::string & tbl,
     std::vector<std::pair<SharemindTdbString *, SharemindTdbString *>> & attributes)
 {
@@ -2195,7 +3766,7 @@ SharemindTdbError TdbHdf5Connection::getAttributes(
     // Check if table exists
     {
         bool exists = false;
-        const SharemindTdbError ecode = tblExists(tbl, exists);
+        const SharemindTdbError ecode = tblExists(owner, tbl, exists);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
 
@@ -2206,12 +3777,16 @@ SharemindTdbError TdbHdf5Connection::getAttributes(
     }
 
     // Open the table file
-    const hid_t fileId = openTableFile(tbl);
+    const hid_t fileId = openTableFile(owner, tbl);
     if (fileId < 0) {
         m_logger.error() << "Failed to open table file.";
         return SHAREMIND_TDB_IO_ERROR;
     }
 
+    BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+        releaseTableFile(owner, tbl);
+    };
+
     hid_t gId = H5Gopen(fileId, USR_ATTR_GROUP, H5P_DEFAULT);
     if (gId < 0) {
         m_logger.error() << "Failed to open group " << USR_ATTR_GROUP;
@@ -2223,6 +3798,11 @@ SharemindTdbError TdbHdf5Connection::getAttributes(
             m_logger.error() << "Error while cleaning up attribute group.";
     };
 
+    if (!refreshObject(gId)) {
+        m_logger.error() << "Failed to refresh group " << USR_ATTR_GROUP;
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
     attributes.clear();
     IterData iterData {m_logger, attributes, gId};
     hsize_t idx = 0;
@@ -2237,52 +3817,303 @@ SharemindTdbError TdbHdf5Connection::getAttributes(
     return SHAREMIND_TDB_OK;
 }
 
-bool TdbHdf5Connection::pathExists(const fs::path & path, bool & status) {
-    try {
-        status = fs::exists(path);
-    } catch (const fs::filesystem_error & e) {
-        m_logger.error() << "Error while checking if file " << path.string()
-                         << " exists: " << e.what();
-        return false;
+void TdbHdf5Connection::warmUp(const std::vector<std::string> & tables,
+                               const std::size_t recentTables)
+{
+    std::vector<std::string> names(tables);
+    if (m_catalog) {
+        m_catalog->recentNames(recentTables, names);
+    } else if (recentTables) {
+        m_logger.warning() << "Recently modified tables are not known in SWMR "
+                              "read mode, not warming them up.";
     }
 
-    return true;
-}
+    std::set<std::string> warmedUp;
+    for (auto const & tbl : names) {
+        if (warmedUp.size() == m_maxOpenTableFiles) {
+            m_logger.warning() << "Not warming up more tables than the open "
+                                  "table file limit allows.";
+            break;
+        }
 
-bool TdbHdf5Connection::validateColumnNames(const std::vector<SharemindTdbString *> & names) const {
-    for (auto const * const str : names) {
-        assert(str);
+        if (!validateTableName(tbl) || !warmedUp.emplace(tbl).second)
+            continue;
 
-        const size_t size = strlen(str->str);
-        if (size == 0) {
-            m_logger.error() << "Column name must be a non-empty string.";
-            return false;
+        bool exists = false;
+        if (tblExists(nullptr, tbl, exists) != SHAREMIND_TDB_OK || !exists) {
+            m_logger.warning() << "Not warming up table \"" << tbl
+                               << "\": Table does not exist.";
+            warmedUp.erase(tbl);
+            continue;
         }
-        if (size > COL_NAME_SIZE_MAX) {
-            m_logger.error() << "Column name too long. Maximum length is " << COL_NAME_SIZE_MAX << ".";
-            return false;
+
+        // Reading the column meta info opens the table file and loads the
+        // table structure into the HDF5 metadata cache
+        std::vector<SharemindTdbString *> colNames;
+        BOOST_SCOPE_EXIT_ALL(&colNames) {
+            for (auto * const name : colNames)
+                SharemindTdbString_delete(name);
+        };
+
+        std::vector<SharemindTdbType *> colTypes;
+        BOOST_SCOPE_EXIT_ALL(&colTypes) {
+            for (auto * const type : colTypes)
+                SharemindTdbType_delete(type);
+        };
+
+        if (tblColNames(nullptr, tbl, colNames) != SHAREMIND_TDB_OK
+            || tblColTypes(nullptr, tbl, colTypes) != SHAREMIND_TDB_OK)
+        {
+            m_logger.warning() << "Failed to warm up table \"" << tbl << "\".";
+            warmedUp.erase(tbl);
         }
     }
 
-    return true;
+    m_logger.fullDebug() << "Warmed up " << warmedUp.size() << " tables in "
+                         << m_path.string() << '.';
 }
 
-bool TdbHdf5Connection::validateTableName(const std::string & tbl) const {
-    static auto const testValidChar =
-            [this](char const c) noexcept {
-                switch (c) {
-                case '\0':
-                    m_logger.error() << "Table name contains NULL characters!";
-                    return false;
-                case '/':
-                    m_logger.error() << "Table name contains '/' characters!";
-                    return false;
-                default:
-                    return true;
-                }
-            };
-    switch (tbl.size()) {
-    case 0u:
+bool TdbHdf5Connection::rollback(UndoRecord & undo) {
+    H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
+
+    bool success = true;
+    const void * const owner = undo.owner;
+
+    // Restore the deleted temporary tables first, the insertions into them
+    // and their creations are undone below
+    if (!undo.deletedTemporaryTables.empty()) {
+        m_temporaryTables[owner].insert(
+                    undo.deletedTemporaryTables.begin(),
+                    undo.deletedTemporaryTables.end());
+        undo.deletedTemporaryTables.clear();
+    }
+
+    // Drop the rows appended to the tables
+    for (auto const & vp : undo.insertedRows) {
+        const std::string & tbl = vp.first;
+
+        const hid_t fileId = openTableFile(owner, tbl);
+        if (fileId < 0) {
+            m_logger.error() << "Failed to roll back insertion into table \""
+                             << tbl << "\": Failed to open table file.";
+            success = false;
+            continue;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+            releaseTableFile(owner, tbl);
+        };
+
+        if (!restoreExtents(fileId, vp.second.extents)
+            || setRowCount(fileId, vp.second.rowCount) != SHAREMIND_TDB_OK)
+        {
+            m_logger.error() << "Failed to roll back insertion into table \""
+                             << tbl << "\".";
+            success = false;
+            continue;
+        }
+
+        if (H5Fflush(fileId, H5F_SCOPE_LOCAL) < 0)
+            m_logger.fullDebug() << "Error while flushing buffers.";
+
+        // The restored extents no longer reach the partitions created for
+        // the rows
+        removePartitions(vp.second.createdPartitions);
+
+        if (TemporaryTable * const temporary = findTemporaryTable(owner, tbl))
+            temporary->rowCount = vp.second.rowCount;
+        else if (m_catalog)
+            m_catalog->setRowCount(tbl, vp.second.rowCount);
+    }
+
+    // Remove the created tables
+    for (const std::string & tbl : undo.createdTables) {
+        if (findTemporaryTable(owner, tbl)) {
+            if (!dropTemporaryTable(owner, tbl)) {
+                m_logger.error() << "Failed to roll back creation of "
+                                    "temporary table \"" << tbl << "\".";
+                success = false;
+            }
+            continue;
+        }
+
+        closeTableFile(tbl);
+
+        bool contained = false;
+        if (!inContainer(tbl, contained)
+            || (contained && H5Ldelete(m_containerId, containerTableName(tbl).c_str(), H5P_DEFAULT) < 0))
+        {
+            m_logger.error() << "Failed to roll back creation of table \""
+                             << tbl << "\" in the container file.";
+            success = false;
+            continue;
+        }
+
+        const fs::path tblPath = nameToPath(tbl);
+        try {
+            fs::remove(tblPath);
+            fs::remove_all(partitionsPath(tblPath));
+        } catch (const fs::filesystem_error & e) {
+            m_logger.error() << "Failed to roll back creation of table \""
+                             << tbl << "\": " << e.what() << ".";
+            success = false;
+            continue;
+        }
+
+        if (m_catalog)
+            m_catalog->remove(tbl);
+    }
+
+    // Restore the deleted tables
+    for (auto const & vp : undo.deletedTables) {
+        const std::string & tbl = vp.first;
+        if (vp.second.inContainer) {
+            if (H5Lmove(m_containerId, containerDeletedName(tbl).c_str(), m_containerId, containerTableName(tbl).c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0) {
+                m_logger.error() << "Failed to roll back deletion of table \""
+                                 << tbl << "\" in the container file.";
+                success = false;
+                continue;
+            }
+
+            if (m_catalog && vp.second.inCatalog)
+                m_catalog->add(tbl, vp.second.catalogEntry);
+            continue;
+        }
+
+        try {
+            const fs::path tblPath = nameToPath(tbl);
+            fs::rename(vp.second.path, tblPath);
+            if (!vp.second.partitionsPath.empty())
+                fs::rename(vp.second.partitionsPath, partitionsPath(tblPath));
+        } catch (const fs::filesystem_error & e) {
+            m_logger.error() << "Failed to roll back deletion of table \""
+                             << tbl << "\": " << e.what() << ".";
+            success = false;
+            continue;
+        }
+
+        if (m_catalog && vp.second.inCatalog)
+            m_catalog->add(tbl, vp.second.catalogEntry);
+    }
+
+    // Put back the table files replaced by their compacted copies, unless
+    // the tables were created by the operation
+    for (auto const & vp : undo.compactedTables) {
+        const std::string & tbl = vp.first;
+        closeTableFile(tbl);
+
+        try {
+            if (undo.createdTables.find(tbl) != undo.createdTables.end()) {
+                fs::remove(vp.second);
+            } else {
+                fs::rename(vp.second, nameToPath(tbl));
+            }
+        } catch (const fs::filesystem_error & e) {
+            m_logger.error() << "Failed to roll back compaction of table \""
+                             << tbl << "\": " << e.what() << ".";
+            success = false;
+        }
+    }
+
+    for (auto const & vp : undo.insertedRows)
+        m_committedRowCounts.erase(vp.first);
+
+    undo = UndoRecord();
+
+    return success;
+}
+
+void TdbHdf5Connection::commit(UndoRecord & undo) {
+    for (auto const & vp : undo.deletedTemporaryTables) {
+        if (!closeTemporaryTable(vp.first, vp.second))
+            m_logger.warning() << "Error while closing deleted temporary table \""
+                               << vp.first << "\".";
+    }
+
+    // Remove the files of the deleted tables for good
+    for (auto const & vp : undo.deletedTables) {
+        if (vp.second.inContainer) {
+            if (H5Ldelete(m_containerId, containerDeletedName(vp.first).c_str(), H5P_DEFAULT) < 0)
+                m_logger.warning() << "Error while removing deleted table \""
+                                   << vp.first << "\" from the container file.";
+            continue;
+        }
+
+        try {
+            fs::remove(vp.second.path);
+            if (!vp.second.partitionsPath.empty())
+                fs::remove_all(vp.second.partitionsPath);
+        } catch (const fs::filesystem_error & e) {
+            m_logger.warning() << "Error while removing file "
+                               << vp.second.path.string() << " of deleted table \""
+                               << vp.first << "\": " << e.what() << ".";
+        }
+    }
+
+    // Drop the table files replaced by their compacted copies
+    for (auto const & vp : undo.compactedTables) {
+        try {
+            fs::remove(vp.second);
+        } catch (const fs::filesystem_error & e) {
+            m_logger.warning() << "Error while removing file "
+                               << vp.second.string() << " of compacted table \""
+                               << vp.first << "\": " << e.what() << ".";
+        }
+    }
+
+    // Make the inserted rows visible to readers
+    for (auto const & vp : undo.insertedRows)
+        m_committedRowCounts.erase(vp.first);
+
+    undo = UndoRecord();
+}
+
+bool TdbHdf5Connection::pathExists(const fs::path & path, bool & status) {
+    try {
+        status = fs::exists(path);
+    } catch (const fs::filesystem_error & e) {
+        m_logger.error() << "Error while checking if file " << path.string()
+                         << " exists: " << e.what();
+        return false;
+    }
+
+    return true;
+}
+
+bool TdbHdf5Connection::validateColumnNames(const std::vector<SharemindTdbString *> & names) const {
+    for (auto const * const str : names) {
+        assert(str);
+
+        const size_t size = strlen(str->str);
+        if (size == 0) {
+            m_logger.error() << "Column name must be a non-empty string.";
+            return false;
+        }
+        if (size > COL_NAME_SIZE_MAX) {
+            m_logger.error() << "Column name too long. Maximum length is " << COL_NAME_SIZE_MAX << ".";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TdbHdf5Connection::validateTableName(const std::string & tbl) const {
+    static auto const testValidChar =
+            [this](char const c) noexcept {
+                switch (c) {
+                case '\0':
+                    m_logger.error() << "Table name contains NULL characters!";
+                    return false;
+                case '/':
+                    m_logger.error() << "Table name contains '/' characters!";
+                    return false;
+                default:
+                    return true;
+                }
+            };
+    switch (tbl.size()) {
+    case 0u:
         m_logger.error() << "Table name must be a non-empty string!";
         return false;
     case 1u: {
@@ -2344,28 +4175,17 @@ bool TdbHdf5Connection::validateValues(const std::vector<SharemindTdbValue *> &
 boost::filesystem::path TdbHdf5Connection::nameToPath(const std::string & tbl) {
     assert(!tbl.empty());
 
-    // TODO Should we try to eliminate the copying?
-    fs::path p(m_path);
-    p /= tbl + FILE_EXT;
-
-    return p;
+    return m_storage.tablePath(tbl);
 }
 
 SharemindTdbError TdbHdf5Connection::readColumn(const hid_t fileId,
+                                   const hsize_t rowCount,
                                    const std::vector<SharemindTdbIndex *> & colNrBatch,
                                    std::vector<std::vector<SharemindTdbValue *> > & valuesBatch)
 {
     // Set the cleanup flag
     bool success = false;
 
-    // Get table row count
-    hsize_t rowCount = 0;
-    {
-        const SharemindTdbError ecode = getRowCount(fileId, rowCount);
-        if (ecode != SHAREMIND_TDB_OK)
-            return ecode;
-    }
-
     // Declare a partial column index type
     struct PartialColumnIndex {
         hobj_ref_t dataset_ref;
@@ -2482,21 +4302,30 @@ SharemindTdbError TdbHdf5Connection::readColumn(const hid_t fileId,
         }
     };
 
-    // Read the columns
+    // Read the columns, the reads of the datasets are done together
+    TdbHdf5DatasetBatch reads;
     for (auto const & vp : dsetBatch) {
         SharemindTdbError const ecode =
-                readDatasetColumn(fileId, vp.first, vp.second);
+                readDatasetColumn(fileId, vp.first, rowCount, vp.second, reads);
         if (ecode != SHAREMIND_TDB_OK)
             return ecode;
     }
 
+    if (reads.read() < 0) {
+        m_logger.error() << "Failed to read the datasets.";
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
     success = true;
 
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::readDatasetColumn(const hid_t fileId, const hobj_ref_t ref,
-        const std::vector<std::pair<hsize_t, std::vector<SharemindTdbValue *> *> > & paramBatch) {
+SharemindTdbError TdbHdf5Connection::readDatasetColumn(const hid_t fileId,
+        const hobj_ref_t ref,
+        const hsize_t rowCount,
+        const std::vector<std::pair<hsize_t, std::vector<SharemindTdbValue *> *> > & paramBatch,
+        TdbHdf5DatasetBatch & reads) {
     assert(paramBatch.size());
 
     // Get dataset from reference
@@ -2523,6 +4352,12 @@ SharemindTdbError TdbHdf5Connection::readDatasetColumn(const hid_t fileId, const
         return SHAREMIND_TDB_GENERAL_ERROR;
     }
 
+    // Pick up the extent last flushed by the writer
+    if (!refreshObject(oId)) {
+        m_logger.error() << "Failed to refresh dataset.";
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
     // Get data space
     const hid_t sId = H5Dget_space(oId);
     if (sId < 0) {
@@ -2555,7 +4390,12 @@ SharemindTdbError TdbHdf5Connection::readDatasetColumn(const hid_t fileId, const
         return SHAREMIND_TDB_GENERAL_ERROR;
     }
 
-    // TODO check dims[0] against row count attribute?
+    // Rows past the committed row count of the table are left unread, but
+    // the dataset must hold at least that many
+    if (dims[0] < rowCount) {
+        m_logger.error() << "Dataset has fewer rows than the table.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
 
     // Check if column offset is in range
     for (auto const & param : paramBatch) {
@@ -2612,10 +4452,13 @@ SharemindTdbError TdbHdf5Connection::readDatasetColumn(const hid_t fileId, const
             m_logger.fullDebug() << "Error while cleaning up dataset type attribute object.";
     };
 
+    const bool vlenOffsets =
+            isVariableLengthType(type.get()) && isVlenOffsetsDataset(oId);
+
     {
         for (auto const & param : paramBatch) {
             // Check if we have anything to read
-            if (dims[0] == 0) {
+            if (rowCount == 0) {
                 // TODO check if this is handled correctly
                 auto val(SharemindTdbValue_new(type->domain,
                                                type->name,
@@ -2628,28 +4471,25 @@ SharemindTdbError TdbHdf5Connection::readDatasetColumn(const hid_t fileId, const
                     SharemindTdbValue_delete(val);
                     throw;
                 }
+            } else if (vlenOffsets) {
+                const SharemindTdbError ecode =
+                        readVlenColumn(fileId, oId, rowCount, *type, *param.second);
+                if (ecode != SHAREMIND_TDB_OK)
+                    return ecode;
             } else {
                 void * buffer = nullptr;
                 size_type bufferSize = 0;
 
                 // Read the column data
                 if (isVariableLengthType(type.get())) {
-                    buffer = ::operator new(dims[0] * sizeof(hvl_t));
+                    buffer = ::operator new(rowCount * sizeof(hvl_t));
                 } else {
-                    bufferSize = dims[0] * type->size;
+                    bufferSize = rowCount * type->size;
                     buffer = ::operator new(bufferSize);
                 }
 
                 assert(buffer);
 
-                // Select a hyperslab in the data space to read from
-                const hsize_t start[] = { 0, param.first };
-                const hsize_t count[] = { dims[0], 1 };
-                if (H5Sselect_hyperslab(sId, H5S_SELECT_SET, start, nullptr, count, nullptr) < 0) {
-                    m_logger.error() << "Failed to do selection in dataset data space.";
-                    return SHAREMIND_TDB_GENERAL_ERROR;
-                }
-
                 // Get dataset type
                 const hid_t tId = H5Dget_type(oId);
                 if (tId < 0) {
@@ -2663,7 +4503,7 @@ SharemindTdbError TdbHdf5Connection::readDatasetColumn(const hid_t fileId, const
                 };
 
                 // Create a simple memory data space
-                const hsize_t mDims[] = { dims[0], 1 };
+                const hsize_t mDims[] = { rowCount, 1 };
                 const hid_t mSId = H5Screate_simple(2, mDims, nullptr);
                 if (mSId < 0) {
                     m_logger.error() << "Failed to create memory data space for column data.";
@@ -2675,16 +4515,61 @@ SharemindTdbError TdbHdf5Connection::readDatasetColumn(const hid_t fileId, const
                         m_logger.fullDebug() << "Error while cleaning up memory data space for column data.";
                 };
 
-                // Read the dataset data
-                if (H5Dread(oId, tId, mSId, sId, H5P_DEFAULT, buffer) < 0) {
-                    m_logger.error() << "Failed to read the dataset.";
-                    return SHAREMIND_TDB_IO_ERROR;
+                // Serve compacted datasets straight from the file and scan
+                // the chunks of the others directly
+                const bool direct =
+                        !isVariableLengthType(type.get())
+                        && (readMappedColumn(fileId,
+                                             oId,
+                                             dims[1],
+                                             param.first,
+                                             rowCount,
+                                             type->size,
+                                             buffer)
+                            || readDirectChunks(oId,
+                                                param.first,
+                                                rowCount,
+                                                type->size,
+                                                buffer));
+
+                if (!direct) {
+                    // Each column has a selection of its own
+                    const hid_t fSId = H5Scopy(sId);
+                    if (fSId < 0) {
+                        m_logger.error() << "Failed to copy dataset data space.";
+                        return SHAREMIND_TDB_GENERAL_ERROR;
+                    }
+
+                    BOOST_SCOPE_EXIT_ALL(this, fSId) {
+                        if (H5Sclose(fSId) < 0)
+                            m_logger.fullDebug() << "Error while cleaning up dataset data space.";
+                    };
+
+                    // Select a hyperslab in the data space to read from
+                    const hsize_t start[] = { 0, param.first };
+                    const hsize_t count[] = { rowCount, 1 };
+                    if (H5Sselect_hyperslab(fSId, H5S_SELECT_SET, start, nullptr, count, nullptr) < 0) {
+                        m_logger.error() << "Failed to do selection in dataset data space.";
+                        return SHAREMIND_TDB_GENERAL_ERROR;
+                    }
+
+                    // Read variable length values right away to copy them
+                    // out of the heap, the others along with the batch
+                    if (isVariableLengthType(type.get())) {
+                        if (H5Dread(oId, tId, mSId, fSId, H5P_DEFAULT, buffer) < 0) {
+                            m_logger.error() << "Failed to read the dataset.";
+                            return SHAREMIND_TDB_IO_ERROR;
+                        }
+                    } else if (!reads.add(oId, tId, mSId, fSId, buffer)) {
+                        m_logger.error() << "Failed to queue the dataset read.";
+                        return SHAREMIND_TDB_GENERAL_ERROR;
+                    }
                 }
 
                 if (isVariableLengthType(type.get())) {
                     hvl_t * const hvlBuffer = static_cast<hvl_t *>(buffer);
 
-                    for (hsize_t i = 0; i < dims[0]; ++i) {
+                    for (hsize_t i = 0; i < rowCount; ++i) {
                         auto val(std::make_unique<SharemindTdbValue>());
                         val->type = SharemindTdbType_new(type->domain,
                                                          type->name,
@@ -2737,128 +4622,1912 @@ SharemindTdbError TdbHdf5Connection::readDatasetColumn(const hid_t fileId, const
     return SHAREMIND_TDB_OK;
 }
 
-SharemindTdbError TdbHdf5Connection::objRefToType(const hid_t fileId, const hobj_ref_t ref, hid_t & aId, SharemindTdbType & type) {
-    // Get the dataset from the reference
-    const hid_t oId = H5Rdereference(fileId, H5R_OBJECT, &ref);
-    if (oId < 0) {
-        m_logger.error() << "Failed to dereference object.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
-    }
-
-    BOOST_SCOPE_EXIT_ALL(this, oId) {
-        if (H5Oclose(oId) < 0)
-            m_logger.fullDebug() << "Error while cleaning up dataset.";
-    };
-
-    // Check the reference object type
-    H5O_type_t rType = H5O_TYPE_UNKNOWN;
-    if (H5Rget_obj_type(oId, H5R_OBJECT, &ref, &rType) < 0) {
-        m_logger.error() << "Failed to get reference object type.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
-    }
+bool TdbHdf5Connection::readMappedColumn(const hid_t fileId,
+        const hid_t oId,
+        const hsize_t columns,
+        const hsize_t column,
+        const hsize_t rowCount,
+        const size_t size,
+        void * const buffer)
+{
+    assert(column < columns);
+    assert(rowCount > 0u);
+    assert(buffer);
 
-    if (rType != H5O_TYPE_DATASET) {
-        m_logger.error() << "Invalid dataset reference object.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
-    }
+    // Only contiguous datasets have their data in a single file region,
+    // which the asynchronous VOL connector does not give out
+    if (m_asyncVol || !isContiguousDataset(oId))
+        return false;
 
-    // Open the type attribute
-    aId = H5Aopen(oId, DATASET_TYPE_ATTR, H5P_DEFAULT);
-    if (aId < 0) {
-        m_logger.error() << "Failed to open dataset type attribute.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
-    }
+    const haddr_t offset = H5Dget_offset(oId);
+    if (offset == HADDR_UNDEF)
+        return false;
 
-    bool closeAttr = true;
+    // Check that the values are stored as they are
+    {
+        const hid_t tId = H5Dget_type(oId);
+        if (tId < 0)
+            return false;
 
-    BOOST_SCOPE_EXIT_ALL(&closeAttr, this, aId) {
-        if (closeAttr && H5Aclose(aId) < 0)
-            m_logger.fullDebug() << "Error while cleaning up dataset type attribute.";
-    };
+        BOOST_SCOPE_EXIT_ALL(this, tId) {
+            if (H5Tclose(tId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up dataset type.";
+        };
 
-    // Open the type attribute type
-    const hid_t aTId = H5Aget_type(aId);
-    if (aTId < 0) {
-        m_logger.error() << "Failed to get dataset type attribute type.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
+        if (H5Tget_class(tId) != H5T_OPAQUE || H5Tget_size(tId) != size)
+            return false;
     }
 
-    BOOST_SCOPE_EXIT_ALL(this, aTId) {
-        if (H5Tclose(aTId) < 0)
-            m_logger.fullDebug() << "Error while cleaning up dataset type attribute type.";
-    };
+    // Get the descriptor of the table file
+    int fd = -1;
+    {
+        const hid_t faplId = H5Fget_access_plist(fileId);
+        if (faplId < 0)
+            return false;
 
-    // Read the type attribute
-    if (H5Aread(aId, aTId, &type) < 0) {
-        m_logger.error() << "Failed to read dataset type attribute type.";
-        return SHAREMIND_TDB_IO_ERROR;
-    }
+        BOOST_SCOPE_EXIT_ALL(this, faplId) {
+            if (H5Pclose(faplId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up file access property list.";
+        };
 
-    closeAttr = false;
+        // Both drivers give the descriptor of the file as its handle
+        if (H5Pget_driver(faplId) != H5FD_SEC2
+            && !isIoUringFileDriver(faplId))
+            return false;
 
-    return SHAREMIND_TDB_OK;
-}
+        void * handle = nullptr;
+        if (H5Fget_vfd_handle(fileId, faplId, &handle) < 0 || !handle)
+            return false;
 
-SharemindTdbError TdbHdf5Connection::getColumnCount(const hid_t fileId, hsize_t & ncols) {
-    // Get dataset
-    const hid_t dId = H5Dopen(fileId, COL_INDEX_DATASET, H5P_DEFAULT);
-    if (dId < 0) {
-        m_logger.error() << "Failed to open column meta info dataset.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
+        fd = *static_cast<int *>(handle);
     }
 
-    BOOST_SCOPE_EXIT_ALL(this, dId) {
-        if (H5Dclose(dId) < 0)
-            m_logger.fullDebug() << "Error while cleaning up column meta info dataset.";
-    };
-
-    // Get data space
-    const hid_t sId = H5Dget_space(dId);
-    if (sId < 0) {
-        m_logger.error() << "Failed to open column meta info data space.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
+    // Map the pages holding the rows to read
+    static const haddr_t pageSize =
+            static_cast<haddr_t>(::sysconf(_SC_PAGESIZE));
+    const haddr_t mapOffset = offset - offset % pageSize;
+    const size_t dataSize = rowCount * columns * size;
+    const size_t mapSize = (offset - mapOffset) + dataSize;
+
+    void * const map = ::mmap(nullptr,
+                              mapSize,
+                              PROT_READ,
+                              MAP_SHARED,
+                              fd,
+                              static_cast<off_t>(mapOffset));
+    if (map == MAP_FAILED) {
+        m_logger.fullDebug() << "Failed to map dataset into memory.";
+        return false;
     }
 
-    BOOST_SCOPE_EXIT_ALL(this, sId) {
-        if (H5Sclose(sId) < 0)
-            m_logger.fullDebug() << "Error while cleaning up column meta info data space.";
+    BOOST_SCOPE_EXIT_ALL(this, map, mapSize) {
+        if (::munmap(map, mapSize) != 0)
+            m_logger.fullDebug() << "Error while unmapping dataset.";
     };
 
-    // Get data space rank
-    const int rank = H5Sget_simple_extent_ndims(sId);
-    if (rank < 0) {
-        m_logger.error() << "Failed to get column meta info data space rank.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
-    }
+    ::madvise(map, mapSize, MADV_SEQUENTIAL);
 
-    // Check data space rank
-    if (rank != 1) {
-        m_logger.error() << "Invalid rank for column meta info data space.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
-    }
+    const char * const data =
+            static_cast<const char *>(map) + (offset - mapOffset);
 
-    // Get size of data space
-    if (H5Sget_simple_extent_dims(sId, &ncols, nullptr) < 0) {
-        m_logger.error() << "Failed to get column count from column meta info.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
+    // Copy the column out of the row major data
+    if (columns == 1u) {
+        std::memcpy(buffer, data, dataSize);
+    } else {
+        const char * src = data + column * size;
+        char * dst = static_cast<char *>(buffer);
+        for (hsize_t i = 0u; i < rowCount; ++i) {
+            std::memcpy(dst, src, size);
+            src += columns * size;
+            dst += size;
+        }
     }
 
-    return SHAREMIND_TDB_OK;
+    return true;
 }
 
-SharemindTdbError TdbHdf5Connection::getRowCount(const hid_t fileId, hsize_t & nrows) {
-    // Open meta info group
-    const hid_t gId = H5Gopen(fileId, META_GROUP, H5P_DEFAULT);
-    if (gId < 0) {
-        m_logger.error() << "Failed to get row count: Failed to open meta info group.";
-        return SHAREMIND_TDB_GENERAL_ERROR;
-    }
+bool TdbHdf5Connection::readDirectChunks(const hid_t oId,
+        const hsize_t column,
+        const hsize_t rowCount,
+        const size_t size,
+        void * const buffer)
+{
+    assert(rowCount > 0u);
+    assert(buffer);
+
+    #if H5_VERSION_GE(1,10,3)
+    if (m_asyncVol)
+        return false;
+
+    const hid_t plistId = H5Dget_create_plist(oId);
+    if (plistId < 0)
+        return false;
+
+    BOOST_SCOPE_EXIT_ALL(this, plistId) {
+        if (H5Pclose(plistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset creation property list.";
+    };
+
+    // Scans shorter than a chunk are better served by the chunk cache
+    hsize_t dimsChunk[2];
+    if (H5Pget_layout(plistId) != H5D_CHUNKED
+        || H5Pget_chunk(plistId, 2, dimsChunk) != 2
+        || rowCount < dimsChunk[0])
+        return false;
+
+    // Check that the values are stored as they are
+    {
+        const hid_t tId = H5Dget_type(oId);
+        if (tId < 0)
+            return false;
+
+        BOOST_SCOPE_EXIT_ALL(this, tId) {
+            if (H5Tclose(tId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up dataset type.";
+        };
+
+        if (H5Tget_class(tId) != H5T_OPAQUE || H5Tget_size(tId) != size)
+            return false;
+    }
+
+    // Filtered chunks only gain from being unfiltered on several threads
+    TdbHdf5ChunkFilters filters;
+    if (!filters.load(plistId)
+        || (!filters.empty() && m_chunkWorkerThreads < 2u))
+        return false;
+
+    const hsize_t chunkRows = dimsChunk[0];
+    const hsize_t chunkCols = dimsChunk[1];
+    const hsize_t colOffset = column / chunkCols * chunkCols;
+    const hsize_t chunkCol = column % chunkCols;
+    const size_t chunkCount = (rowCount + chunkRows - 1u) / chunkRows;
+    const size_t chunkSize = chunkRows * chunkCols * size;
+    const size_t batchChunks =
+            std::min(std::max(DIRECT_BATCH_SIZE / chunkSize, static_cast<size_t>(1u)),
+                     chunkCount);
+
+    char * const values = static_cast<char *>(buffer);
+    std::vector<std::vector<unsigned char> > chunks(batchChunks);
+    std::vector<unsigned> filterMasks(batchChunks);
+
+    for (size_t first = 0u; first < chunkCount; first += batchChunks) {
+        const size_t count = std::min(batchChunks, chunkCount - first);
+
+        // Read the chunks of the batch in order, HDF5 is not thread-safe.
+        // Dirty chunks are flushed from the chunk cache before being read.
+        for (size_t i = 0u; i < count; ++i) {
+            const hsize_t row = (first + i) * chunkRows;
+            const hsize_t offset[] = { row, colOffset };
+
+            hsize_t storageSize = 0u;
+            if (H5Dget_chunk_storage_size(oId, offset, &storageSize) < 0
+                || storageSize == 0u)
+                return false;
+
+            // Whole unfiltered column chunks are read into place
+            std::vector<unsigned char> & chunk = chunks[i];
+            void * dst = nullptr;
+            if (filters.empty() && chunkCols == 1u
+                && row + chunkRows <= rowCount)
+            {
+                if (storageSize != chunkSize)
+                    return false;
+                chunk.clear();
+                dst = values + row * size;
+            } else {
+                chunk.resize(storageSize);
+                dst = chunk.data();
+            }
+
+            if (H5Dread_chunk(oId, H5P_DEFAULT, offset, &filterMasks[i], dst) < 0)
+                return false;
+        }
+
+        // Unfilter the chunks and copy out the column
+        auto const scatter = [&](size_t const i,
+                                 std::vector<unsigned char> & scratch)
+        {
+            std::vector<unsigned char> & chunk = chunks[i];
+            if (chunk.empty())
+                return true;
+
+            if (!filters.decode(chunk, scratch, filterMasks[i])
+                || chunk.size() != chunkSize)
+                return false;
+
+            const hsize_t row = (first + i) * chunkRows;
+            const hsize_t rows = std::min(chunkRows, rowCount - row);
+            const unsigned char * src = chunk.data() + chunkCol * size;
+            char * dst = values + row * size;
+            for (hsize_t j = 0u; j < rows; ++j) {
+                std::memcpy(dst, src, size);
+                src += chunkCols * size;
+                dst += size;
+            }
+            return true;
+        };
+
+        const size_t threads =
+                filters.empty()
+                ? 1u
+                : std::min(m_chunkWorkerThreads,
+                           std::max(count * chunkSize / DIRECT_THREAD_SIZE,
+                                    static_cast<size_t>(1u)));
+        if (!parallelFor(count, threads, scatter)) {
+            m_logger.fullDebug() << "Failed to unfilter chunks.";
+            return false;
+        }
+    }
+
+    return true;
+    #else
+    (void) oId; (void) column; (void) rowCount; (void) size; (void) buffer;
+    return false;
+    #endif
+}
+
+bool TdbHdf5Connection::createVlenBytes(const hid_t fileId,
+                                        const hid_t dId,
+                                        const std::string & name)
+{
+    // Set dataset creation properties
+    const hid_t plistId = H5Pcreate(H5P_DATASET_CREATE);
+    if (plistId < 0) {
+        m_logger.error() << "Failed to create byte dataset creation property list.";
+        return false;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, plistId) {
+        if (H5Pclose(plistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset creation property list.";
+    };
+
+    const hsize_t dimsChunk = CHUNK_SIZE;
+    if (H5Pset_chunk(plistId, 1, &dimsChunk) < 0) {
+        m_logger.error() << "Failed to set byte dataset creation property list info.";
+        return false;
+    }
+
+    // Create an empty one dimensional data space
+    const hsize_t dims = 0u;
+    const hsize_t maxdims = H5S_UNLIMITED;
+    const hid_t sId = H5Screate_simple(1, &dims, &maxdims);
+    if (sId < 0) {
+        m_logger.error() << "Failed to create byte dataset data space.";
+        return false;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, sId) {
+        if (H5Sclose(sId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up data space.";
+    };
+
+    const hid_t bId = H5Dcreate(fileId, name.c_str(), H5T_NATIVE_UCHAR, sId, H5P_DEFAULT, plistId, H5P_DEFAULT);
+    if (bId < 0) {
+        m_logger.error() << "Failed to create byte dataset \"" << name << "\".";
+        return false;
+    }
+
+    if (H5Dclose(bId) < 0)
+        m_logger.fullDebug() << "Error while cleaning up byte dataset.";
+
+    return setVlenBytesName(dId, name);
+}
+
+bool TdbHdf5Connection::setVlenBytesName(const hid_t dId,
+                                         const std::string & name)
+{
+    assert(!name.empty());
+
+    const hid_t tId = H5Tcopy(H5T_C_S1);
+    if (tId < 0
+        || H5Tset_size(tId, name.size()) < 0
+        || H5Tset_strpad(tId, H5T_STR_NULLPAD) < 0)
+    {
+        m_logger.error() << "Failed to create byte dataset name attribute type.";
+
+        if (tId >= 0 && H5Tclose(tId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up byte dataset name attribute type.";
+        return false;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, tId) {
+        if (H5Tclose(tId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up byte dataset name attribute type.";
+    };
+
+    const hid_t sId = H5Screate(H5S_SCALAR);
+    if (sId < 0) {
+        m_logger.error() << "Failed to create byte dataset name attribute data space.";
+        return false;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, sId) {
+        if (H5Sclose(sId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up byte dataset name attribute data space.";
+    };
+
+    const hid_t aId = H5Acreate(dId, VLEN_BYTES_ATTR, tId, sId, H5P_DEFAULT, H5P_DEFAULT);
+    if (aId < 0) {
+        m_logger.error() << "Failed to create byte dataset name attribute.";
+        return false;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, aId) {
+        if (H5Aclose(aId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up byte dataset name attribute.";
+    };
+
+    if (H5Awrite(aId, tId, name.data()) < 0) {
+        m_logger.error() << "Failed to write byte dataset name attribute.";
+        return false;
+    }
+
+    return true;
+}
+
+bool TdbHdf5Connection::getVlenBytesName(const hid_t dId, std::string & name) {
+    const hid_t aId = H5Aopen(dId, VLEN_BYTES_ATTR, H5P_DEFAULT);
+    if (aId < 0) {
+        m_logger.error() << "Failed to open byte dataset name attribute.";
+        return false;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, aId) {
+        if (H5Aclose(aId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up byte dataset name attribute.";
+    };
+
+    const hid_t tId = H5Aget_type(aId);
+    if (tId < 0) {
+        m_logger.error() << "Failed to get byte dataset name attribute type.";
+        return false;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, tId) {
+        if (H5Tclose(tId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up byte dataset name attribute type.";
+    };
+
+    const size_t size = H5Tget_size(tId);
+    if (size == 0u || H5Tget_class(tId) != H5T_STRING || H5Tis_variable_str(tId) != 0) {
+        m_logger.error() << "Invalid byte dataset name attribute type.";
+        return false;
+    }
+
+    name.assign(size, '\0');
+    if (H5Aread(aId, tId, &name[0u]) < 0) {
+        m_logger.error() << "Failed to read byte dataset name attribute.";
+        return false;
+    }
+
+    // Drop the padding, if any
+    name.resize(std::strlen(name.c_str()));
+
+    return true;
+}
+
+SharemindTdbError TdbHdf5Connection::getVlenByteCount(const hid_t dId,
+        const hsize_t rowCount,
+        hsize_t & bytes)
+{
+    // The values of the rows end where the last one does
+    if (rowCount == 0u) {
+        bytes = 0u;
+        return SHAREMIND_TDB_OK;
+    }
+
+    const hid_t sId = H5Dget_space(dId);
+    if (sId < 0) {
+        m_logger.error() << "Failed to get offsets dataset data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, sId) {
+        if (H5Sclose(sId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up offsets dataset data space.";
+    };
+
+    const hsize_t coords[] = { rowCount - 1u, 0u };
+    if (H5Sselect_elements(sId, H5S_SELECT_SET, 1u, coords) < 0) {
+        m_logger.error() << "Failed to do selection in offsets dataset data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    const hsize_t mDims = 1u;
+    const hid_t mSId = H5Screate_simple(1, &mDims, nullptr);
+    if (mSId < 0) {
+        m_logger.error() << "Failed to create memory data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, mSId) {
+        if (H5Sclose(mSId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up memory data space.";
+    };
+
+    std::uint64_t end = 0u;
+    if (H5Dread(dId, H5T_NATIVE_UINT64, mSId, sId, H5P_DEFAULT, &end) < 0) {
+        m_logger.error() << "Failed to read offsets dataset.";
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
+    bytes = end;
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::readVlenColumn(const hid_t fileId,
+        const hid_t oId,
+        const hsize_t rowCount,
+        const SharemindTdbType & type,
+        std::vector<SharemindTdbValue *> & values)
+{
+    assert(rowCount > 0u);
+
+    // Read the end offsets of the values
+    auto const offsets(std::make_unique<std::uint64_t[]>(rowCount));
+    {
+        const hid_t sId = H5Dget_space(oId);
+        if (sId < 0) {
+            m_logger.error() << "Failed to get offsets dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, sId) {
+            if (H5Sclose(sId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up offsets dataset data space.";
+        };
+
+        const hsize_t start[] = { 0u, 0u };
+        const hsize_t count[] = { rowCount, 1u };
+        if (H5Sselect_hyperslab(sId, H5S_SELECT_SET, start, nullptr, count, nullptr) < 0) {
+            m_logger.error() << "Failed to do selection in offsets dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        const hid_t mSId = H5Screate_simple(2, count, nullptr);
+        if (mSId < 0) {
+            m_logger.error() << "Failed to create memory data space for column data.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, mSId) {
+            if (H5Sclose(mSId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up memory data space for column data.";
+        };
+
+        if (H5Dread(oId, H5T_NATIVE_UINT64, mSId, sId, H5P_DEFAULT, offsets.get()) < 0) {
+            m_logger.error() << "Failed to read offsets dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    // Read the bytes of all the values at once
+    const hsize_t size = offsets[rowCount - 1u];
+    auto const bytes(std::make_unique<char[]>(size));
+
+    if (size > 0u) {
+        std::string bytesName;
+        if (!getVlenBytesName(oId, bytesName))
+            return SHAREMIND_TDB_GENERAL_ERROR;
+
+        const hid_t bId = H5Dopen(fileId, bytesName.c_str(), H5P_DEFAULT);
+        if (bId < 0) {
+            m_logger.error() << "Failed to open byte dataset \"" << bytesName << "\".";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, bId) {
+            if (H5Dclose(bId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up byte dataset.";
+        };
+
+        // Pick up the extent last flushed by the writer
+        if (!refreshObject(bId)) {
+            m_logger.error() << "Failed to refresh dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        const hid_t sId = H5Dget_space(bId);
+        if (sId < 0) {
+            m_logger.error() << "Failed to get byte dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, sId) {
+            if (H5Sclose(sId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up byte dataset data space.";
+        };
+
+        hsize_t dims = 0u;
+        if (H5Sget_simple_extent_ndims(sId) != 1
+            || H5Sget_simple_extent_dims(sId, &dims, nullptr) < 0)
+        {
+            m_logger.error() << "Failed to get byte dataset data space size.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        if (dims < size) {
+            m_logger.error() << "Byte dataset is shorter than the column values.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        const hsize_t start = 0u;
+        if (H5Sselect_hyperslab(sId, H5S_SELECT_SET, &start, nullptr, &size, nullptr) < 0) {
+            m_logger.error() << "Failed to do selection in byte dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        const hid_t mSId = H5Screate_simple(1, &size, nullptr);
+        if (mSId < 0) {
+            m_logger.error() << "Failed to create memory data space for column data.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, mSId) {
+            if (H5Sclose(mSId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up memory data space for column data.";
+        };
+
+        if (H5Dread(bId, H5T_NATIVE_UCHAR, mSId, sId, H5P_DEFAULT, bytes.get()) < 0) {
+            m_logger.error() << "Failed to read byte dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    // Split the bytes into values
+    hsize_t begin = 0u;
+    for (hsize_t i = 0u; i < rowCount; ++i) {
+        const hsize_t end = offsets[i];
+        if (end < begin || end > size) {
+            m_logger.error() << "Invalid variable length value offsets.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        auto val(std::make_unique<SharemindTdbValue>());
+        val->type = SharemindTdbType_new(type.domain, type.name, type.size);
+        try {
+            const size_type bufferSize = end - begin;
+            val->buffer = ::operator new(bufferSize);
+            try {
+                std::memcpy(val->buffer, bytes.get() + begin, bufferSize);
+                val->size = bufferSize;
+
+                values.push_back(val.get());
+                val.release();
+            } catch (...) {
+                ::operator delete(val->buffer);
+                throw;
+            }
+        } catch (...) {
+            SharemindTdbType_delete(val->type);
+            throw;
+        }
+
+        begin = end;
+    }
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::writeVlenColumn(const hid_t fileId,
+        const hid_t oId,
+        const hsize_t rowCount,
+        const hsize_t insertedRowCount,
+        const hvl_t * const values,
+        const hsize_t stride,
+        DatasetExtentMap & cleanup)
+{
+    assert(insertedRowCount > 0u);
+    assert(values);
+
+    // New values go after the values of the existing rows
+    hsize_t begin = 0u;
+    {
+        const SharemindTdbError ecode = getVlenByteCount(oId, rowCount, begin);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+    }
+
+    std::string bytesName;
+    if (!getVlenBytesName(oId, bytesName))
+        return SHAREMIND_TDB_GENERAL_ERROR;
+
+    const hid_t bId = H5Dopen(fileId, bytesName.c_str(), H5P_DEFAULT);
+    if (bId < 0) {
+        m_logger.error() << "Failed to open byte dataset \"" << bytesName << "\".";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, bId) {
+        if (H5Dclose(bId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up byte dataset.";
+    };
+
+    // Lay out the end offsets of the new values
+    auto const offsets(std::make_unique<std::uint64_t[]>(insertedRowCount));
+    const char * const first = static_cast<const char *>(values[0u].p);
+    bool packed = true;
+    hsize_t end = begin;
+    for (hsize_t i = 0u; i < insertedRowCount; ++i) {
+        const hvl_t & value = values[i * stride];
+        if (static_cast<const char *>(value.p) != first + (end - begin))
+            packed = false;
+        end += value.len;
+        offsets[i] = end;
+    }
+
+    // Values packed back to back are written straight from their buffer
+    const hsize_t size = end - begin;
+    std::unique_ptr<char[]> gathered;
+    const void * bytes = first;
+    if (!packed) {
+        gathered = std::make_unique<char[]>(size);
+        bytes = gathered.get();
+
+        char * cursor = gathered.get();
+        for (hsize_t i = 0u; i < insertedRowCount; ++i) {
+            const hvl_t & value = values[i * stride];
+            if (value.len > 0u)
+                std::memcpy(cursor, value.p, value.len);
+            cursor += value.len;
+        }
+    }
+
+    // Append the offsets
+    {
+        const hsize_t dims[] = { rowCount + insertedRowCount, 1u };
+        if (H5Dset_extent(oId, dims) < 0) {
+            m_logger.error() << "Failed to extend offsets dataset.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        const hid_t sId = H5Dget_space(oId);
+        if (sId < 0) {
+            m_logger.error() << "Failed to get offsets dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, sId) {
+            if (H5Sclose(sId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up offsets dataset data space.";
+        };
+
+        const hsize_t start[] = { rowCount, 0u };
+        const hsize_t count[] = { insertedRowCount, 1u };
+        if (H5Sselect_hyperslab(sId, H5S_SELECT_SET, start, nullptr, count, nullptr) < 0) {
+            m_logger.error() << "Failed to do selection in offsets dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        const hid_t mSId = H5Screate_simple(2, count, nullptr);
+        if (mSId < 0) {
+            m_logger.error() << "Failed to create memory data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, mSId) {
+            if (H5Sclose(mSId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up memory data space.";
+        };
+
+        if (H5Dwrite(oId, H5T_NATIVE_UINT64, mSId, sId, H5P_DEFAULT, offsets.get()) < 0) {
+            m_logger.error() << "Failed to write offsets dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    // Append the bytes
+    {
+        hobj_ref_t bytesRef;
+        if (H5Rcreate(&bytesRef, fileId, bytesName.c_str(), H5R_OBJECT, -1) < 0) {
+            m_logger.error() << "Failed to create byte dataset reference.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        if (H5Dset_extent(bId, &end) < 0) {
+            m_logger.error() << "Failed to extend byte dataset.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        // Register the byte dataset for cleanup
+        cleanup.emplace(bytesRef, std::pair<hsize_t, hsize_t>(begin, 0u));
+
+        if (size == 0u)
+            return SHAREMIND_TDB_OK;
+
+        const hid_t sId = H5Dget_space(bId);
+        if (sId < 0) {
+            m_logger.error() << "Failed to get byte dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, sId) {
+            if (H5Sclose(sId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up byte dataset data space.";
+        };
+
+        if (H5Sselect_hyperslab(sId, H5S_SELECT_SET, &begin, nullptr, &size, nullptr) < 0) {
+            m_logger.error() << "Failed to do selection in byte dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        const hid_t mSId = H5Screate_simple(1, &size, nullptr);
+        if (mSId < 0) {
+            m_logger.error() << "Failed to create memory data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, mSId) {
+            if (H5Sclose(mSId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up memory data space.";
+        };
+
+        if (H5Dwrite(bId, H5T_NATIVE_UCHAR, mSId, sId, H5P_DEFAULT, bytes) < 0) {
+            m_logger.error() << "Failed to write byte dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::writeDirectChunks(const hid_t oId,
+        const hsize_t rowCount,
+        const hsize_t insertedRowCount,
+        const hsize_t typeCols,
+        const hsize_t typeOffset,
+        const hsize_t columns,
+        const size_t size,
+        const void * const buffer,
+        hsize_t & writtenRows)
+{
+    writtenRows = 0u;
+
+    #if H5_VERSION_GE(1,10,3)
+    if (m_asyncVol)
+        return SHAREMIND_TDB_OK;
+
+    const hid_t plistId = H5Dget_create_plist(oId);
+    if (plistId < 0) {
+        m_logger.error() << "Failed to get dataset creation property list.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, plistId) {
+        if (H5Pclose(plistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset creation property list.";
+    };
+
+    // Only appends starting at a chunk boundary and filling whole chunks,
+    // through filters which can be run without HDF5
+    hsize_t dimsChunk[2];
+    if (H5Pget_layout(plistId) != H5D_CHUNKED
+        || H5Pget_chunk(plistId, 2, dimsChunk) != 2
+        || rowCount % dimsChunk[0] != 0u
+        || insertedRowCount < dimsChunk[0]
+        || columns % dimsChunk[1] != 0u)
+        return SHAREMIND_TDB_OK;
+
+    TdbHdf5ChunkFilters filters;
+    if (!filters.load(plistId))
+        return SHAREMIND_TDB_OK;
+
+    const hsize_t chunkRows = dimsChunk[0];
+    const hsize_t chunkCols = dimsChunk[1];
+    const hsize_t colChunks = columns / chunkCols;
+    const size_t chunkCount = insertedRowCount / chunkRows * colChunks;
+    const size_t chunkSize = chunkRows * chunkCols * size;
+    const size_t batchChunks =
+            std::min(std::max(DIRECT_BATCH_SIZE / chunkSize, static_cast<size_t>(1u)),
+                     chunkCount);
+
+    const char * const values = static_cast<const char *>(buffer);
+    std::vector<std::vector<unsigned char> > chunks(batchChunks);
+
+    for (size_t first = 0u; first < chunkCount; first += batchChunks) {
+        const size_t count = std::min(batchChunks, chunkCount - first);
+
+        // Gather and filter the chunks of the batch
+        auto const fill = [&](size_t const i,
+                              std::vector<unsigned char> & scratch)
+        {
+            const hsize_t rowChunk = (first + i) / colChunks;
+            const hsize_t colChunk = (first + i) % colChunks;
+            const size_t rowSize = chunkCols * size;
+
+            std::vector<unsigned char> & chunk = chunks[i];
+            chunk.resize(chunkSize);
+            const char * src = values
+                    + ((rowChunk * chunkRows * typeCols)
+                       + typeOffset + colChunk * chunkCols) * size;
+            for (hsize_t row = 0u; row < chunkRows; ++row, src += typeCols * size)
+                std::memcpy(chunk.data() + row * rowSize, src, rowSize);
+
+            return filters.encode(chunk, scratch);
+        };
+
+        const size_t threads =
+                filters.empty()
+                ? 1u
+                : std::min(m_chunkWorkerThreads,
+                           std::max(count * chunkSize / DIRECT_THREAD_SIZE,
+                                    static_cast<size_t>(1u)));
+        if (!parallelFor(count, threads, fill)) {
+            m_logger.error() << "Failed to filter chunks.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        // Write them in order, HDF5 is not thread-safe
+        for (size_t i = 0u; i < count; ++i) {
+            const hsize_t offset[] = {
+                rowCount + (first + i) / colChunks * chunkRows,
+                (first + i) % colChunks * chunkCols
+            };
+            if (H5Dwrite_chunk(oId, H5P_DEFAULT, 0u, offset, chunks[i].size(), chunks[i].data()) < 0) {
+                m_logger.error() << "Failed to write chunk.";
+                return SHAREMIND_TDB_IO_ERROR;
+            }
+        }
+    }
+
+    writtenRows = insertedRowCount / chunkRows * chunkRows;
+    #else
+    (void) oId; (void) rowCount; (void) insertedRowCount; (void) typeCols;
+    (void) typeOffset; (void) columns; (void) size; (void) buffer;
+    #endif
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::createVirtualDataset(const hid_t fileId,
+        const hid_t partitionId,
+        const std::string & name,
+        const std::string & partitionPattern,
+        const hid_t tId,
+        const hid_t plistId,
+        const hsize_t columns,
+        const hsize_t partitionRows,
+        hid_t & dId)
+{
+    #if H5_VERSION_GE(1,10,0)
+    assert(partitionRows > 0u);
+
+    // Every partition holds a fixed size block of rows
+    const hsize_t srcDims[] = { partitionRows, columns };
+    const hid_t srcSId = H5Screate_simple(2, srcDims, nullptr);
+    if (srcSId < 0) {
+        m_logger.error() << "Failed to create partition data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, srcSId) {
+        if (H5Sclose(srcSId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up partition data space.";
+    };
+
+    // Column datasets live in a group of their own
+    const hid_t lplistId = H5Pcreate(H5P_LINK_CREATE);
+    if (lplistId < 0 || H5Pset_create_intermediate_group(lplistId, 1u) < 0) {
+        m_logger.error() << "Failed to create partition dataset link creation property list.";
+
+        if (lplistId >= 0 && H5Pclose(lplistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up link creation property list.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, lplistId) {
+        if (H5Pclose(lplistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up link creation property list.";
+    };
+
+    // Create the dataset in the first partition, the later partitions copy it
+    {
+        const hid_t pdId = H5Dcreate(partitionId, name.c_str(), tId, srcSId, lplistId, plistId, H5P_DEFAULT);
+        if (pdId < 0) {
+            m_logger.error() << "Failed to create partition dataset \"" << name << "\".";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        if (H5Dclose(pdId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up partition dataset.";
+    }
+
+    // Map the partitions to consecutive blocks of rows
+    const hsize_t dims[] = { 0u, columns };
+    const hsize_t maxdims[] = { H5S_UNLIMITED, columns };
+    const hid_t sId = H5Screate_simple(2, dims, maxdims);
+    if (sId < 0) {
+        m_logger.error() << "Failed to create virtual dataset data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, sId) {
+        if (H5Sclose(sId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up virtual dataset data space.";
+    };
+
+    const hsize_t start[] = { 0u, 0u };
+    const hsize_t stride[] = { partitionRows, 1u };
+    const hsize_t count[] = { H5S_UNLIMITED, 1u };
+    const hsize_t block[] = { partitionRows, columns };
+    if (H5Sselect_hyperslab(sId, H5S_SELECT_SET, start, stride, count, block) < 0) {
+        m_logger.error() << "Failed to do selection in virtual dataset data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    const hid_t vplistId = H5Pcreate(H5P_DATASET_CREATE);
+    if (vplistId < 0) {
+        m_logger.error() << "Failed to create virtual dataset creation property list.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, vplistId) {
+        if (H5Pclose(vplistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up virtual dataset creation property list.";
+    };
+
+    if (H5Pset_virtual(vplistId, sId, partitionPattern.c_str(), escapeSourceName(name).c_str(), srcSId) < 0) {
+        m_logger.error() << "Failed to set virtual dataset mapping.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    dId = H5Dcreate(fileId, name.c_str(), tId, sId, lplistId, vplistId, H5P_DEFAULT);
+    return SHAREMIND_TDB_OK;
+    #else
+    (void) fileId; (void) partitionId; (void) name; (void) partitionPattern;
+    (void) tId; (void) plistId; (void) columns; (void) partitionRows;
+    dId = H5I_INVALID_HID;
+    m_logger.error() << "Partitioned tables require HDF5 1.10 or later.";
+    return SHAREMIND_TDB_GENERAL_ERROR;
+    #endif
+}
+
+SharemindTdbError TdbHdf5Connection::writePartitionRows(
+        const fs::path & tblPath,
+        const hid_t oId,
+        const hid_t tId,
+        const hid_t mSId,
+        const hsize_t partitionRows,
+        const hsize_t rowCount,
+        const hsize_t insertedRowCount,
+        const hsize_t typeOffset,
+        const hsize_t columns,
+        const void * const buffer,
+        PartitionFileMap & partitionFiles,
+        std::vector<fs::path> & createdPartitions)
+{
+    assert(partitionRows > 0u);
+
+    // The partitions hold the dataset under the same name
+    const ssize_t nameSize = H5Iget_name(oId, nullptr, 0u);
+    if (nameSize <= 0) {
+        m_logger.error() << "Failed to get dataset name.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    std::string name(static_cast<size_t>(nameSize), '\0');
+    if (H5Iget_name(oId, &name[0u], name.size() + 1u) != nameSize) {
+        m_logger.error() << "Failed to get dataset name.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    // Appends only touch the partitions at the end of the table
+    const hsize_t endRow = rowCount + insertedRowCount;
+    for (hsize_t row = rowCount; row < endRow;) {
+        const hsize_t partition = row / partitionRows;
+        const hsize_t partitionRow = row % partitionRows;
+        const hsize_t count = std::min(partitionRows - partitionRow, endRow - row);
+
+        auto pIt(partitionFiles.find(partition));
+        if (pIt == partitionFiles.end()) {
+            bool created = false;
+            const hid_t id = openPartition(tblPath, partition, created);
+            if (id < 0) {
+                m_logger.error() << "Failed to open table partition " << partition << '.';
+                return SHAREMIND_TDB_IO_ERROR;
+            }
+
+            if (created)
+                createdPartitions.emplace_back(partitionPath(tblPath, partition));
+            pIt = partitionFiles.emplace(partition, id).first;
+        }
+
+        const hid_t pId = pIt->second;
+
+        const hid_t dId = H5Dopen(pId, name.c_str(), H5P_DEFAULT);
+        if (dId < 0) {
+            m_logger.error() << "Failed to open partition dataset \"" << name << "\".";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, dId) {
+            if (H5Dclose(dId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up partition dataset.";
+        };
+
+        const hid_t sId = H5Dget_space(dId);
+        if (sId < 0) {
+            m_logger.error() << "Failed to get partition dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, sId) {
+            if (H5Sclose(sId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up partition dataset data space.";
+        };
+
+        const hsize_t start[] = { partitionRow, 0u };
+        const hsize_t mStart[] = { row - rowCount, typeOffset };
+        const hsize_t size[] = { count, columns };
+        if (H5Sselect_hyperslab(sId, H5S_SELECT_SET, start, nullptr, size, nullptr) < 0
+            || H5Sselect_hyperslab(mSId, H5S_SELECT_SET, mStart, nullptr, size, nullptr) < 0)
+        {
+            m_logger.error() << "Failed to do selection in partition data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        if (H5Dwrite(dId, tId, mSId, sId, H5P_DEFAULT, buffer) < 0) {
+            m_logger.error() << "Failed to write values to table partition " << partition << '.';
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        row += count;
+    }
+
+    return SHAREMIND_TDB_OK;
+}
+
+hid_t TdbHdf5Connection::openPartition(const fs::path & tblPath,
+        const hsize_t partition,
+        bool & created)
+{
+    const fs::path path(partitionPath(tblPath, partition));
+    created = false;
+
+    bool exists = false;
+    if (!pathExists(path, exists))
+        return H5I_INVALID_HID;
+
+    if (exists)
+        return H5Fopen(path.c_str(), H5F_ACC_RDWR, m_fileAccessPlist);
+
+    // Lay out a new partition like the first one
+    const hid_t firstId = H5Fopen(partitionPath(tblPath, 0u).c_str(), H5F_ACC_RDWR, m_fileAccessPlist);
+    if (firstId < 0)
+        return H5I_INVALID_HID;
+
+    BOOST_SCOPE_EXIT_ALL(this, firstId) {
+        if (H5Fclose(firstId) < 0)
+            m_logger.fullDebug() << "Error while closing table partition file.";
+    };
+
+    const hid_t pId = H5Fcreate(path.c_str(), H5F_ACC_EXCL, H5P_DEFAULT, m_fileAccessPlist);
+    if (pId < 0)
+        return H5I_INVALID_HID;
+
+    if (!copyPartitionLayout(firstId, pId)) {
+        if (H5Fclose(pId) < 0)
+            m_logger.fullDebug() << "Error while closing table partition file.";
+
+        try {
+            fs::remove(path);
+        } catch (const fs::filesystem_error & e) {
+            m_logger.fullDebug() << "Error while removing table partition file: " << e.what();
+        }
+        return H5I_INVALID_HID;
+    }
+
+    created = true;
+    return pId;
+}
+
+void TdbHdf5Connection::removePartitions(
+        const std::vector<fs::path> & partitions)
+{
+    for (auto const & path : partitions) {
+        try {
+            fs::remove(path);
+        } catch (const fs::filesystem_error & e) {
+            m_logger.warning() << "Error while removing table partition file "
+                               << path.string() << ": " << e.what() << ".";
+        }
+    }
+}
+
+bool TdbHdf5Connection::copyPartitionLayout(const hid_t srcId, const hid_t dstId) {
+    H5G_info_t info;
+    if (H5Gget_info(srcId, &info) < 0)
+        return false;
+
+    for (hsize_t i = 0u; i < info.nlinks; ++i) {
+        const ssize_t nameSize = H5Lget_name_by_idx(srcId, ".", H5_INDEX_NAME, H5_ITER_INC, i, nullptr, 0u, H5P_DEFAULT);
+        if (nameSize <= 0)
+            return false;
+
+        std::string name(static_cast<size_t>(nameSize), '\0');
+        if (H5Lget_name_by_idx(srcId, ".", H5_INDEX_NAME, H5_ITER_INC, i, &name[0u], name.size() + 1u, H5P_DEFAULT) != nameSize)
+            return false;
+
+        const hid_t oId = H5Oopen(srcId, name.c_str(), H5P_DEFAULT);
+        if (oId < 0)
+            return false;
+
+        BOOST_SCOPE_EXIT_ALL(this, oId) {
+            if (H5Oclose(oId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up partition object.";
+        };
+
+        const H5I_type_t type = H5Iget_type(oId);
+        if (type == H5I_GROUP) {
+            const hid_t gId = H5Gcreate(dstId, name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+            if (gId < 0)
+                return false;
+
+            BOOST_SCOPE_EXIT_ALL(this, gId) {
+                if (H5Gclose(gId) < 0)
+                    m_logger.fullDebug() << "Error while cleaning up partition group.";
+            };
+
+            if (!copyPartitionLayout(oId, gId))
+                return false;
+        } else if (type == H5I_DATASET) {
+            // Create an empty dataset with the same shape and properties
+            const hid_t tId = H5Dget_type(oId);
+            const hid_t sId = H5Dget_space(oId);
+            const hid_t plistId = H5Dget_create_plist(oId);
+
+            BOOST_SCOPE_EXIT_ALL(tId, sId, plistId) {
+                if (tId >= 0)
+                    H5Tclose(tId);
+                if (sId >= 0)
+                    H5Sclose(sId);
+                if (plistId >= 0)
+                    H5Pclose(plistId);
+            };
+
+            if (tId < 0 || sId < 0 || plistId < 0)
+                return false;
+
+            const hid_t dId = H5Dcreate(dstId, name.c_str(), tId, sId, H5P_DEFAULT, plistId, H5P_DEFAULT);
+            if (dId < 0)
+                return false;
+
+            if (H5Dclose(dId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up partition dataset.";
+        }
+    }
+
+    return true;
+}
+
+SharemindTdbError TdbHdf5Connection::copyTable(const hid_t srcId,
+        const hid_t dstId,
+        const bool compact)
+{
+    // Copy the meta info and user attributes as they are
+    if (H5Ocopy(srcId, META_GROUP, dstId, META_GROUP, H5P_DEFAULT, H5P_DEFAULT) < 0) {
+        m_logger.error() << "Failed to copy meta info group.";
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
+    if (H5Ocopy(srcId, USR_ATTR_GROUP, dstId, USR_ATTR_GROUP, H5P_DEFAULT, H5P_DEFAULT) < 0) {
+        m_logger.error() << "Failed to copy user attributes group.";
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
+    // Get table row count
+    hsize_t rowCount = 0u;
+    {
+        const SharemindTdbError ecode = getRowCount(srcId, rowCount);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+    }
+
+    // Get table column count
+    hsize_t colCount = 0u;
+    {
+        const SharemindTdbError ecode = getColumnCount(srcId, colCount);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+    }
+
+    // Create a type for the dataset references
+    const hid_t tId = H5Tcreate(H5T_COMPOUND, sizeof(hobj_ref_t));
+    if (tId < 0) {
+        m_logger.error() << "Failed to create column meta info type.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, tId) {
+        if (H5Tclose(tId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up column meta info type.";
+    };
+
+    if (H5Tinsert(tId, "dataset_ref", 0u, H5T_STD_REF_OBJ) < 0) {
+        m_logger.error() << "Failed to create column meta info type.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    // Read dataset references from the column meta info dataset
+    auto const dsetRefs(std::make_unique<hobj_ref_t[]>(colCount));
+    {
+        const hid_t dId = H5Dopen(srcId, COL_INDEX_DATASET, H5P_DEFAULT);
+        if (dId < 0) {
+            m_logger.error() << "Failed to open column meta info dataset.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, dId) {
+            if (H5Dclose(dId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up column meta info dataset.";
+        };
+
+        if (H5Dread(dId, tId, H5S_ALL, H5S_ALL, H5P_DEFAULT, dsetRefs.get()) < 0) {
+            m_logger.error() << "Failed to read column meta info dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    // Dataset names are relative to the root group of the table
+    size_t prefixSize = 0u;
+    {
+        const ssize_t nameSize = H5Iget_name(srcId, nullptr, 0u);
+        if (nameSize <= 0) {
+            m_logger.error() << "Failed to get table root group name.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+        prefixSize = nameSize == 1 ? 1u : static_cast<size_t>(nameSize) + 1u;
+    }
+
+    // Datasets are copied as they are, using the committed types copied with
+    // the meta info
+    const hid_t ocpyplistId = H5Pcreate(H5P_OBJECT_COPY);
+    if (ocpyplistId < 0) {
+        m_logger.error() << "Failed to create object copy property list.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, ocpyplistId) {
+        if (H5Pclose(ocpyplistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up object copy property list.";
+    };
+
+    const hid_t lplistId = H5Pcreate(H5P_LINK_CREATE);
+    if (lplistId < 0) {
+        m_logger.error() << "Failed to create link creation property list.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, lplistId) {
+        if (H5Pclose(lplistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up link creation property list.";
+    };
+
+    if (H5Pset_copy_object(ocpyplistId, H5O_COPY_MERGE_COMMITTED_DTYPE_FLAG) < 0
+        || H5Pset_create_intermediate_group(lplistId, 1u) < 0)
+    {
+        m_logger.error() << "Failed to set object copy properties.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    // Rewrite the datasets under their old names
+    std::map<hobj_ref_t, hobj_ref_t> newRefs;
+    for (size_type i = 0u; i < colCount; ++i) {
+        auto const it(newRefs.find(dsetRefs[i]));
+        if (it != newRefs.end()) {
+            dsetRefs[i] = it->second;
+            continue;
+        }
+
+        const ssize_t nameSize = H5Rget_name(srcId, H5R_OBJECT, &dsetRefs[i], nullptr, 0u);
+        if (nameSize <= 0) {
+            m_logger.error() << "Failed to get dataset name from dataset reference.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        std::string name(static_cast<size_t>(nameSize), '\0');
+        if (H5Rget_name(srcId, H5R_OBJECT, &dsetRefs[i], &name[0u], name.size() + 1u) != nameSize
+            || name.size() <= prefixSize)
+        {
+            m_logger.error() << "Failed to get dataset name from dataset reference.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+        name.erase(0u, prefixSize);
+
+        if (compact) {
+            const SharemindTdbError ecode =
+                    compactDataset(srcId, dsetRefs[i], dstId, name.c_str(), rowCount);
+            if (ecode != SHAREMIND_TDB_OK)
+                return ecode;
+        } else if (H5Ocopy(srcId, name.c_str(), dstId, name.c_str(), ocpyplistId, lplistId) < 0) {
+            m_logger.error() << "Failed to copy dataset \"" << name << "\".";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        {
+            const SharemindTdbError ecode =
+                    copyVlenBytes(srcId, dstId, name.c_str(), compact, rowCount);
+            if (ecode != SHAREMIND_TDB_OK)
+                return ecode;
+        }
+
+        hobj_ref_t newRef;
+        if (H5Rcreate(&newRef, dstId, name.c_str(), H5R_OBJECT, -1) < 0) {
+            m_logger.error() << "Failed to create column meta info type reference.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        newRefs.emplace(dsetRefs[i], newRef);
+        dsetRefs[i] = newRef;
+    }
+
+    // Point the copied column index to the new datasets
+    {
+        const hid_t dId = H5Dopen(dstId, COL_INDEX_DATASET, H5P_DEFAULT);
+        if (dId < 0) {
+            m_logger.error() << "Failed to open column meta info dataset.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, dId) {
+            if (H5Dclose(dId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up column meta info dataset.";
+        };
+
+        if (H5Dwrite(dId, tId, H5S_ALL, H5S_ALL, H5P_DEFAULT, dsetRefs.get()) < 0) {
+            m_logger.error() << "Failed to write column meta info dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::compactDataset(const hid_t srcId,
+        const hobj_ref_t ref,
+        const hid_t dstId,
+        const char * const name,
+        const hsize_t rowCount)
+{
+    // Get dataset from reference
+    const hid_t oId = H5Rdereference(srcId, H5R_OBJECT, &ref);
+    if (oId < 0) {
+        m_logger.error() << "Failed to dereference object.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, oId) {
+        if (H5Oclose(oId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset.";
+    };
+
+    // Get dataset type
+    const hid_t tId = H5Dget_type(oId);
+    if (tId < 0) {
+        m_logger.error() << "Failed to get dataset type.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, tId) {
+        if (H5Tclose(tId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset type.";
+    };
+
+    // Get data space
+    const hid_t sId = H5Dget_space(oId);
+    if (sId < 0) {
+        m_logger.error() << "Failed to get dataset data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, sId) {
+        if (H5Sclose(sId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset data space.";
+    };
+
+    if (H5Sget_simple_extent_ndims(sId) != 2) {
+        m_logger.error() << "Invalid rank for dataset data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    hsize_t dims[2];
+    if (H5Sget_simple_extent_dims(sId, dims, nullptr) < 0) {
+        m_logger.error() << "Failed to get dataset data space size.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    if (dims[0] < rowCount) {
+        m_logger.error() << "Dataset has fewer rows than the table.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    const hsize_t columns = dims[1];
+
+    // Create a fixed size data space holding just the table rows
+    const hsize_t dDims[] = { rowCount, columns };
+    const hid_t dSId = H5Screate_simple(2, dDims, nullptr);
+    if (dSId < 0) {
+        m_logger.error() << "Failed to create compacted dataset data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, dSId) {
+        if (H5Sclose(dSId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up compacted dataset data space.";
+    };
+
+    // Set dataset creation properties. Bit packed and encoded datasets stay
+    // so in fixed size chunks.
+    const bool packed = rowCount > 0u
+            && (hasFilter(oId, TDB_HDF5_FILTER_BITPACK)
+                || hasFilter(oId, TDB_HDF5_FILTER_ENCODING));
+    const hid_t plistId = packed ? H5Dget_create_plist(oId) : H5Pcreate(H5P_DATASET_CREATE);
+    bool plistOk = plistId >= 0;
+    if (plistOk && packed) {
+        hsize_t dimsChunk[2];
+        plistOk = H5Pget_chunk(plistId, 2, dimsChunk) == 2;
+        if (plistOk) {
+            dimsChunk[0] = std::min(dimsChunk[0], rowCount);
+            plistOk = H5Pset_chunk(plistId, 2, dimsChunk) >= 0;
+        }
+    } else if (plistOk) {
+        plistOk = H5Pset_layout(plistId, H5D_CONTIGUOUS) >= 0;
+    }
+    if (!plistOk) {
+        m_logger.error() << "Failed to create compacted dataset creation property list.";
+
+        if (plistId >= 0 && H5Pclose(plistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset creation property list.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, plistId) {
+        if (H5Pclose(plistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset creation property list.";
+    };
+
+    // Column datasets live in a group of their own
+    const hid_t lplistId = H5Pcreate(H5P_LINK_CREATE);
+    if (lplistId < 0 || H5Pset_create_intermediate_group(lplistId, 1u) < 0) {
+        m_logger.error() << "Failed to create compacted dataset link creation property list.";
+
+        if (lplistId >= 0 && H5Pclose(lplistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up link creation property list.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, lplistId) {
+        if (H5Pclose(lplistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up link creation property list.";
+    };
+
+    // Create the dataset
+    const hid_t dId = H5Dcreate(dstId, name, tId, dSId, lplistId, plistId, H5P_DEFAULT);
+    if (dId < 0) {
+        m_logger.error() << "Failed to create compacted dataset \"" << name << "\".";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, dId) {
+        if (H5Dclose(dId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up compacted dataset.";
+    };
+
+    // Copy the type attribute
+    {
+        hid_t aId = H5I_INVALID_HID;
+        SharemindTdbType type;
+        {
+            const SharemindTdbError ecode = objRefToType(srcId, ref, aId, type);
+            if (ecode != SHAREMIND_TDB_OK)
+                return ecode;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, aId, &type) {
+            if (!cleanupType(aId, type))
+                m_logger.fullDebug() << "Error while cleaning up dataset type attribute object.";
+
+            if (H5Aclose(aId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up dataset type attribute.";
+        };
+
+        const hid_t aTId = H5Aget_type(aId);
+        if (aTId < 0) {
+            m_logger.error() << "Failed to get dataset type attribute type.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, aTId) {
+            if (H5Tclose(aTId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up dataset type attribute type.";
+        };
+
+        // Open the committed type attribute type of the new file
+        const hid_t dATId = H5Topen(dstId, DATASET_TYPE_ATTR_TYPE, H5P_DEFAULT);
+        if (dATId < 0) {
+            m_logger.error() << "Failed to open dataset type attribute type.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, dATId) {
+            if (H5Tclose(dATId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up dataset type attribute type.";
+        };
+
+        const hsize_t aDims = 1;
+        const hid_t aSId = H5Screate_simple(1, &aDims, nullptr);
+        if (aSId < 0) {
+            m_logger.error() << "Failed to create dataset type attribute data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, aSId) {
+            if (H5Sclose(aSId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up dataset type attribute data space.";
+        };
+
+        const hid_t dAId = H5Acreate(dId, DATASET_TYPE_ATTR, dATId, aSId, H5P_DEFAULT, H5P_DEFAULT);
+        if (dAId < 0) {
+            m_logger.error() << "Failed to create dataset type attribute.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, dAId) {
+            if (H5Aclose(dAId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up dataset type attribute.";
+        };
+
+        if (H5Awrite(dAId, aTId, &type) < 0) {
+            m_logger.error() << "Failed to write dataset type attribute.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    if (rowCount == 0u || columns == 0u)
+        return SHAREMIND_TDB_OK;
+
+    // Copy the rows in blocks
+    const size_t valueSize = H5Tget_size(tId);
+    if (valueSize == 0u) {
+        m_logger.error() << "Failed to get dataset type size.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    const bool isVlen = H5Tget_class(tId) == H5T_VLEN;
+    const hsize_t blockRows =
+            std::max(COMPACT_BLOCK_SIZE / (valueSize * columns),
+                     static_cast<hsize_t>(1u));
+    auto const buffer(std::make_unique<char[]>(
+                          std::min(blockRows, rowCount) * columns * valueSize));
+
+    for (hsize_t row = 0u; row < rowCount; row += blockRows) {
+        const hsize_t start[] = { row, 0u };
+        const hsize_t count[] = { std::min(blockRows, rowCount - row), columns };
+
+        const hid_t mSId = H5Screate_simple(2, count, nullptr);
+        if (mSId < 0) {
+            m_logger.error() << "Failed to create memory data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, mSId) {
+            if (H5Sclose(mSId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up memory data space.";
+        };
+
+        if (H5Sselect_hyperslab(sId, H5S_SELECT_SET, start, nullptr, count, nullptr) < 0
+            || H5Sselect_hyperslab(dSId, H5S_SELECT_SET, start, nullptr, count, nullptr) < 0)
+        {
+            m_logger.error() << "Failed to do selection in dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        if (H5Dread(oId, tId, mSId, sId, H5P_DEFAULT, buffer.get()) < 0) {
+            m_logger.error() << "Failed to read the dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        const herr_t written = H5Dwrite(dId, tId, mSId, dSId, H5P_DEFAULT, buffer.get());
+
+        // Release the memory allocated for the variable length types
+        if (isVlen && H5Dvlen_reclaim(tId, mSId, H5P_DEFAULT, buffer.get()) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset data.";
+
+        if (written < 0) {
+            m_logger.error() << "Failed to write compacted dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::copyVlenBytes(const hid_t srcId,
+        const hid_t dstId,
+        const char * const name,
+        const bool compact,
+        const hsize_t rowCount)
+{
+    const hid_t oId = H5Dopen(srcId, name, H5P_DEFAULT);
+    if (oId < 0) {
+        m_logger.error() << "Failed to open dataset \"" << name << "\".";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, oId) {
+        if (H5Dclose(oId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset.";
+    };
+
+    // Only the variable length columns stored as offsets have byte datasets
+    if (!isVlenOffsetsDataset(oId))
+        return SHAREMIND_TDB_OK;
+
+    std::string bytesName;
+    if (!getVlenBytesName(oId, bytesName))
+        return SHAREMIND_TDB_GENERAL_ERROR;
+
+    if (!compact) {
+        if (H5Ocopy(srcId, bytesName.c_str(), dstId, bytesName.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0) {
+            m_logger.error() << "Failed to copy byte dataset \"" << bytesName << "\".";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+        return SHAREMIND_TDB_OK;
+    }
+
+    // Keep just the bytes of the table rows
+    hsize_t size = 0u;
+    {
+        const SharemindTdbError ecode = getVlenByteCount(oId, rowCount, size);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+    }
+
+    const hid_t bId = H5Dopen(srcId, bytesName.c_str(), H5P_DEFAULT);
+    if (bId < 0) {
+        m_logger.error() << "Failed to open byte dataset \"" << bytesName << "\".";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, bId) {
+        if (H5Dclose(bId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up byte dataset.";
+    };
+
+    const hid_t sId = H5Dget_space(bId);
+    if (sId < 0) {
+        m_logger.error() << "Failed to get byte dataset data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, sId) {
+        if (H5Sclose(sId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up byte dataset data space.";
+    };
+
+    // Create a fixed size data space holding just the bytes of the rows
+    const hid_t dSId = H5Screate_simple(1, &size, nullptr);
+    if (dSId < 0) {
+        m_logger.error() << "Failed to create compacted byte dataset data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, dSId) {
+        if (H5Sclose(dSId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up compacted byte dataset data space.";
+    };
+
+    const hid_t plistId = H5Pcreate(H5P_DATASET_CREATE);
+    if (plistId < 0 || H5Pset_layout(plistId, H5D_CONTIGUOUS) < 0) {
+        m_logger.error() << "Failed to create compacted dataset creation property list.";
+
+        if (plistId >= 0 && H5Pclose(plistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset creation property list.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, plistId) {
+        if (H5Pclose(plistId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset creation property list.";
+    };
+
+    const hid_t dId = H5Dcreate(dstId, bytesName.c_str(), H5T_NATIVE_UCHAR, dSId, H5P_DEFAULT, plistId, H5P_DEFAULT);
+    if (dId < 0) {
+        m_logger.error() << "Failed to create compacted byte dataset \"" << bytesName << "\".";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, dId) {
+        if (H5Dclose(dId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up compacted byte dataset.";
+    };
+
+    // Point the compacted offsets to the compacted bytes
+    {
+        const hid_t dOId = H5Dopen(dstId, name, H5P_DEFAULT);
+        if (dOId < 0) {
+            m_logger.error() << "Failed to open compacted dataset \"" << name << "\".";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, dOId) {
+            if (H5Dclose(dOId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up compacted dataset.";
+        };
+
+        if (!setVlenBytesName(dOId, bytesName))
+            return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    // Copy the bytes in blocks
+    const hsize_t blockSize = COMPACT_BLOCK_SIZE;
+    auto const buffer(std::make_unique<char[]>(std::min(blockSize, size)));
+
+    for (hsize_t offset = 0u; offset < size; offset += blockSize) {
+        const hsize_t count = std::min(blockSize, size - offset);
+
+        const hid_t mSId = H5Screate_simple(1, &count, nullptr);
+        if (mSId < 0) {
+            m_logger.error() << "Failed to create memory data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, mSId) {
+            if (H5Sclose(mSId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up memory data space.";
+        };
+
+        if (H5Sselect_hyperslab(sId, H5S_SELECT_SET, &offset, nullptr, &count, nullptr) < 0
+            || H5Sselect_hyperslab(dSId, H5S_SELECT_SET, &offset, nullptr, &count, nullptr) < 0)
+        {
+            m_logger.error() << "Failed to do selection in byte dataset data space.";
+            return SHAREMIND_TDB_GENERAL_ERROR;
+        }
+
+        if (H5Dread(bId, H5T_NATIVE_UCHAR, mSId, sId, H5P_DEFAULT, buffer.get()) < 0) {
+            m_logger.error() << "Failed to read byte dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        if (H5Dwrite(dId, H5T_NATIVE_UCHAR, mSId, dSId, H5P_DEFAULT, buffer.get()) < 0) {
+            m_logger.error() << "Failed to write compacted byte dataset.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::objRefToType(const hid_t fileId, const hobj_ref_t ref, hid_t & aId, SharemindTdbType & type) {
+    // Get the dataset from the reference
+    const hid_t oId = H5Rdereference(fileId, H5R_OBJECT, &ref);
+    if (oId < 0) {
+        m_logger.error() << "Failed to dereference object.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, oId) {
+        if (H5Oclose(oId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset.";
+    };
+
+    // Check the reference object type
+    H5O_type_t rType = H5O_TYPE_UNKNOWN;
+    if (H5Rget_obj_type(oId, H5R_OBJECT, &ref, &rType) < 0) {
+        m_logger.error() << "Failed to get reference object type.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    if (rType != H5O_TYPE_DATASET) {
+        m_logger.error() << "Invalid dataset reference object.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    // Open the type attribute
+    aId = H5Aopen(oId, DATASET_TYPE_ATTR, H5P_DEFAULT);
+    if (aId < 0) {
+        m_logger.error() << "Failed to open dataset type attribute.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    bool closeAttr = true;
+
+    BOOST_SCOPE_EXIT_ALL(&closeAttr, this, aId) {
+        if (closeAttr && H5Aclose(aId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset type attribute.";
+    };
+
+    // Open the type attribute type
+    const hid_t aTId = H5Aget_type(aId);
+    if (aTId < 0) {
+        m_logger.error() << "Failed to get dataset type attribute type.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, aTId) {
+        if (H5Tclose(aTId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up dataset type attribute type.";
+    };
+
+    // Read the type attribute
+    if (H5Aread(aId, aTId, &type) < 0) {
+        m_logger.error() << "Failed to read dataset type attribute type.";
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
+    closeAttr = false;
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::getColumnCount(const hid_t fileId, hsize_t & ncols) {
+    // Get dataset
+    const hid_t dId = H5Dopen(fileId, COL_INDEX_DATASET, H5P_DEFAULT);
+    if (dId < 0) {
+        m_logger.error() << "Failed to open column meta info dataset.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, dId) {
+        if (H5Dclose(dId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up column meta info dataset.";
+    };
+
+    // Get data space
+    const hid_t sId = H5Dget_space(dId);
+    if (sId < 0) {
+        m_logger.error() << "Failed to open column meta info data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, sId) {
+        if (H5Sclose(sId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up column meta info data space.";
+    };
+
+    // Get data space rank
+    const int rank = H5Sget_simple_extent_ndims(sId);
+    if (rank < 0) {
+        m_logger.error() << "Failed to get column meta info data space rank.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    // Check data space rank
+    if (rank != 1) {
+        m_logger.error() << "Invalid rank for column meta info data space.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    // Get size of data space
+    if (H5Sget_simple_extent_dims(sId, &ncols, nullptr) < 0) {
+        m_logger.error() << "Failed to get column count from column meta info.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::getRowCount(const hid_t fileId, hsize_t & nrows) {
+    // Open meta info group
+    const hid_t gId = H5Gopen(fileId, META_GROUP, H5P_DEFAULT);
+    if (gId < 0) {
+        m_logger.error() << "Failed to get row count: Failed to open meta info group.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
 
     BOOST_SCOPE_EXIT_ALL(this, gId) {
         if (H5Gclose(gId) < 0)
             m_logger.fullDebug() << "Error while cleaning up meta info group.";
     };
 
+    // Pick up the row count last flushed by the writer
+    if (!refreshObject(gId)) {
+        m_logger.error() << "Failed to get row count: Failed to refresh meta info group.";
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
     // Open the row count attribute
     const hid_t aId = H5Aopen(gId, ROW_COUNT_ATTR, H5P_DEFAULT);
     if (aId < 0) {
@@ -2913,6 +6582,487 @@ SharemindTdbError TdbHdf5Connection::setRowCount(const hid_t fileId, const hsize
     return SHAREMIND_TDB_OK;
 }
 
+SharemindTdbError TdbHdf5Connection::getPartitionRows(const hid_t fileId, hsize_t & rows) {
+    // Open meta info group
+    const hid_t gId = H5Gopen(fileId, META_GROUP, H5P_DEFAULT);
+    if (gId < 0) {
+        m_logger.error() << "Failed to get partition size: Failed to open meta info group.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, gId) {
+        if (H5Gclose(gId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up meta info group.";
+    };
+
+    // Tables without the attribute are not partitioned
+    const htri_t exists = H5Aexists(gId, PARTITION_ROWS_ATTR);
+    if (exists < 0) {
+        m_logger.error() << "Failed to get partition size: Failed to check for partition rows attribute.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    if (!exists) {
+        rows = 0u;
+        return SHAREMIND_TDB_OK;
+    }
+
+    const hid_t aId = H5Aopen(gId, PARTITION_ROWS_ATTR, H5P_DEFAULT);
+    if (aId < 0) {
+        m_logger.error() << "Failed to get partition size: Failed to open partition rows attribute.";
+        return SHAREMIND_TDB_GENERAL_ERROR;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, aId) {
+        if (H5Aclose(aId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up partition rows attribute.";
+    };
+
+    if (H5Aread(aId, H5T_NATIVE_HSIZE, &rows) < 0) {
+        m_logger.error() << "Failed to get partition size: Failed to read partition rows attribute.";
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
+    return SHAREMIND_TDB_OK;
+}
+
+SharemindTdbError TdbHdf5Connection::getCommittedRowCount(
+        const std::string & tbl,
+        const hid_t fileId,
+        hsize_t & nrows)
+{
+    auto const it(m_committedRowCounts.find(tbl));
+    if (it != m_committedRowCounts.cend()) {
+        nrows = it->second;
+        return SHAREMIND_TDB_OK;
+    }
+
+    return getRowCount(fileId, nrows);
+}
+
+bool TdbHdf5Connection::restoreExtents(const hid_t fileId,
+                                       const DatasetExtentMap & extents)
+{
+    for (auto const & vp : extents) {
+        const hobj_ref_t dsetRef = vp.first;
+
+        // Get dataset from reference
+        const hid_t oId = H5Rdereference(fileId, H5R_OBJECT, &dsetRef);
+        if (oId < 0) {
+            m_logger.error() << "Error while restoring initial state: Failed to open dataset reference.";
+            return false;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, oId) {
+            if (H5Oclose(oId) < 0)
+                m_logger.fullDebug() << "Error while cleaning up dataset object.";
+        };
+
+        // Set the size of the dataset back to the original, the byte
+        // datasets only have the first dimension
+        const hsize_t dims[] = { vp.second.first, vp.second.second };
+        if (H5Dset_extent(oId, dims) < 0) {
+            m_logger.error() << "Error while restoring initial state: Failed to clean up changes to the table.";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TdbHdf5Connection::checkWritable(const char * const operation) const {
+    if (m_swmrMode != TdbHdf5ConnectionConf::SwmrMode::Read)
+        return true;
+
+    m_logger.error() << "Failed to " << operation
+                     << ": Connection is in SWMR read mode.";
+    return false;
+}
+
+bool TdbHdf5Connection::refreshObject(const hid_t oId) const {
+    #if H5_VERSION_GE(1,10,0)
+    if (m_swmrMode == TdbHdf5ConnectionConf::SwmrMode::Read)
+        return H5Orefresh(oId) >= 0;
+    #else
+    (void) oId;
+    #endif
+    return true;
+}
+
+bool TdbHdf5Connection::openContainer() {
+    if (m_swmrMode != TdbHdf5ConnectionConf::SwmrMode::Disabled) {
+        if (m_containerTableMaxRows > 0u)
+            m_logger.warning() << "The table container file is not used in SWMR mode.";
+        return true;
+    }
+
+    const fs::path path(m_path / CONTAINER_FILE);
+
+    bool exists = false;
+    if (!pathExists(path, exists))
+        return false;
+
+    // Tables already in the container stay accessible, if it gets disabled
+    if (exists) {
+        m_containerId = H5Fopen(path.c_str(), H5F_ACC_RDWR, m_fileAccessPlist);
+    } else if (m_containerTableMaxRows > 0u) {
+        m_containerId = H5Fcreate(path.c_str(), H5F_ACC_EXCL, H5P_DEFAULT, m_fileAccessPlist);
+    } else {
+        return true;
+    }
+
+    if (m_containerId < 0) {
+        m_logger.error() << "Failed to open table container file "
+                         << path.string() << '.';
+        return false;
+    }
+
+    for (const char * const group : { CONTAINER_TABLE_GROUP, CONTAINER_DELETED_GROUP }) {
+        const htri_t groupExists = H5Lexists(m_containerId, group, H5P_DEFAULT);
+        if (groupExists > 0)
+            continue;
+
+        const hid_t gId = groupExists < 0
+                ? H5I_INVALID_HID
+                : H5Gcreate(m_containerId, group, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        if (gId < 0 || H5Gclose(gId) < 0) {
+            m_logger.error() << "Failed to create group \"" << group
+                             << "\" in table container file.";
+            H5Fclose(m_containerId);
+            m_containerId = H5I_INVALID_HID;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void TdbHdf5Connection::containerTables(std::map<std::string, fs::path> & tables) {
+    if (m_containerId < 0)
+        return;
+
+    const hid_t gId = H5Gopen(m_containerId, CONTAINER_TABLE_GROUP, H5P_DEFAULT);
+    if (gId < 0) {
+        m_logger.error() << "Failed to open group \"" << CONTAINER_TABLE_GROUP
+                         << "\" in table container file.";
+        return;
+    }
+
+    BOOST_SCOPE_EXIT_ALL(this, gId) {
+        if (H5Gclose(gId) < 0)
+            m_logger.fullDebug() << "Error while cleaning up container table group.";
+    };
+
+    H5G_info_t info;
+    if (H5Gget_info(gId, &info) < 0) {
+        m_logger.error() << "Failed to list the tables in the container file.";
+        return;
+    }
+
+    const fs::path path(m_path / CONTAINER_FILE);
+    for (hsize_t i = 0u; i < info.nlinks; ++i) {
+        const ssize_t nameSize = H5Lget_name_by_idx(gId, ".", H5_INDEX_NAME, H5_ITER_INC, i, nullptr, 0u, H5P_DEFAULT);
+        if (nameSize <= 0)
+            continue;
+
+        std::string name(static_cast<size_t>(nameSize), '\0');
+        if (H5Lget_name_by_idx(gId, ".", H5_INDEX_NAME, H5_ITER_INC, i, &name[0u], name.size() + 1u, H5P_DEFAULT) == nameSize)
+            tables.emplace(std::move(name), path);
+    }
+}
+
+bool TdbHdf5Connection::inContainer(const std::string & tbl, bool & status) {
+    status = false;
+    if (m_containerId < 0)
+        return true;
+
+    const htri_t exists = H5Lexists(m_containerId, containerTableName(tbl).c_str(), H5P_DEFAULT);
+    if (exists < 0) {
+        m_logger.error() << "Failed to look up table \"" << tbl
+                         << "\" in the container file.";
+        return false;
+    }
+
+    status = exists > 0;
+    return true;
+}
+
+SharemindTdbError TdbHdf5Connection::promoteTable(const void * const owner,
+        const std::string & tbl)
+{
+    if (m_containerId < 0)
+        return SHAREMIND_TDB_OK;
+
+    // The dataset references of uncommitted insertions refer to the container
+    if (m_committedRowCounts.find(tbl) != m_committedRowCounts.end()
+        || (m_undo && m_undo->insertedRows.find(tbl) != m_undo->insertedRows.end()))
+        return SHAREMIND_TDB_OK;
+
+    fs::path tblPath;
+    fs::path promotePath;
+
+    // Remove the copy, unless it replaced the table in the container
+    bool swapped = false;
+
+    BOOST_SCOPE_EXIT_ALL(&swapped, this, &promotePath) {
+        if (!swapped && !promotePath.empty()) {
+            try {
+                fs::remove(promotePath);
+            } catch (const fs::filesystem_error & e) {
+                m_logger.fullDebug() << "Error while removing promoted table file: " << e.what();
+            }
+        }
+    };
+
+    {
+        const hid_t srcId = openTableFile(owner, tbl);
+        if (srcId < 0) {
+            m_logger.error() << "Failed to open table file.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        BOOST_SCOPE_EXIT_ALL(this, owner, &tbl) {
+            releaseTableFile(owner, tbl);
+        };
+
+        if (H5Iget_type(srcId) != H5I_GROUP)
+            return SHAREMIND_TDB_OK;
+
+        hsize_t rowCount = 0u;
+        {
+            const SharemindTdbError ecode = getRowCount(srcId, rowCount);
+            if (ecode != SHAREMIND_TDB_OK)
+                return ecode;
+        }
+
+        if (rowCount <= m_containerTableMaxRows)
+            return SHAREMIND_TDB_OK;
+
+        // Write the copy next to where the table file goes
+        tblPath = m_storage.placeTable(tbl);
+        promotePath = tblPath;
+        promotePath += PROMOTE_FILE_EXT;
+
+        const hid_t dstId = H5Fcreate(promotePath.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, m_fileAccessPlist);
+        if (dstId < 0) {
+            m_logger.error() << "Failed to create table file with path "
+                             << promotePath.string() << '.';
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+
+        bool closed = false;
+
+        BOOST_SCOPE_EXIT_ALL(&closed, this, dstId) {
+            if (!closed && H5Fclose(dstId) < 0)
+                m_logger.fullDebug() << "Error while closing promoted table file.";
+        };
+
+        const SharemindTdbError ecode = copyTable(srcId, dstId, false);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+
+        closed = true;
+        if (H5Fclose(dstId) < 0) {
+            m_logger.error() << "Failed to close promoted table file.";
+            return SHAREMIND_TDB_IO_ERROR;
+        }
+    }
+
+    // The table in the container takes precedence until it is removed
+    try {
+        fs::rename(promotePath, tblPath);
+    } catch (const fs::filesystem_error & e) {
+        m_logger.error() << "Failed to move promoted table file: " << e.what();
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
+    swapped = true;
+
+    closeTableFile(tbl);
+
+    if (H5Ldelete(m_containerId, containerTableName(tbl).c_str(), H5P_DEFAULT) < 0) {
+        m_logger.error() << "Failed to remove table \"" << tbl
+                         << "\" from the container file.";
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
+    if (H5Fflush(m_containerId, H5F_SCOPE_LOCAL) < 0)
+        m_logger.fullDebug() << "Error while flushing buffers.";
+
+    m_logger.fullDebug() << "Moved table \"" << tbl << "\" from the container "
+                            "file to " << tblPath.string() << '.';
+
+    return SHAREMIND_TDB_OK;
+}
+
+fs::path TdbHdf5Connection::temporaryPath() {
+    fs::path path(m_path / TEMPORARY_DIR);
+    path /= std::to_string(m_temporaryCount++) + FILE_EXT;
+    return path;
+}
+
+hid_t TdbHdf5Connection::createTemporaryFile() {
+    const hid_t faplId = m_fileAccessPlist == H5P_DEFAULT
+                         ? H5Pcreate(H5P_FILE_ACCESS)
+                         : H5Pcopy(m_fileAccessPlist);
+    if (faplId < 0)
+        return H5I_INVALID_HID;
+
+    BOOST_SCOPE_EXIT_ALL(this, faplId) {
+        if (H5Pclose(faplId) < 0)
+            m_logger.fullDebug() << "Error while closing file access property list.";
+    };
+
+    // Keep the file in memory only, it is copied to a file when spilled. The
+    // name is unique, as the open files of the core driver are told apart by
+    // their names
+    if (H5Pset_fapl_core(faplId, CORE_INCREMENT, false) < 0)
+        return H5I_INVALID_HID;
+
+    return H5Fcreate(temporaryPath().c_str(), H5F_ACC_EXCL, H5P_DEFAULT, faplId);
+}
+
+TdbHdf5Connection::TemporaryTable * TdbHdf5Connection::findTemporaryTable(
+        const void * const owner,
+        const std::string & tbl)
+{
+    auto const it(m_temporaryTables.find(owner));
+    if (it == m_temporaryTables.end())
+        return nullptr;
+
+    auto const tIt(it->second.find(tbl));
+    return tIt != it->second.end() ? &tIt->second : nullptr;
+}
+
+SharemindTdbError TdbHdf5Connection::spillTable(const void * const owner,
+        const std::string & tbl)
+{
+    TemporaryTable * const temporary = findTemporaryTable(owner, tbl);
+    if (!temporary
+        || temporary->spillRows == 0u
+        || !temporary->spillPath.empty()
+        || temporary->rowCount <= temporary->spillRows)
+        return SHAREMIND_TDB_OK;
+
+    // The undo records of the operation refer to the in-memory file
+    if (m_committedRowCounts.find(tbl) != m_committedRowCounts.end()
+        || (m_undo
+            && (m_undo->insertedRows.find(tbl) != m_undo->insertedRows.end()
+                || m_undo->createdTables.find(tbl) != m_undo->createdTables.end())))
+        return SHAREMIND_TDB_OK;
+
+    // The file stays out of the storage paths, where it would be listed
+    const fs::path spillPath(temporaryPath());
+
+    const hid_t dstId = H5Fcreate(spillPath.c_str(), H5F_ACC_EXCL, H5P_DEFAULT, m_fileAccessPlist);
+    if (dstId < 0) {
+        m_logger.error() << "Failed to create temporary table file with path "
+                         << spillPath.string() << '.';
+        return SHAREMIND_TDB_IO_ERROR;
+    }
+
+    bool success = false;
+
+    BOOST_SCOPE_EXIT_ALL(&success, this, &spillPath, dstId) {
+        if (!success) {
+            if (H5Fclose(dstId) < 0)
+                m_logger.fullDebug() << "Error while closing spilled table file.";
+
+            try {
+                fs::remove(spillPath);
+            } catch (const fs::filesystem_error & e) {
+                m_logger.fullDebug() << "Error while removing spilled table file: " << e.what();
+            }
+        }
+    };
+
+    {
+        const SharemindTdbError ecode = copyTable(temporary->id, dstId, false);
+        if (ecode != SHAREMIND_TDB_OK)
+            return ecode;
+    }
+
+    if (H5Fflush(dstId, H5F_SCOPE_LOCAL) < 0)
+        m_logger.fullDebug() << "Error while flushing buffers.";
+
+    // Keep writing to the copy in place of the in-memory file
+    if (H5Fclose(temporary->id) < 0)
+        m_logger.fullDebug() << "Error while closing temporary table \""
+                             << tbl << "\".";
+
+    temporary->id = dstId;
+    temporary->spillPath = spillPath;
+
+    success = true;
+
+    m_logger.fullDebug() << "Moved temporary table \"" << tbl << "\" to "
+                         << spillPath.string() << '.';
+
+    return SHAREMIND_TDB_OK;
+}
+
+bool TdbHdf5Connection::closeTemporaryTable(const std::string & tbl,
+        const TemporaryTable & table)
+{
+    const bool closed = H5Fclose(table.id) >= 0;
+
+    if (!table.spillPath.empty()) {
+        try {
+            fs::remove(table.spillPath);
+        } catch (const fs::filesystem_error & e) {
+            m_logger.warning() << "Error while removing the file of temporary "
+                                  "table \"" << tbl << "\": " << e.what();
+        }
+    }
+
+    return closed;
+}
+
+bool TdbHdf5Connection::dropTemporaryTable(const void * const owner,
+        const std::string & tbl)
+{
+    auto const it(m_temporaryTables.find(owner));
+    if (it == m_temporaryTables.end())
+        return false;
+
+    auto const tIt(it->second.find(tbl));
+    if (tIt == it->second.end())
+        return false;
+
+    const TemporaryTable table(tIt->second);
+    it->second.erase(tIt);
+    if (it->second.empty())
+        m_temporaryTables.erase(it);
+
+    return closeTemporaryTable(tbl, table);
+}
+
+void TdbHdf5Connection::dropTemporaryTables(const void * const owner) {
+    auto const it(m_temporaryTables.find(owner));
+    if (it == m_temporaryTables.end())
+        return;
+
+    H5Eset_auto(H5E_DEFAULT, err_handler, &const_cast<LogHard::Logger &>(m_logger));
+
+    for (auto const & vp : it->second) {
+        if (!closeTemporaryTable(vp.first, vp.second))
+            m_logger.warning() << "Error while closing temporary table \""
+                               << vp.first << "\".";
+    }
+
+    m_logger.fullDebug() << "Dropped " << it->second.size()
+                         << " temporary tables.";
+
+    m_temporaryTables.erase(it);
+}
+
+bool TdbHdf5Connection::closeTableHandle(const hid_t id) {
+    // Tables in the container file are open as groups
+    if (H5Iget_type(id) == H5I_GROUP)
+        return H5Gclose(id) >= 0;
+    return H5Fclose(id) >= 0;
+}
+
 bool TdbHdf5Connection::closeTableFile(const std::string & tbl) {
     assert(!tbl.empty());
 
@@ -2920,24 +7070,65 @@ bool TdbHdf5Connection::closeTableFile(const std::string & tbl) {
     if (it == m_tableFiles.end())
         return false;
 
-    if (H5Fclose(it->second) < 0)
+    assert(it->second.pins == 0u);
+
+    if (!closeTableHandle(it->second.id))
         m_logger.fullDebug() << "Error while closing table \"" << tbl << "\" file.";
 
+    m_tableFileLru.erase(it->second.lruPosition);
     m_tableFiles.erase(it);
     return true;
 }
 
-hid_t TdbHdf5Connection::openTableFile(const std::string & tbl) {
+hid_t TdbHdf5Connection::openTableFile(const void * const owner,
+        const std::string & tbl)
+{
     assert(!tbl.empty());
 
+    // The temporary tables are always open
+    if (const TemporaryTable * const temporary = findTemporaryTable(owner, tbl))
+        return temporary->id;
+
     // Check if we already have a file handle for the table
-    auto const it(const_cast<TableFileMap const &>(m_tableFiles).find(tbl));
-    if (it != m_tableFiles.end())
-        return it->second;
+    auto const it(m_tableFiles.find(tbl));
+    if (it != m_tableFiles.end()) {
+        ++m_tableFileHits;
+        ++it->second.pins;
+        m_tableFileLru.splice(m_tableFileLru.begin(),
+                              m_tableFileLru,
+                              it->second.lruPosition);
+        return it->second.id;
+    }
+
+    ++m_tableFileMisses;
+
+    // Tables in the container file take precedence over a table file left
+    // behind by an interrupted promotion
+    bool contained = false;
+    if (!inContainer(tbl, contained))
+        return H5I_INVALID_HID;
+
+    if (contained) {
+        const hid_t id = H5Gopen(m_containerId, containerTableName(tbl).c_str(), H5P_DEFAULT);
+        if (id < 0)
+            return H5I_INVALID_HID;
+
+        m_tableFileLru.emplace_front(tbl);
+        m_tableFiles.emplace(tbl, TableFile{id, 1u, m_tableFileLru.begin()});
+        return id;
+    }
 
     // Open a new handle for the table
     const fs::path tblPath = nameToPath(tbl);
-    hid_t id = H5Fopen(tblPath.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+    unsigned flags = H5F_ACC_RDWR;
+    #if H5_VERSION_GE(1,10,0)
+    if (m_swmrMode == TdbHdf5ConnectionConf::SwmrMode::Write) {
+        flags = H5F_ACC_RDWR | H5F_ACC_SWMR_WRITE;
+    } else if (m_swmrMode == TdbHdf5ConnectionConf::SwmrMode::Read) {
+        flags = H5F_ACC_RDONLY | H5F_ACC_SWMR_READ;
+    }
+    #endif
+    hid_t id = H5Fopen(tblPath.c_str(), flags, m_fileAccessPlist);
     if (id < 0)
         return H5I_INVALID_HID;
 
@@ -2946,9 +7137,68 @@ hid_t TdbHdf5Connection::openTableFile(const std::string & tbl) {
     // TODO Do some sanity checks when opening the table (if all the datasets
     // have the same number of rows).
 
-    m_tableFiles.emplace(tbl, id);
+    m_tableFileLru.emplace_front(tbl);
+    m_tableFiles.emplace(tbl, TableFile{id, 1u, m_tableFileLru.begin()});
 
     return id;
 }
 
+void TdbHdf5Connection::releaseTableFile(const void * const owner,
+        const std::string & tbl)
+{
+    if (findTemporaryTable(owner, tbl))
+        return;
+
+    auto const it(m_tableFiles.find(tbl));
+    assert(it != m_tableFiles.end());
+    assert(it->second.pins > 0u);
+    --it->second.pins;
+
+    evictTableFiles();
+}
+
+void TdbHdf5Connection::evictTableFiles() {
+    // Close the least recently used table files not in use by an operation
+    auto lruIt(m_tableFileLru.end());
+    bool evicted = false;
+    while (m_tableFiles.size() > m_maxOpenTableFiles
+           && lruIt != m_tableFileLru.begin())
+    {
+        --lruIt;
+        auto const it(m_tableFiles.find(*lruIt));
+        assert(it != m_tableFiles.end());
+        if (it->second.pins > 0u)
+            continue;
+
+        if (!closeTableHandle(it->second.id))
+            m_logger.fullDebug() << "Error while closing table \"" << *lruIt
+                                 << "\" file.";
+
+        m_logger.fullDebug() << "Evicted table \"" << *lruIt << "\" file.";
+
+        ++m_tableFileEvictions;
+        m_tableFiles.erase(it);
+        lruIt = m_tableFileLru.erase(lruIt);
+        evicted = true;
+    }
+
+    if (evicted)
+        logTableFileCacheStats("Table file cache");
+}
+
+TdbHdf5Connection::TableFileCacheStats
+TdbHdf5Connection::tableFileCacheStats() const noexcept {
+    return TableFileCacheStats{m_tableFileHits,
+                               m_tableFileMisses,
+                               m_tableFileEvictions,
+                               m_tableFiles.size()};
+}
+
+void TdbHdf5Connection::logTableFileCacheStats(const char * const event) const {
+    m_logger.fullDebug() << event << ": " << m_tableFileHits << " hits, "
+                         << m_tableFileMisses << " misses, "
+                         << m_tableFileEvictions << " evictions, "
+                         << m_tableFiles.size() << " open.";
+}
+
 } /* namespace sharemind { */
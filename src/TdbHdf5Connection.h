@@ -25,8 +25,12 @@
 #include <exception>
 #include <H5Ipublic.h>
 #include <H5Rpublic.h>
+#include <limits>
+#include <list>
 #include <LogHard/Logger.h>
 #include <map>
+#include <memory>
+#include <set>
 #include <sharemind/Exception.h>
 #include <sharemind/ExceptionMacros.h>
 #include <sharemind/mod_tabledb/tdberror.h>
@@ -34,6 +38,10 @@
 #include <string>
 #include <utility>
 #include <vector>
+#include "TdbHdf5Catalog.h"
+#include "TdbHdf5ConnectionConf.h"
+#include "TdbHdf5DatasetBatch.h"
+#include "TdbHdf5Storage.h"
 
 
 namespace sharemind {
@@ -47,63 +55,258 @@ public: /* Types: */
     SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(
                 InitializationException,
                 FailedToSetHdf5LoggingHandlerException);
+    SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(
+                InitializationException,
+                FailedToCreateFileAccessPropertyListException);
+    SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(
+                InitializationException,
+                SwmrNotSupportedException);
+    SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(
+                InitializationException,
+                FailedToOpenContainerFileException);
+    SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(
+                InitializationException,
+                FailedToRegisterHdf5FiltersException);
 
     using size_type = std::uint64_t;
 
+    /* How the columns of a new table are stored: */
+    enum class TableLayout {
+        /* One two-dimensional dataset holding all columns of a type: */
+        TypeDatasets,
+        /* Every column in a dataset of its own: */
+        ColumnDatasets
+    };
+
+    /* Shape of the chunks of the datasets of a new table: */
+    enum class ChunkLayout {
+        /* Blocks of rows of a single column, best for column scans: */
+        Columns,
+        /* Blocks of rows spanning all columns of a dataset, best for
+           inserting and reading whole rows: */
+        Rows
+    };
+
+    /* How the values of the variable length columns of a new table are
+       stored: */
+    enum class VlenLayout {
+        /* A dataset of HDF5 variable length values in the global heap: */
+        Heap,
+        /* Per column, a dataset of the end offsets of the values and a
+           dataset of the concatenated value bytes: */
+        Offsets
+    };
+
+    /* Encoding of the chunks of a column of a public type of 1, 2, 4 or 8
+       bytes. Encoded columns are stored in datasets of their own: */
+    enum class ColumnEncoding {
+        None,
+        /* Chosen per chunk from the statistics of the values: */
+        Auto,
+        /* For columns of few distinct values: */
+        Dictionary,
+        /* For sorted or slowly changing columns: */
+        Delta,
+        /* For columns of values in a small range: */
+        FrameOfReference
+    };
+
+    struct TableOptions {
+        TableLayout layout = TableLayout::TypeDatasets;
+        ChunkLayout chunkLayout = ChunkLayout::Columns;
+        /* Partitioned tables always keep their values in the heap: */
+        VlenLayout vlenLayout = VlenLayout::Offsets;
+        /* Whether to pack the values of the 1-bit types into bits, not done
+           for partitioned tables: */
+        bool packBits = false;
+        /* Rows per partition file, or 0 to keep all rows in the table file: */
+        size_type partitionRows = 0u;
+        /* Encodings of the columns, or empty to encode none. Ignored for the
+           columns of the other types: */
+        std::vector<ColumnEncoding> encodings;
+        /* Whether to keep the table in memory, seen only by the process
+           creating it and dropped when the process closes the connection.
+           Can not be combined with partitioning: */
+        bool temporary = false;
+        /* Rows after which a temporary table is moved to a file of its own,
+           or 0 to keep it in memory: */
+        size_type spillRows = 0u;
+    };
+
+    /* File of a temporary table, open until the table is deleted: */
+    struct TemporaryTable {
+        hid_t id;
+        size_type spillRows;
+        size_type rowCount;
+        /* Empty while the table is in memory: */
+        boost::filesystem::path spillPath;
+    };
+
+    /* Rows and columns of the datasets, only the rows of the one-dimensional
+       byte datasets of the variable length columns: */
+    typedef std::map<hobj_ref_t, std::pair<hsize_t, hsize_t> > DatasetExtentMap;
+
+    /*
+     * Pre-images of the changes made by a single database operation. These
+     * are enough to undo the operation without rereading any table data.
+     */
+    struct UndoRecord {
+        struct InsertedRows {
+            hsize_t rowCount;
+            DatasetExtentMap extents;
+            /* Partition files created for the rows: */
+            std::vector<boost::filesystem::path> createdPartitions;
+        };
+
+        struct DeletedTable {
+            boost::filesystem::path path;
+            bool inCatalog;
+            TdbHdf5Catalog::Entry catalogEntry;
+            /* Empty, unless the table was partitioned: */
+            boost::filesystem::path partitionsPath;
+            /* Whether the table was moved aside in the container file: */
+            bool inContainer;
+        };
+
+        std::map<std::string, InsertedRows> insertedRows;
+        std::set<std::string> createdTables;
+        std::map<std::string, DeletedTable> deletedTables;
+        /* The table files replaced by their compacted copies, moved aside: */
+        std::map<std::string, boost::filesystem::path> compactedTables;
+        std::map<std::string, TemporaryTable> deletedTemporaryTables;
+        /* Owner of the temporary tables seen by the operation: */
+        const void * owner = nullptr;
+    };
+
+    /* Counters of the table file cache since the connection was opened: */
+    struct TableFileCacheStats {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t evictions;
+        std::size_t openFiles;
+    };
+
 private: /* Types: */
 
-    typedef std::map<std::string, hid_t> TableFileMap;
+    /* Open table file handle, closed when least recently used and unpinned: */
+    struct TableFile {
+        hid_t id;
+        std::size_t pins;
+        std::list<std::string>::iterator lruPosition;
+    };
+
+    typedef std::map<std::string, TableFile> TableFileMap;
+
+    typedef std::map<std::string, TemporaryTable> TemporaryTableMap;
+
+    /* Partition files open for an insertion, by partition number: */
+    typedef std::map<hsize_t, hid_t> PartitionFileMap;
 
 public: /* Methods: */
 
     TdbHdf5Connection(const LogHard::Logger & logger,
-                      const boost::filesystem::path & path);
+                      const boost::filesystem::path & path,
+                      const TdbHdf5ConnectionConf & config);
     ~TdbHdf5Connection();
 
     /*
      * General database functions
      */
-    SharemindTdbError tblNames(std::vector<SharemindTdbString *> & names);
+    SharemindTdbError tblNames(const void * const owner,
+                               std::vector<SharemindTdbString *> & names);
+    SharemindTdbError tblNames(const void * const owner,
+                               const std::string & prefix,
+                               const size_type offset,
+                               const size_type limit,
+                               std::vector<SharemindTdbString *> & names);
 
     /*
      * General database table functions
      */
 
-    SharemindTdbError tblCreate(const std::string & tbl,
+    SharemindTdbError tblCreate(const void * const owner,
+            const std::string & tbl,
             const std::vector<SharemindTdbString *> & names,
-            const std::vector<SharemindTdbType *> & types);
-    SharemindTdbError tblDelete(const std::string & tbl);
-    SharemindTdbError tblExists(const std::string & tbl, bool & status);
-
-    SharemindTdbError tblColCount(const std::string & tbl, size_type & count);
-    SharemindTdbError tblColNames(const std::string & tbl,
+            const std::vector<SharemindTdbType *> & types,
+            const TableOptions & options);
+    SharemindTdbError tblDelete(const void * const owner,
+            const std::string & tbl);
+    SharemindTdbError tblExists(const void * const owner,
+            const std::string & tbl, bool & status);
+
+    SharemindTdbError tblColCount(const void * const owner,
+            const std::string & tbl, size_type & count);
+    SharemindTdbError tblColNames(const void * const owner,
+            const std::string & tbl,
             std::vector<SharemindTdbString *> & names);
-    SharemindTdbError tblColTypes(const std::string & tbl,
+    SharemindTdbError tblColTypes(const void * const owner,
+            const std::string & tbl,
             std::vector<SharemindTdbType *> & types);
-    SharemindTdbError tblRowCount(const std::string & tbl, size_type & count);
+    SharemindTdbError tblRowCount(const void * const owner,
+            const std::string & tbl, size_type & count);
+
+    /* Rewrites a table that is no longer appended to into contiguous
+       datasets, after which no more rows can be inserted: */
+    SharemindTdbError tblCompact(const void * const owner,
+            const std::string & tbl);
 
     /*
      * Table data manipulation functions
      */
 
-    SharemindTdbError insertRow(const std::string & tbl,
+    /*
+     * A batch inserted as columns may give its variable length values as
+     * columns too: each value then holds the bytes of all the rows back to
+     * back, and the lengths of the batch list the lengths of these rows,
+     * value by value. An empty lengths vector keeps the single row values.
+     */
+    SharemindTdbError insertRow(const void * const owner,
+            const std::string & tbl,
             const std::vector<std::vector<SharemindTdbValue *> > & valuesBatch,
-            const std::vector<bool> & valuesAsColumnBatch);
+            const std::vector<bool> & valuesAsColumnBatch,
+            const std::vector<std::vector<size_type> > & lengthsBatch);
 
-    SharemindTdbError readColumn(const std::string & tbl,
+    SharemindTdbError readColumn(const void * const owner,
+            const std::string & tbl,
             const std::vector<SharemindTdbString *> & colIdBatch,
             std::vector<std::vector<SharemindTdbValue *> > & valuesBatch);
-    SharemindTdbError readColumn(const std::string & tbl,
+    SharemindTdbError readColumn(const void * const owner,
+            const std::string & tbl,
             const std::vector<SharemindTdbIndex *> & colIdBatch,
             std::vector<std::vector<SharemindTdbValue *> > & valuesBatch);
 
     SharemindTdbError setAttributes(
+        const void * const owner,
         const std::string & tbl,
         const std::vector<std::pair<SharemindTdbString *, SharemindTdbString *>> & attributes);
     SharemindTdbError getAttributes(
+        const void * const owner,
         const std::string & tbl,
         std::vector<std::pair<SharemindTdbString *, SharemindTdbString *>> & attributes);
 
+    TableFileCacheStats tableFileCacheStats() const noexcept;
+
+    /*
+     * Warm-up
+     */
+
+    void warmUp(const std::vector<std::string> & tables,
+                const std::size_t recentTables);
+
+    /*
+     * Undo support
+     */
+
+    void setUndoRecord(UndoRecord * const undo) noexcept { m_undo = undo; }
+    bool rollback(UndoRecord & undo);
+    void commit(UndoRecord & undo);
+
+    /*
+     * Temporary tables
+     */
+
+    void dropTemporaryTables(const void * const owner);
+
 private: /* Methods: */
 
     /*
@@ -126,28 +329,161 @@ private: /* Methods: */
      * Database operations
      */
 
-    SharemindTdbError readColumn(const hid_t fileId,
+    SharemindTdbError readColumn(const hid_t fileId, const hsize_t rowCount,
             const std::vector<SharemindTdbIndex *> & colNrBatch,
             std::vector<std::vector<SharemindTdbValue *> > & valuesBatch);
     SharemindTdbError readDatasetColumn(const hid_t fileId, const hobj_ref_t ref,
-            const std::vector<std::pair<hsize_t, std::vector<SharemindTdbValue *> *> > & paramBatch);
+            const hsize_t rowCount,
+            const std::vector<std::pair<hsize_t, std::vector<SharemindTdbValue *> *> > & paramBatch,
+            TdbHdf5DatasetBatch & reads);
+
+    bool readMappedColumn(const hid_t fileId, const hid_t oId,
+            const hsize_t columns, const hsize_t column,
+            const hsize_t rowCount, const size_t size, void * const buffer);
+    bool readDirectChunks(const hid_t oId, const hsize_t column,
+            const hsize_t rowCount, const size_t size, void * const buffer);
+
+    bool createVlenBytes(const hid_t fileId, const hid_t dId,
+            const std::string & name);
+    bool setVlenBytesName(const hid_t dId, const std::string & name);
+    bool getVlenBytesName(const hid_t dId, std::string & name);
+    SharemindTdbError getVlenByteCount(const hid_t dId,
+            const hsize_t rowCount, hsize_t & bytes);
+    SharemindTdbError readVlenColumn(const hid_t fileId, const hid_t oId,
+            const hsize_t rowCount, const SharemindTdbType & type,
+            std::vector<SharemindTdbValue *> & values);
+    SharemindTdbError writeVlenColumn(const hid_t fileId, const hid_t oId,
+            const hsize_t rowCount, const hsize_t insertedRowCount,
+            const hvl_t * const values, const hsize_t stride,
+            DatasetExtentMap & cleanup);
+    SharemindTdbError writeDirectChunks(const hid_t oId,
+            const hsize_t rowCount, const hsize_t insertedRowCount,
+            const hsize_t typeCols, const hsize_t typeOffset,
+            const hsize_t columns, const size_t size,
+            const void * const buffer, hsize_t & writtenRows);
+
+    SharemindTdbError createVirtualDataset(const hid_t fileId,
+            const hid_t partitionId, const std::string & name,
+            const std::string & partitionPattern, const hid_t tId,
+            const hid_t plistId, const hsize_t columns,
+            const hsize_t partitionRows, hid_t & dId);
+    SharemindTdbError writePartitionRows(
+            const boost::filesystem::path & tblPath, const hid_t oId,
+            const hid_t tId, const hid_t mSId, const hsize_t partitionRows,
+            const hsize_t rowCount, const hsize_t insertedRowCount,
+            const hsize_t typeOffset, const hsize_t columns,
+            const void * const buffer, PartitionFileMap & partitionFiles,
+            std::vector<boost::filesystem::path> & createdPartitions);
+    hid_t openPartition(const boost::filesystem::path & tblPath,
+            const hsize_t partition, bool & created);
+    void removePartitions(
+            const std::vector<boost::filesystem::path> & partitions);
+    bool copyPartitionLayout(const hid_t srcId, const hid_t dstId);
+
+    SharemindTdbError copyTable(const hid_t srcId, const hid_t dstId,
+            const bool compact);
+    SharemindTdbError compactDataset(const hid_t srcId, const hobj_ref_t ref,
+            const hid_t dstId, const char * const name,
+            const hsize_t rowCount);
+    SharemindTdbError copyVlenBytes(const hid_t srcId, const hid_t dstId,
+            const char * const name, const bool compact,
+            const hsize_t rowCount);
 
     SharemindTdbError objRefToType(const hid_t fileId, const hobj_ref_t ref, hid_t & aId, SharemindTdbType & type);
 
     SharemindTdbError getColumnCount(const hid_t fileId, hsize_t & ncols);
     SharemindTdbError getRowCount(const hid_t fileId, hsize_t & nrows);
     SharemindTdbError setRowCount(const hid_t fileId, const hsize_t nrows);
+    SharemindTdbError getPartitionRows(const hid_t fileId, hsize_t & rows);
+    SharemindTdbError getCommittedRowCount(const std::string & tbl,
+            const hid_t fileId, hsize_t & nrows);
+    bool restoreExtents(const hid_t fileId, const DatasetExtentMap & extents);
+
+    bool checkWritable(const char * const operation) const;
+    bool refreshObject(const hid_t oId) const;
+
+    void addCreatedTable(const void * const owner, const std::string & tbl,
+            const std::vector<SharemindTdbString *> & names,
+            const std::vector<SharemindTdbType *> & types);
+    void saveTableTemplate(const std::string & tbl, const std::string & key,
+            const boost::filesystem::path & tblPath);
+
+    bool openContainer();
+    void containerTables(
+            std::map<std::string, boost::filesystem::path> & tables);
+    bool inContainer(const std::string & tbl, bool & status);
+    SharemindTdbError promoteTable(const void * const owner,
+            const std::string & tbl);
+
+    boost::filesystem::path temporaryPath();
+    hid_t createTemporaryFile();
+    TemporaryTable * findTemporaryTable(const void * const owner,
+            const std::string & tbl);
+    SharemindTdbError spillTable(const void * const owner,
+            const std::string & tbl);
+    bool closeTemporaryTable(const std::string & tbl,
+            const TemporaryTable & table);
+    bool dropTemporaryTable(const void * const owner,
+            const std::string & tbl);
 
     bool closeTableFile(const std::string & tbl);
-    hid_t openTableFile(const std::string & tbl);
+    bool closeTableHandle(const hid_t id);
+    hid_t openTableFile(const void * const owner, const std::string & tbl);
+    void releaseTableFile(const void * const owner, const std::string & tbl);
+    void evictTableFiles();
+    void logTableFileCacheStats(const char * const event) const;
 
 private: /* Fields: */
 
     const LogHard::Logger m_logger;
 
     boost::filesystem::path m_path;
+    TdbHdf5Storage m_storage;
+
+    const TdbHdf5ConnectionConf::SwmrMode m_swmrMode;
+    hid_t m_fileAccessPlist;
+
+    /* Whether the files are accessed through the asynchronous VOL connector,
+       which does not pass the chunk operations on to the native one: */
+    bool m_asyncVol = false;
+
+    /* Shared file holding the small tables, not used in SWMR mode: */
+    hid_t m_containerId = H5I_INVALID_HID;
+    const hsize_t m_containerTableMaxRows;
+
+    /* Empty table files to copy new tables of the same schema and options
+       from, by a key made of both. Discarded when the connection is opened: */
+    boost::filesystem::path m_templatePath;
+    std::map<std::string, boost::filesystem::path> m_tableTemplates;
+    std::size_t m_templateCount = 0u;
+
+    /* Not maintained in SWMR read mode, as the writer owns the catalog: */
+    std::unique_ptr<TdbHdf5Catalog> m_catalog;
 
     TableFileMap m_tableFiles;
+    /* Names of the open tables, most recently used first: */
+    std::list<std::string> m_tableFileLru;
+    const std::size_t m_maxOpenTableFiles;
+
+    /* Threads filtering the chunks written directly, the calling one
+       included: */
+    const std::size_t m_chunkWorkerThreads;
+
+    std::uint64_t m_tableFileHits = 0u;
+    std::uint64_t m_tableFileMisses = 0u;
+    std::uint64_t m_tableFileEvictions = 0u;
+
+    /* Tables kept in memory through the core file driver, not in the
+       catalog, by the owner given to the operations creating them: */
+    std::map<const void *, TemporaryTableMap> m_temporaryTables;
+    /* Files of the temporary tables are named by a count, the spilled ones
+       are discarded when the connection is opened: */
+    std::size_t m_temporaryCount = 0u;
+
+    UndoRecord * m_undo = nullptr;
+
+    /* Row counts of the tables with uncommitted insertions: */
+    std::map<std::string, hsize_t> m_committedRowCounts;
 
 }; /* class TdbHdf5Connection { */
 
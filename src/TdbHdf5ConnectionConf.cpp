@@ -20,13 +20,143 @@
 #include "TdbHdf5ConnectionConf.h"
 
 #include <sharemind/libconfiguration/Configuration.h>
+#include <sstream>
 
 
 namespace sharemind {
 
-TdbHdf5ConnectionConf::TdbHdf5ConnectionConf(std::string const & filename)
-    : m_databasePath(Configuration(filename).get<std::string>("DatabasePath"))
-{}
+SHAREMIND_DEFINE_EXCEPTION_NOINLINE(sharemind::Exception,
+                                    TdbHdf5ConnectionConf::,
+                                    Exception);
+SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
+        Exception,
+        TdbHdf5ConnectionConf::,
+        InvalidSwmrModeException,
+        "Invalid SwmrMode given, expected \"disabled\", \"write\" or "
+        "\"read\".");
+SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
+        Exception,
+        TdbHdf5ConnectionConf::,
+        InvalidMaxOpenTableFilesException,
+        "MaxOpenTableFiles must be positive.");
+SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
+        Exception,
+        TdbHdf5ConnectionConf::,
+        InvalidKeepAliveTimeoutException,
+        "KeepAliveTimeout must not be negative.");
+SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
+        Exception,
+        TdbHdf5ConnectionConf::,
+        InvalidStoragePlacementException,
+        "Invalid StoragePlacement given, expected \"hash\", \"roundrobin\" "
+        "or \"freespace\".");
+SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
+        Exception,
+        TdbHdf5ConnectionConf::,
+        InvalidStorageLayoutException,
+        "Invalid StorageLayout given, expected \"flat\" or \"hashed\".");
+SHAREMIND_DEFINE_EXCEPTION_CONST_MSG_NOINLINE(
+        Exception,
+        TdbHdf5ConnectionConf::,
+        InvalidFileDriverException,
+        "Invalid FileDriver given, expected \"sec2\" or \"io_uring\".");
+
+TdbHdf5ConnectionConf::TdbHdf5ConnectionConf(std::string const & filename) {
+    Configuration const conf(filename);
+
+    m_databasePath = conf.get<std::string>("DatabasePath");
+
+    auto const swmrMode(conf.get<std::string>("SwmrMode", "disabled"));
+    if (swmrMode == "disabled") {
+        m_swmrMode = SwmrMode::Disabled;
+    } else if (swmrMode == "write") {
+        m_swmrMode = SwmrMode::Write;
+    } else if (swmrMode == "read") {
+        m_swmrMode = SwmrMode::Read;
+    } else {
+        throw InvalidSwmrModeException();
+    }
+
+    m_maxOpenTableFiles = conf.get<std::size_t>("MaxOpenTableFiles", 256u);
+    if (m_maxOpenTableFiles == 0u)
+        throw InvalidMaxOpenTableFilesException();
+
+    /* Number of seconds to keep the connection open after the last process
+       using the data source has exited: */
+    auto const keepAliveTimeout(conf.get<long>("KeepAliveTimeout", 0));
+    if (keepAliveTimeout < 0)
+        throw InvalidKeepAliveTimeoutException();
+    m_keepAliveTimeout = std::chrono::seconds(keepAliveTimeout);
+
+    /* Tables to open when the data source is warmed up at module
+       initialization, given as a whitespace-separated list and/or the number
+       of the most recently modified tables: */
+    std::istringstream warmUpTables(
+                conf.get<std::string>("WarmUpTables", std::string()));
+    for (std::string tbl; warmUpTables >> tbl;)
+        m_warmUpTables.emplace_back(std::move(tbl));
+    m_warmUpRecentTables = conf.get<std::size_t>("WarmUpRecentTables", 0u);
+
+    /* Additional directories, typically on separate devices, to store the
+       table files in, given as a whitespace-separated list. The DatabasePath
+       is always used as well and holds the table catalog: */
+    std::istringstream storagePaths(
+                conf.get<std::string>("StoragePaths", std::string()));
+    for (std::string path; storagePaths >> path;)
+        m_storagePaths.emplace_back(std::move(path));
+
+    auto const storagePlacement(
+                conf.get<std::string>("StoragePlacement", "hash"));
+    if (storagePlacement == "hash") {
+        m_storagePlacement = StoragePlacement::Hash;
+    } else if (storagePlacement == "roundrobin") {
+        m_storagePlacement = StoragePlacement::RoundRobin;
+    } else if (storagePlacement == "freespace") {
+        m_storagePlacement = StoragePlacement::FreeSpace;
+    } else {
+        throw InvalidStoragePlacementException();
+    }
+
+    /* Existing table files are moved to the hashed layout when the data
+       source is opened, there is no migration back to the flat layout: */
+    auto const storageLayout(conf.get<std::string>("StorageLayout", "flat"));
+    if (storageLayout == "flat") {
+        m_storageLayout = StorageLayout::Flat;
+    } else if (storageLayout == "hashed") {
+        m_storageLayout = StorageLayout::Hashed;
+    } else {
+        throw InvalidStorageLayoutException();
+    }
+
+    /* New tables are stored in a container file shared by the data source
+       until they have more rows than this. With 0, no tables are added to the
+       container and the tables in it are moved out when inserted into: */
+    m_containerTableMaxRows =
+            conf.get<std::size_t>("ContainerTableMaxRows", 0u);
+
+    /* Threads filtering the chunks of large appends written directly to the
+       table files and of column scans read directly from them, 0 for one per
+       processor: */
+    m_chunkWorkerThreads = conf.get<std::size_t>("ChunkWorkerThreads", 0u);
+
+    /* The default driver is used where io_uring is not available: */
+    auto const fileDriver(conf.get<std::string>("FileDriver", "sec2"));
+    if (fileDriver == "sec2") {
+        m_fileDriver = FileDriver::Sec2;
+    } else if (fileDriver == "io_uring") {
+        m_fileDriver = FileDriver::IoUring;
+    } else {
+        throw InvalidFileDriverException();
+    }
+
+    /* Read large requests past the page cache with the io_uring driver, on
+       the file systems supporting direct I/O: */
+    m_directIo = conf.get<bool>("DirectIo", false);
+
+    /* Create new tables by copying a template of an earlier table with the
+       same schema instead of building their files from scratch: */
+    m_tableTemplates = conf.get<bool>("TableTemplates", true);
+}
 
 TdbHdf5ConnectionConf::TdbHdf5ConnectionConf(TdbHdf5ConnectionConf &&) noexcept
     = default;
@@ -20,13 +20,65 @@
 #ifndef SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5CONNECTIONCONF_H
 #define SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5CONNECTIONCONF_H
 
+#include <chrono>
+#include <cstddef>
+#include <sharemind/Exception.h>
+#include <sharemind/ExceptionMacros.h>
 #include <string>
+#include <vector>
 
 
 namespace sharemind {
 
 class __attribute__ ((visibility("internal"))) TdbHdf5ConnectionConf {
 
+public: /* Types: */
+
+    SHAREMIND_DECLARE_EXCEPTION_NOINLINE(sharemind::Exception, Exception);
+    SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(Exception,
+                                                   InvalidSwmrModeException);
+    SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(
+            Exception,
+            InvalidMaxOpenTableFilesException);
+    SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(
+            Exception,
+            InvalidKeepAliveTimeoutException);
+    SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(
+            Exception,
+            InvalidStoragePlacementException);
+    SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(
+            Exception,
+            InvalidStorageLayoutException);
+    SHAREMIND_DECLARE_EXCEPTION_CONST_MSG_NOINLINE(
+            Exception,
+            InvalidFileDriverException);
+
+    /* Single-writer/multiple-reader access to the table files: */
+    enum class SwmrMode {
+        Disabled,
+        Write, /* Append as the single writer while others read. */
+        Read   /* Read-only access while another process appends. */
+    };
+
+    /* Choice of the storage path for new table files: */
+    enum class StoragePlacement {
+        Hash,       /* By a hash of the table name. */
+        RoundRobin, /* In turns. */
+        FreeSpace   /* On the file system with the most available space. */
+    };
+
+    /* Arrangement of the table files in a storage path: */
+    enum class StorageLayout {
+        Flat,  /* Directly in the storage path. */
+        Hashed /* In two levels of subdirectories named by a name hash. */
+    };
+
+    /* HDF5 file driver doing the I/O of the table files: */
+    enum class FileDriver {
+        Sec2,   /* The default driver of HDF5. */
+        IoUring /* Submits the I/O through io_uring. */
+    };
+
 public: /* Methods: */
 
     TdbHdf5ConnectionConf(std::string const & filename);
@@ -40,10 +92,44 @@ public: /* Methods: */
     TdbHdf5ConnectionConf & operator=(TdbHdf5ConnectionConf const &);
 
     std::string const & databasePath() const noexcept { return m_databasePath; }
+    SwmrMode swmrMode() const noexcept { return m_swmrMode; }
+    std::size_t maxOpenTableFiles() const noexcept
+    { return m_maxOpenTableFiles; }
+    std::chrono::seconds keepAliveTimeout() const noexcept
+    { return m_keepAliveTimeout; }
+    std::vector<std::string> const & warmUpTables() const noexcept
+    { return m_warmUpTables; }
+    std::size_t warmUpRecentTables() const noexcept
+    { return m_warmUpRecentTables; }
+    std::vector<std::string> const & storagePaths() const noexcept
+    { return m_storagePaths; }
+    StoragePlacement storagePlacement() const noexcept
+    { return m_storagePlacement; }
+    StorageLayout storageLayout() const noexcept { return m_storageLayout; }
+    std::size_t containerTableMaxRows() const noexcept
+    { return m_containerTableMaxRows; }
+    std::size_t chunkWorkerThreads() const noexcept
+    { return m_chunkWorkerThreads; }
+    FileDriver fileDriver() const noexcept { return m_fileDriver; }
+    bool directIo() const noexcept { return m_directIo; }
+    bool tableTemplates() const noexcept { return m_tableTemplates; }
 
 private: /* Fields: */
 
     std::string m_databasePath;
+    SwmrMode m_swmrMode;
+    std::size_t m_maxOpenTableFiles;
+    std::chrono::seconds m_keepAliveTimeout;
+    std::vector<std::string> m_warmUpTables;
+    std::size_t m_warmUpRecentTables;
+    std::vector<std::string> m_storagePaths;
+    StoragePlacement m_storagePlacement;
+    StorageLayout m_storageLayout;
+    std::size_t m_containerTableMaxRows;
+    std::size_t m_chunkWorkerThreads;
+    FileDriver m_fileDriver;
+    bool m_directIo;
+    bool m_tableTemplates;
 
 }; /* class TdbHdf5ConnectionConf { */
 
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "TdbHdf5DatasetBatch.h"
+
+#include <cassert>
+#include <cstddef>
+#include <H5Dpublic.h>
+#include <H5Ppublic.h>
+#include <initializer_list>
+#if defined(SHAREMIND_TDB_HDF5_ASYNC_VOL) && H5_VERSION_GE(1,13,0)
+#include <H5ESpublic.h>
+#define TDB_HDF5_ASYNC_IO
+#endif
+
+
+#ifdef TDB_HDF5_ASYNC_IO
+namespace {
+
+/* Issues the I/O of each dataset into an event set and waits for all of it,
+   so that the asynchronous VOL connector can run it concurrently. Returns
+   false if no event set could be created: */
+template <typename Issue>
+bool runAsync(const std::size_t count, Issue const & issue, herr_t & result) {
+    const hid_t esId = H5EScreate();
+    if (esId < 0)
+        return false;
+
+    bool issued = true;
+    for (std::size_t i = 0u; issued && i < count; ++i)
+        issued = issue(i, esId) >= 0;
+
+    // Wait for what was issued even on errors, the buffers are in use
+    std::size_t inProgress = 0u;
+    hbool_t failed = false;
+    const herr_t waited =
+            H5ESwait(esId, H5ES_WAIT_FOREVER, &inProgress, &failed);
+    H5ESclose(esId);
+
+    result = issued && waited >= 0 && !failed ? 0 : -1;
+    return true;
+}
+
+} // anonymous namespace
+#endif
+
+namespace sharemind {
+
+TdbHdf5DatasetBatch::~TdbHdf5DatasetBatch() noexcept { clear(); }
+
+bool TdbHdf5DatasetBatch::add(const hid_t dId,
+                              const hid_t memTypeId,
+                              const hid_t memSpaceId,
+                              const hid_t fileSpaceId,
+                              void * const buffer)
+{
+    assert(buffer);
+
+    const hid_t ids[] = { dId, memTypeId, memSpaceId, fileSpaceId };
+
+    // Reserve first, so that the references taken are not lost
+    try {
+        m_dIds.reserve(m_dIds.size() + 1u);
+        m_memTypeIds.reserve(m_memTypeIds.size() + 1u);
+        m_memSpaceIds.reserve(m_memSpaceIds.size() + 1u);
+        m_fileSpaceIds.reserve(m_fileSpaceIds.size() + 1u);
+        m_buffers.reserve(m_buffers.size() + 1u);
+    } catch (...) {
+        return false;
+    }
+
+    for (std::size_t i = 0u; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+        if (H5Iinc_ref(ids[i]) < 0) {
+            while (i-- > 0u)
+                H5Idec_ref(ids[i]);
+            return false;
+        }
+    }
+
+    m_dIds.push_back(dId);
+    m_memTypeIds.push_back(memTypeId);
+    m_memSpaceIds.push_back(memSpaceId);
+    m_fileSpaceIds.push_back(fileSpaceId);
+    m_buffers.push_back(buffer);
+    return true;
+}
+
+herr_t TdbHdf5DatasetBatch::read() const {
+    if (m_dIds.empty())
+        return 0;
+
+    #ifdef TDB_HDF5_ASYNC_IO
+    herr_t result = 0;
+    auto const issue = [this](const std::size_t i, const hid_t esId) {
+        return H5Dread_async(m_dIds[i],
+                             m_memTypeIds[i],
+                             m_memSpaceIds[i],
+                             m_fileSpaceIds[i],
+                             H5P_DEFAULT,
+                             m_buffers[i],
+                             esId);
+    };
+    if (runAsync(m_dIds.size(), issue, result))
+        return result;
+    #endif
+
+    #if H5_VERSION_GE(1,14,0)
+    return H5Dread_multi(m_dIds.size(),
+                         const_cast<hid_t *>(m_dIds.data()),
+                         const_cast<hid_t *>(m_memTypeIds.data()),
+                         const_cast<hid_t *>(m_memSpaceIds.data()),
+                         const_cast<hid_t *>(m_fileSpaceIds.data()),
+                         H5P_DEFAULT,
+                         const_cast<void **>(m_buffers.data()));
+    #else
+    for (std::size_t i = 0u; i < m_dIds.size(); ++i)
+        if (H5Dread(m_dIds[i],
+                    m_memTypeIds[i],
+                    m_memSpaceIds[i],
+                    m_fileSpaceIds[i],
+                    H5P_DEFAULT,
+                    m_buffers[i]) < 0)
+            return -1;
+    return 0;
+    #endif
+}
+
+herr_t TdbHdf5DatasetBatch::write() const {
+    if (m_dIds.empty())
+        return 0;
+
+    #ifdef TDB_HDF5_ASYNC_IO
+    herr_t result = 0;
+    auto const issue = [this](const std::size_t i, const hid_t esId) {
+        return H5Dwrite_async(m_dIds[i],
+                              m_memTypeIds[i],
+                              m_memSpaceIds[i],
+                              m_fileSpaceIds[i],
+                              H5P_DEFAULT,
+                              m_buffers[i],
+                              esId);
+    };
+    if (runAsync(m_dIds.size(), issue, result))
+        return result;
+    #endif
+
+    #if H5_VERSION_GE(1,14,0)
+    std::vector<const void *> buffers(m_buffers.begin(), m_buffers.end());
+    return H5Dwrite_multi(m_dIds.size(),
+                          const_cast<hid_t *>(m_dIds.data()),
+                          const_cast<hid_t *>(m_memTypeIds.data()),
+                          const_cast<hid_t *>(m_memSpaceIds.data()),
+                          const_cast<hid_t *>(m_fileSpaceIds.data()),
+                          H5P_DEFAULT,
+                          buffers.data());
+    #else
+    for (std::size_t i = 0u; i < m_dIds.size(); ++i)
+        if (H5Dwrite(m_dIds[i],
+                     m_memTypeIds[i],
+                     m_memSpaceIds[i],
+                     m_fileSpaceIds[i],
+                     H5P_DEFAULT,
+                     m_buffers[i]) < 0)
+            return -1;
+    return 0;
+    #endif
+}
+
+void TdbHdf5DatasetBatch::clear() noexcept {
+    for (std::vector<hid_t> * const ids
+            : { &m_dIds, &m_memTypeIds, &m_memSpaceIds, &m_fileSpaceIds })
+    {
+        for (const hid_t id : *ids)
+            H5Idec_ref(id);
+        ids->clear();
+    }
+    m_buffers.clear();
+}
+
+} /* namespace sharemind { */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5DATASETBATCH_H
+#define SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5DATASETBATCH_H
+
+#include <H5Ipublic.h>
+#include <H5public.h>
+#include <vector>
+
+
+namespace sharemind {
+
+/*
+  Reads or writes of several datasets of a file, done with a single call of
+  the multi-dataset I/O of HDF5 1.14 and later, and one call per dataset with
+  earlier versions. When built with SHAREMIND_TDB_HDF5_ASYNC_VOL, they are
+  issued together into an event set instead, and complete together.
+*/
+class __attribute__ ((visibility("internal"))) TdbHdf5DatasetBatch {
+
+public: /* Methods: */
+
+    TdbHdf5DatasetBatch() noexcept = default;
+    TdbHdf5DatasetBatch(const TdbHdf5DatasetBatch &) = delete;
+    TdbHdf5DatasetBatch & operator=(const TdbHdf5DatasetBatch &) = delete;
+    ~TdbHdf5DatasetBatch() noexcept;
+
+    /* Adds the I/O of a dataset to the batch, which holds references to the
+       identifiers until it is cleared. The selections of the data spaces
+       must not change before the batch is done: */
+    bool add(const hid_t dId,
+             const hid_t memTypeId,
+             const hid_t memSpaceId,
+             const hid_t fileSpaceId,
+             void * const buffer);
+
+    bool empty() const noexcept { return m_dIds.empty(); }
+
+    /* Do the I/O of the batch, the buffers of writes are only read from: */
+    herr_t read() const;
+    herr_t write() const;
+
+    void clear() noexcept;
+
+private: /* Fields: */
+
+    std::vector<hid_t> m_dIds;
+    std::vector<hid_t> m_memTypeIds;
+    std::vector<hid_t> m_memSpaceIds;
+    std::vector<hid_t> m_fileSpaceIds;
+    std::vector<void *> m_buffers;
+
+}; /* class TdbHdf5DatasetBatch { */
+
+} /* namespace sharemind { */
+
+#endif // SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5DATASETBATCH_H
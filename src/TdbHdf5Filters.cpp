@@ -0,0 +1,893 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "TdbHdf5Filters.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <H5Ppublic.h>
+#include <H5public.h>
+#include <H5Tpublic.h>
+#include <initializer_list>
+#include <vector>
+
+
+#define BITPACK_FILTER_NAME     "sharemind bit packing"
+#define BITPACK_HEADER_SIZE     sizeof(std::uint32_t)
+#define ENCODING_DICTIONARY_MAX (65536u)
+#define ENCODING_FILTER_NAME    "sharemind encoding"
+#define ENCODING_HEADER_SIZE    (1u + sizeof(std::uint32_t))
+#define ENCODING_SAMPLE_SIZE    (1024u)
+
+namespace {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "The bit packing kernels assume a little-endian host.");
+
+/*
+  The kernels handle eight bytes at a time in a 64-bit word. Packing gathers
+  the lowest bit of each byte into the highest byte of the product, unpacking
+  spreads the bits of a byte into the eight bytes of a word.
+*/
+constexpr std::uint64_t BIT_PACK_MULTIPLIER = 0x0102040810204080ull;
+constexpr std::uint64_t BIT_BROADCAST = 0x0101010101010101ull;
+constexpr std::uint64_t BIT_SELECT = 0x8040201008040201ull;
+constexpr std::uint64_t BIT_CARRY = 0x7f7f7f7f7f7f7f7full;
+constexpr std::uint64_t NOT_BITS = 0xfefefefefefefefeull;
+
+inline std::uint8_t packByte(const std::uint64_t x) noexcept
+{ return static_cast<std::uint8_t>((x * BIT_PACK_MULTIPLIER) >> 56u); }
+
+inline std::uint64_t unpackByte(const std::uint8_t p) noexcept {
+    return ((((p * BIT_BROADCAST) & BIT_SELECT) + BIT_CARRY) >> 7u)
+           & BIT_BROADCAST;
+}
+
+bool packBits(const std::uint8_t * in,
+              const std::size_t size,
+              std::uint8_t * out) noexcept
+{
+    std::size_t i = 0u;
+    for (; i + 8u <= size; i += 8u, ++out) {
+        std::uint64_t x;
+        std::memcpy(&x, in + i, sizeof(x));
+        if (x & NOT_BITS)
+            return false;
+        *out = packByte(x);
+    }
+
+    if (i < size) {
+        std::uint8_t p = 0u;
+        for (unsigned bit = 0u; i < size; ++i, ++bit) {
+            if (in[i] > 1u)
+                return false;
+            p |= static_cast<std::uint8_t>(in[i] << bit);
+        }
+        *out = p;
+    }
+
+    return true;
+}
+
+void unpackBits(const std::uint8_t * in,
+                const std::size_t size,
+                std::uint8_t * out) noexcept
+{
+    std::size_t i = 0u;
+    for (; i + 8u <= size; i += 8u, ++in) {
+        const std::uint64_t x = unpackByte(*in);
+        std::memcpy(out + i, &x, sizeof(x));
+    }
+
+    for (unsigned bit = 0u; i < size; ++i, ++bit)
+        out[i] = (*in >> bit) & 1u;
+}
+
+htri_t bitPackCanApply(hid_t, hid_t typeId, hid_t) {
+    const size_t size = H5Tget_size(typeId);
+    if (size == 0u)
+        return -1;
+    return size == 1u;
+}
+
+/*
+  The passes of the filters are split into the size of the output and the
+  encoding or decoding itself, which does not call HDF5. This lets the chunks
+  read and written directly be filtered on other threads.
+*/
+
+/* Bound on the size of the output, 0 if the input is malformed: */
+std::size_t bitPackBound(const unsigned flags,
+                         const std::size_t,
+                         const unsigned *,
+                         const std::uint8_t * const in,
+                         const std::size_t nbytes) noexcept
+{
+    if (flags & H5Z_FLAG_REVERSE) {
+        if (nbytes < BITPACK_HEADER_SIZE)
+            return 0u;
+
+        std::uint32_t size;
+        std::memcpy(&size, in, sizeof(size));
+        if (nbytes - BITPACK_HEADER_SIZE < (size + 7u) / 8u)
+            return 0u;
+        return size > 0u ? size : 1u;
+    }
+
+    if (nbytes > UINT32_MAX)
+        return 0u;
+    return BITPACK_HEADER_SIZE + (nbytes + 7u) / 8u;
+}
+
+bool bitPackRun(const unsigned flags,
+                const std::size_t,
+                const unsigned *,
+                const std::uint8_t * const in,
+                const std::size_t nbytes,
+                std::uint8_t * const out,
+                std::size_t & outSize) noexcept
+{
+    if (flags & H5Z_FLAG_REVERSE) {
+        std::uint32_t size;
+        std::memcpy(&size, in, sizeof(size));
+        unpackBits(in + BITPACK_HEADER_SIZE, size, out);
+        outSize = size;
+        return true;
+    }
+
+    const std::uint32_t size = static_cast<std::uint32_t>(nbytes);
+    std::memcpy(out, &size, sizeof(size));
+    outSize = BITPACK_HEADER_SIZE + (nbytes + 7u) / 8u;
+    return packBits(in, nbytes, out + BITPACK_HEADER_SIZE);
+}
+
+using FilterBound = std::size_t (*)(unsigned,
+                                    std::size_t,
+                                    const unsigned *,
+                                    const std::uint8_t *,
+                                    std::size_t);
+using FilterRun = bool (*)(unsigned,
+                           std::size_t,
+                           const unsigned *,
+                           const std::uint8_t *,
+                           std::size_t,
+                           std::uint8_t *,
+                           std::size_t &);
+
+/* The filter callback for HDF5: */
+template <FilterBound bound, FilterRun run>
+size_t runFilter(unsigned flags,
+                 size_t cdNelmts,
+                 const unsigned cdValues[],
+                 size_t nbytes,
+                 size_t * bufSize,
+                 void ** buf)
+{
+    const std::uint8_t * const in = static_cast<const std::uint8_t *>(*buf);
+    const std::size_t maxSize = bound(flags, cdNelmts, cdValues, in, nbytes);
+    if (!maxSize)
+        return 0u;
+
+    std::uint8_t * const out =
+            static_cast<std::uint8_t *>(H5allocate_memory(maxSize, false));
+    if (!out)
+        return 0u;
+
+    std::size_t outSize = 0u;
+    if (!run(flags, cdNelmts, cdValues, in, nbytes, out, outSize)) {
+        H5free_memory(out);
+        return 0u;
+    }
+
+    H5free_memory(*buf);
+    *buf = out;
+    *bufSize = maxSize;
+    return outSize;
+}
+
+const H5Z_class2_t bitPackFilterClass = {
+    H5Z_CLASS_T_VERS,
+    sharemind::TDB_HDF5_FILTER_BITPACK,
+    1,
+    1,
+    BITPACK_FILTER_NAME,
+    bitPackCanApply,
+    nullptr,
+    runFilter<bitPackBound, bitPackRun>
+};
+
+/*
+  The encoding filter turns the values into unsigned keys which keep the order
+  of the values, so signed values have their sign bit flipped. Each encoded
+  chunk starts with a header of the encoding and the size of the decoded chunk.
+*/
+using Keys = std::vector<std::uint64_t>;
+using sharemind::TdbHdf5Encoding;
+
+inline unsigned bitWidth(const std::uint64_t range) noexcept
+{ return range ? 64u - static_cast<unsigned>(__builtin_clzll(range)) : 0u; }
+
+inline std::size_t packedSize(const std::size_t count, const unsigned width)
+        noexcept
+{ return (count * width + 7u) / 8u; }
+
+inline std::uint64_t signBit(const std::size_t valueSize, const bool isSigned)
+        noexcept
+{ return isSigned ? std::uint64_t(1u) << (valueSize * 8u - 1u) : 0u; }
+
+/* Packs keys of at most the given width into a little-endian bit stream: */
+void packWidth(const std::uint64_t * in,
+               const std::size_t count,
+               const unsigned width,
+               std::uint8_t * out) noexcept
+{
+    if (!width)
+        return;
+
+    std::uint64_t acc = 0u;
+    unsigned bits = 0u;
+    for (std::size_t i = 0u; i < count; ++i) {
+        const std::uint64_t key = in[i];
+        acc |= key << bits;
+        bits += width;
+        if (bits >= 64u) {
+            std::memcpy(out, &acc, sizeof(acc));
+            out += sizeof(acc);
+            bits -= 64u;
+            acc = bits ? key >> (width - bits) : 0u;
+        }
+    }
+
+    std::memcpy(out, &acc, (bits + 7u) / 8u);
+}
+
+void unpackWidth(const std::uint8_t * const in,
+                 const std::size_t inSize,
+                 const std::size_t count,
+                 const unsigned width,
+                 std::uint64_t * const out) noexcept
+{
+    if (!width) {
+        std::fill(out, out + count, std::uint64_t(0u));
+        return;
+    }
+
+    const std::uint64_t mask =
+            width < 64u ? (std::uint64_t(1u) << width) - 1u : ~std::uint64_t(0u);
+    for (std::size_t i = 0u; i < count; ++i) {
+        const std::size_t bit = i * width;
+        const std::size_t byte = bit / 8u;
+        const unsigned shift = bit % 8u;
+
+        std::uint64_t word = 0u;
+        std::memcpy(&word, in + byte, std::min<std::size_t>(8u, inSize - byte));
+        std::uint64_t key = word >> shift;
+        if (shift + width > 64u)
+            key |= static_cast<std::uint64_t>(in[byte + 8u]) << (64u - shift);
+        out[i] = key & mask;
+    }
+}
+
+template <typename T>
+void loadKeys(const std::uint8_t * const in,
+              const std::size_t count,
+              const std::uint64_t flip,
+              std::uint64_t * const out) noexcept
+{
+    for (std::size_t i = 0u; i < count; ++i) {
+        T value;
+        std::memcpy(&value, in + i * sizeof(T), sizeof(T));
+        out[i] = static_cast<std::uint64_t>(value) ^ flip;
+    }
+}
+
+template <typename T>
+void storeKeys(const std::uint64_t * const in,
+               const std::size_t count,
+               const std::uint64_t flip,
+               std::uint8_t * const out) noexcept
+{
+    for (std::size_t i = 0u; i < count; ++i) {
+        const T value = static_cast<T>(in[i] ^ flip);
+        std::memcpy(out + i * sizeof(T), &value, sizeof(T));
+    }
+}
+
+bool convertKeys(const std::uint8_t * const in,
+                 const std::size_t count,
+                 const std::size_t valueSize,
+                 const std::uint64_t flip,
+                 std::uint64_t * const out) noexcept
+{
+    switch (valueSize) {
+        case 1u: loadKeys<std::uint8_t>(in, count, flip, out); return true;
+        case 2u: loadKeys<std::uint16_t>(in, count, flip, out); return true;
+        case 4u: loadKeys<std::uint32_t>(in, count, flip, out); return true;
+        case 8u: loadKeys<std::uint64_t>(in, count, flip, out); return true;
+        default: return false;
+    }
+}
+
+bool convertValues(const std::uint64_t * const in,
+                   const std::size_t count,
+                   const std::size_t valueSize,
+                   const std::uint64_t flip,
+                   std::uint8_t * const out) noexcept
+{
+    switch (valueSize) {
+        case 1u: storeKeys<std::uint8_t>(in, count, flip, out); return true;
+        case 2u: storeKeys<std::uint16_t>(in, count, flip, out); return true;
+        case 4u: storeKeys<std::uint32_t>(in, count, flip, out); return true;
+        case 8u: storeKeys<std::uint64_t>(in, count, flip, out); return true;
+        default: return false;
+    }
+}
+
+/* Sizes of the encodings of a chunk, or SIZE_MAX if not applicable: */
+struct EncodingStats {
+    std::uint64_t minKey = ~std::uint64_t(0u);
+    std::uint64_t maxKey = 0u;
+    std::int64_t minDelta = INT64_MAX;
+    std::int64_t maxDelta = INT64_MIN;
+    Keys dictionary;
+
+    std::size_t frameOfReferenceSize(const std::size_t count) const noexcept {
+        return sizeof(std::uint64_t) + 1u
+               + packedSize(count, bitWidth(maxKey - minKey));
+    }
+
+    std::size_t deltaSize(const std::size_t count) const noexcept {
+        return 2u * sizeof(std::uint64_t) + 1u
+               + packedSize(count - 1u,
+                            bitWidth(static_cast<std::uint64_t>(maxDelta)
+                                     - static_cast<std::uint64_t>(minDelta)));
+    }
+
+    std::size_t dictionarySize(const std::size_t count,
+                               const std::size_t valueSize) const noexcept
+    {
+        if (dictionary.empty())
+            return SIZE_MAX;
+        return sizeof(std::uint32_t) + 1u + dictionary.size() * valueSize
+               + packedSize(count, bitWidth(dictionary.size() - 1u));
+    }
+};
+
+void collectRangeStats(const Keys & keys, EncodingStats & stats) noexcept {
+    for (std::size_t i = 0u; i < keys.size(); ++i) {
+        stats.minKey = std::min(stats.minKey, keys[i]);
+        stats.maxKey = std::max(stats.maxKey, keys[i]);
+        if (i > 0u) {
+            const std::int64_t delta =
+                    static_cast<std::int64_t>(keys[i] - keys[i - 1u]);
+            stats.minDelta = std::min(stats.minDelta, delta);
+            stats.maxDelta = std::max(stats.maxDelta, delta);
+        }
+    }
+}
+
+/* Leaves the dictionary empty if there are too many distinct values: */
+void collectDictionary(const Keys & keys, EncodingStats & stats) {
+    Keys dictionary(keys);
+    std::sort(dictionary.begin(), dictionary.end());
+    dictionary.erase(std::unique(dictionary.begin(), dictionary.end()),
+                     dictionary.end());
+    if (dictionary.size() <= ENCODING_DICTIONARY_MAX)
+        stats.dictionary = std::move(dictionary);
+}
+
+/* Whether the distinct values of a sample of the keys are few enough for a
+   dictionary to pay off: */
+bool looksLowCardinality(const Keys & keys) {
+    const std::size_t step =
+            std::max<std::size_t>(keys.size() / ENCODING_SAMPLE_SIZE, 1u);
+    Keys sample;
+    sample.reserve(ENCODING_SAMPLE_SIZE + 1u);
+    for (std::size_t i = 0u; i < keys.size(); i += step)
+        sample.push_back(keys[i]);
+
+    std::sort(sample.begin(), sample.end());
+    const std::size_t distinct = static_cast<std::size_t>(
+                std::unique(sample.begin(), sample.end()) - sample.begin());
+    return distinct * 4u <= sample.size();
+}
+
+TdbHdf5Encoding chooseEncoding(const Keys & keys,
+                               const std::size_t valueSize,
+                               const TdbHdf5Encoding requested,
+                               EncodingStats & stats)
+{
+    const std::size_t count = keys.size();
+    const std::size_t rawSize = count * valueSize;
+    if (count < 2u)
+        return TdbHdf5Encoding::Raw;
+
+    std::size_t size = rawSize;
+    TdbHdf5Encoding encoding = TdbHdf5Encoding::Raw;
+    auto const consider = [&size, &encoding](TdbHdf5Encoding const e,
+                                             std::size_t const s)
+    {
+        if (s < size) {
+            size = s;
+            encoding = e;
+        }
+    };
+
+    switch (requested) {
+        case TdbHdf5Encoding::Raw:
+            break;
+        case TdbHdf5Encoding::Dictionary:
+            collectDictionary(keys, stats);
+            consider(requested, stats.dictionarySize(count, valueSize));
+            break;
+        case TdbHdf5Encoding::Delta:
+            collectRangeStats(keys, stats);
+            consider(requested, stats.deltaSize(count));
+            break;
+        case TdbHdf5Encoding::FrameOfReference:
+            collectRangeStats(keys, stats);
+            consider(requested, stats.frameOfReferenceSize(count));
+            break;
+        case TdbHdf5Encoding::Auto:
+            collectRangeStats(keys, stats);
+            consider(TdbHdf5Encoding::FrameOfReference,
+                     stats.frameOfReferenceSize(count));
+            consider(TdbHdf5Encoding::Delta, stats.deltaSize(count));
+            if (looksLowCardinality(keys)) {
+                collectDictionary(keys, stats);
+                consider(TdbHdf5Encoding::Dictionary,
+                         stats.dictionarySize(count, valueSize));
+            }
+            break;
+    }
+
+    return encoding;
+}
+
+/* Writes the encoded keys, returns the size written: */
+std::size_t encodeKeys(Keys & keys,
+                       const std::size_t valueSize,
+                       const std::uint64_t flip,
+                       const TdbHdf5Encoding encoding,
+                       const EncodingStats & stats,
+                       std::uint8_t * const out)
+{
+    const std::size_t count = keys.size();
+    std::uint8_t * o = out;
+
+    switch (encoding) {
+        case TdbHdf5Encoding::Dictionary: {
+            const std::uint32_t dictSize =
+                    static_cast<std::uint32_t>(stats.dictionary.size());
+            const std::uint8_t width = static_cast<std::uint8_t>(
+                        bitWidth(dictSize - 1u));
+            std::memcpy(o, &dictSize, sizeof(dictSize));
+            o += sizeof(dictSize);
+            *o++ = width;
+            convertValues(stats.dictionary.data(), dictSize, valueSize, flip, o);
+            o += dictSize * valueSize;
+
+            for (std::uint64_t & key : keys)
+                key = static_cast<std::uint64_t>(
+                            std::lower_bound(stats.dictionary.begin(),
+                                             stats.dictionary.end(),
+                                             key)
+                            - stats.dictionary.begin());
+            packWidth(keys.data(), count, width, o);
+            return static_cast<std::size_t>(o - out) + packedSize(count, width);
+        }
+        case TdbHdf5Encoding::Delta: {
+            const std::uint64_t first = keys[0u];
+            const std::uint64_t base = static_cast<std::uint64_t>(stats.minDelta);
+            const std::uint8_t width = static_cast<std::uint8_t>(
+                        bitWidth(static_cast<std::uint64_t>(stats.maxDelta) - base));
+            std::memcpy(o, &first, sizeof(first));
+            o += sizeof(first);
+            std::memcpy(o, &base, sizeof(base));
+            o += sizeof(base);
+            *o++ = width;
+
+            for (std::size_t i = count - 1u; i > 0u; --i)
+                keys[i] = keys[i] - keys[i - 1u] - base;
+            packWidth(keys.data() + 1u, count - 1u, width, o);
+            return static_cast<std::size_t>(o - out)
+                   + packedSize(count - 1u, width);
+        }
+        case TdbHdf5Encoding::FrameOfReference: {
+            const std::uint64_t base = stats.minKey;
+            const std::uint8_t width = static_cast<std::uint8_t>(
+                        bitWidth(stats.maxKey - base));
+            std::memcpy(o, &base, sizeof(base));
+            o += sizeof(base);
+            *o++ = width;
+
+            for (std::uint64_t & key : keys)
+                key -= base;
+            packWidth(keys.data(), count, width, o);
+            return static_cast<std::size_t>(o - out) + packedSize(count, width);
+        }
+        case TdbHdf5Encoding::Raw:
+        case TdbHdf5Encoding::Auto:
+            break;
+    }
+
+    assert(false);
+    return 0u;
+}
+
+/* Decodes into keys, returns false on a malformed chunk: */
+bool decodeKeys(const std::uint8_t * in,
+                std::size_t inSize,
+                const std::size_t valueSize,
+                const std::uint64_t flip,
+                const TdbHdf5Encoding encoding,
+                Keys & keys)
+{
+    const std::size_t count = keys.size();
+
+    switch (encoding) {
+        case TdbHdf5Encoding::Dictionary: {
+            std::uint32_t dictSize;
+            if (inSize < sizeof(dictSize) + 1u)
+                return false;
+            std::memcpy(&dictSize, in, sizeof(dictSize));
+            const unsigned width = in[sizeof(dictSize)];
+            in += sizeof(dictSize) + 1u;
+            inSize -= sizeof(dictSize) + 1u;
+            if (!dictSize || width > 32u
+                || inSize < std::size_t(dictSize) * valueSize
+                            + packedSize(count, width))
+                return false;
+
+            Keys dictionary(dictSize);
+            convertKeys(in, dictSize, valueSize, flip, dictionary.data());
+            in += std::size_t(dictSize) * valueSize;
+            inSize -= std::size_t(dictSize) * valueSize;
+
+            unpackWidth(in, inSize, count, width, keys.data());
+            for (std::uint64_t & key : keys) {
+                if (key >= dictSize)
+                    return false;
+                key = dictionary[key];
+            }
+            return true;
+        }
+        case TdbHdf5Encoding::Delta: {
+            std::uint64_t first, base;
+            if (count == 0u || inSize < sizeof(first) + sizeof(base) + 1u)
+                return false;
+            std::memcpy(&first, in, sizeof(first));
+            std::memcpy(&base, in + sizeof(first), sizeof(base));
+            const unsigned width = in[sizeof(first) + sizeof(base)];
+            in += sizeof(first) + sizeof(base) + 1u;
+            inSize -= sizeof(first) + sizeof(base) + 1u;
+            if (width > 64u || inSize < packedSize(count - 1u, width))
+                return false;
+
+            keys[0u] = first;
+            unpackWidth(in, inSize, count - 1u, width, keys.data() + 1u);
+            for (std::size_t i = 1u; i < count; ++i)
+                keys[i] += keys[i - 1u] + base;
+            return true;
+        }
+        case TdbHdf5Encoding::FrameOfReference: {
+            std::uint64_t base;
+            if (inSize < sizeof(base) + 1u)
+                return false;
+            std::memcpy(&base, in, sizeof(base));
+            const unsigned width = in[sizeof(base)];
+            in += sizeof(base) + 1u;
+            inSize -= sizeof(base) + 1u;
+            if (width > 64u || inSize < packedSize(count, width))
+                return false;
+
+            unpackWidth(in, inSize, count, width, keys.data());
+            for (std::uint64_t & key : keys)
+                key += base;
+            return true;
+        }
+        case TdbHdf5Encoding::Raw:
+        case TdbHdf5Encoding::Auto:
+            break;
+    }
+
+    return false;
+}
+
+htri_t encodingCanApply(hid_t, hid_t typeId, hid_t) {
+    const size_t size = H5Tget_size(typeId);
+    if (size == 0u)
+        return -1;
+    return size == 1u || size == 2u || size == 4u || size == 8u;
+}
+
+bool encodingParameters(const std::size_t cdNelmts,
+                        const unsigned * const cdValues,
+                        std::size_t & valueSize,
+                        std::uint64_t & flip) noexcept
+{
+    if (cdNelmts < 3u)
+        return false;
+
+    valueSize = cdValues[1u];
+    if (valueSize != 1u && valueSize != 2u && valueSize != 4u && valueSize != 8u)
+        return false;
+
+    flip = signBit(valueSize, cdValues[2u] != 0u);
+    return true;
+}
+
+std::size_t encodingBound(const unsigned flags,
+                          const std::size_t cdNelmts,
+                          const unsigned * const cdValues,
+                          const std::uint8_t * const in,
+                          const std::size_t nbytes) noexcept
+{
+    std::size_t valueSize;
+    std::uint64_t flip;
+    if (!encodingParameters(cdNelmts, cdValues, valueSize, flip))
+        return 0u;
+
+    if (flags & H5Z_FLAG_REVERSE) {
+        if (nbytes < ENCODING_HEADER_SIZE)
+            return 0u;
+
+        std::uint32_t size;
+        std::memcpy(&size, in + 1u, sizeof(size));
+        if (size % valueSize)
+            return 0u;
+        return size > 0u ? size : 1u;
+    }
+
+    if (nbytes > UINT32_MAX || nbytes % valueSize)
+        return 0u;
+    return ENCODING_HEADER_SIZE + nbytes;
+}
+
+bool encodingRun(const unsigned flags,
+                 const std::size_t cdNelmts,
+                 const unsigned * const cdValues,
+                 const std::uint8_t * const in,
+                 const std::size_t nbytes,
+                 std::uint8_t * const out,
+                 std::size_t & outSize) noexcept
+{
+    std::size_t valueSize;
+    std::uint64_t flip;
+    if (!encodingParameters(cdNelmts, cdValues, valueSize, flip))
+        return false;
+
+    try {
+        if (flags & H5Z_FLAG_REVERSE) {
+            const TdbHdf5Encoding encoding = static_cast<TdbHdf5Encoding>(in[0u]);
+            std::uint32_t size;
+            std::memcpy(&size, in + 1u, sizeof(size));
+            outSize = size;
+
+            if (encoding == TdbHdf5Encoding::Raw) {
+                if (nbytes - ENCODING_HEADER_SIZE < size)
+                    return false;
+                std::memcpy(out, in + ENCODING_HEADER_SIZE, size);
+                return true;
+            }
+
+            Keys keys(size / valueSize);
+            if (!decodeKeys(in + ENCODING_HEADER_SIZE,
+                            nbytes - ENCODING_HEADER_SIZE,
+                            valueSize,
+                            flip,
+                            encoding,
+                            keys))
+                return false;
+            convertValues(keys.data(), keys.size(), valueSize, flip, out);
+            return true;
+        }
+
+        const TdbHdf5Encoding requested =
+                static_cast<TdbHdf5Encoding>(cdValues[0u]);
+        Keys keys(nbytes / valueSize);
+        convertKeys(in, keys.size(), valueSize, flip, keys.data());
+
+        EncodingStats stats;
+        const TdbHdf5Encoding encoding =
+                chooseEncoding(keys, valueSize, requested, stats);
+
+        const std::uint32_t size = static_cast<std::uint32_t>(nbytes);
+        out[0u] = static_cast<std::uint8_t>(encoding);
+        std::memcpy(out + 1u, &size, sizeof(size));
+        if (encoding == TdbHdf5Encoding::Raw) {
+            std::memcpy(out + ENCODING_HEADER_SIZE, in, nbytes);
+            outSize = ENCODING_HEADER_SIZE + nbytes;
+        } else {
+            outSize = ENCODING_HEADER_SIZE
+                      + encodeKeys(keys,
+                                   valueSize,
+                                   flip,
+                                   encoding,
+                                   stats,
+                                   out + ENCODING_HEADER_SIZE);
+        }
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+const H5Z_class2_t encodingFilterClass = {
+    H5Z_CLASS_T_VERS,
+    sharemind::TDB_HDF5_FILTER_ENCODING,
+    1,
+    1,
+    ENCODING_FILTER_NAME,
+    encodingCanApply,
+    nullptr,
+    runFilter<encodingBound, encodingRun>
+};
+
+/* The passes of the filters of this module: */
+bool filterKernel(const H5Z_filter_t id,
+                  FilterBound & bound,
+                  FilterRun & run) noexcept
+{
+    if (id == sharemind::TDB_HDF5_FILTER_BITPACK) {
+        bound = bitPackBound;
+        run = bitPackRun;
+        return true;
+    } else if (id == sharemind::TDB_HDF5_FILTER_ENCODING) {
+        bound = encodingBound;
+        run = encodingRun;
+        return true;
+    }
+    return false;
+}
+
+bool runKernel(const H5Z_filter_t id,
+               const unsigned flags,
+               std::vector<unsigned> const & cdValues,
+               std::vector<unsigned char> & chunk,
+               std::vector<unsigned char> & scratch)
+{
+    FilterBound bound;
+    FilterRun run;
+    if (!filterKernel(id, bound, run))
+        return false;
+
+    const std::uint8_t * const in = chunk.data();
+    const std::size_t maxSize =
+            bound(flags, cdValues.size(), cdValues.data(), in, chunk.size());
+    if (!maxSize)
+        return false;
+
+    scratch.resize(maxSize);
+    std::size_t outSize = 0u;
+    if (!run(flags, cdValues.size(), cdValues.data(), in, chunk.size(),
+             scratch.data(), outSize))
+        return false;
+
+    scratch.resize(outSize);
+    chunk.swap(scratch);
+    return true;
+}
+
+} // anonymous namespace
+
+namespace sharemind {
+
+bool registerTdbHdf5Filters() {
+    for (const H5Z_class2_t * const filterClass : { &bitPackFilterClass,
+                                                    &encodingFilterClass })
+    {
+        const htri_t avail = H5Zfilter_avail(filterClass->id);
+        if (avail < 0 || (!avail && H5Zregister(filterClass) < 0))
+            return false;
+    }
+    return true;
+}
+
+bool setEncodingFilter(const hid_t plistId,
+                       const TdbHdf5Encoding encoding,
+                       const std::size_t valueSize,
+                       const bool isSigned)
+{
+    const unsigned cdValues[] = { static_cast<unsigned>(encoding),
+                                  static_cast<unsigned>(valueSize),
+                                  isSigned ? 1u : 0u };
+    return H5Pset_filter(plistId,
+                         TDB_HDF5_FILTER_ENCODING,
+                         H5Z_FLAG_MANDATORY,
+                         3u,
+                         cdValues) >= 0;
+}
+
+bool TdbHdf5ChunkFilters::load(const hid_t plistId) {
+    m_filters.clear();
+
+    const int nfilters = H5Pget_nfilters(plistId);
+    if (nfilters < 0)
+        return false;
+
+    for (int i = 0; i < nfilters; ++i) {
+        Filter filter;
+        unsigned flags;
+        std::size_t cdNelmts = 0u;
+        filter.id = H5Pget_filter2(plistId, static_cast<unsigned>(i), &flags,
+                                   &cdNelmts, nullptr, 0u, nullptr, nullptr);
+        FilterBound bound;
+        FilterRun run;
+        if (filter.id < 0 || !filterKernel(filter.id, bound, run))
+            return false;
+
+        filter.cdValues.resize(cdNelmts);
+        if (cdNelmts > 0u
+            && H5Pget_filter_by_id2(plistId, filter.id, &flags, &cdNelmts,
+                                    filter.cdValues.data(), 0u, nullptr,
+                                    nullptr) < 0)
+            return false;
+
+        m_filters.push_back(std::move(filter));
+    }
+
+    return true;
+}
+
+bool TdbHdf5ChunkFilters::encode(std::vector<unsigned char> & chunk,
+                                 std::vector<unsigned char> & scratch) const
+{
+    for (Filter const & filter : m_filters)
+        if (!runKernel(filter.id, 0u, filter.cdValues, chunk, scratch))
+            return false;
+    return true;
+}
+
+bool TdbHdf5ChunkFilters::decode(std::vector<unsigned char> & chunk,
+                                 std::vector<unsigned char> & scratch,
+                                 const unsigned filterMask) const
+{
+    for (std::size_t i = m_filters.size(); i-- > 0u;) {
+        if (filterMask & (1u << i))
+            continue;
+        Filter const & filter = m_filters[i];
+        if (!runKernel(filter.id, H5Z_FLAG_REVERSE, filter.cdValues, chunk,
+                       scratch))
+            return false;
+    }
+    return true;
+}
+
+bool isBitPackable(const void * const data, const std::size_t size) {
+    const std::uint8_t * const bytes = static_cast<const std::uint8_t *>(data);
+
+    std::size_t i = 0u;
+    for (; i + 8u <= size; i += 8u) {
+        std::uint64_t x;
+        std::memcpy(&x, bytes + i, sizeof(x));
+        if (x & NOT_BITS)
+            return false;
+    }
+
+    for (; i < size; ++i)
+        if (bytes[i] > 1u)
+            return false;
+
+    return true;
+}
+
+} /* namespace sharemind { */
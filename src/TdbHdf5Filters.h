@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5FILTERS_H
+#define SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5FILTERS_H
+
+#include <cstddef>
+#include <H5Ipublic.h>
+#include <H5Zpublic.h>
+#include <vector>
+
+
+namespace sharemind {
+
+/*
+  HDF5 filters encoding the chunks of the table datasets. The identifiers are
+  from the range HDF5 leaves for filters not registered with The HDF Group, so
+  files using them can only be read with the filters registered.
+*/
+
+/* Packs the bytes of 1-bit types, each 0 or 1, into bits: */
+constexpr H5Z_filter_t TDB_HDF5_FILTER_BITPACK = H5Z_FILTER_RESERVED + 64;
+
+/* Encodes the fixed size integer-like values of public types: */
+constexpr H5Z_filter_t TDB_HDF5_FILTER_ENCODING = H5Z_FILTER_RESERVED + 65;
+
+/* Encodings of the chunks of the encoding filter. These are stored in the
+   files, so the values must not change: */
+enum class TdbHdf5Encoding : unsigned {
+    /* The values as they are: */
+    Raw = 0u,
+    /* The sorted distinct values and bit packed indexes into them: */
+    Dictionary = 1u,
+    /* The first value and the bit packed differences of the values: */
+    Delta = 2u,
+    /* The smallest value and the bit packed offsets from it: */
+    FrameOfReference = 3u,
+    /* Whichever of the above is the smallest for the chunk: */
+    Auto = 4u
+};
+
+/* The filter pipeline of a dataset, for the chunks read and written directly
+   instead of through the pipeline of HDF5: */
+class __attribute__ ((visibility("internal"))) TdbHdf5ChunkFilters {
+
+public: /* Methods: */
+
+    /* Reads the pipeline of a dataset creation property list, fails if it
+       has filters other than those of this module: */
+    bool load(const hid_t plistId);
+
+    bool empty() const noexcept { return m_filters.empty(); }
+
+    /* Filter a chunk as HDF5 would on writing and on reading it, skipping
+       the filters in the mask of the chunk on reading. These do not call
+       HDF5, so chunks can be filtered on several threads at once: */
+    bool encode(std::vector<unsigned char> & chunk,
+                std::vector<unsigned char> & scratch) const;
+    bool decode(std::vector<unsigned char> & chunk,
+                std::vector<unsigned char> & scratch,
+                const unsigned filterMask) const;
+
+private: /* Types: */
+
+    struct Filter {
+        H5Z_filter_t id;
+        std::vector<unsigned> cdValues;
+    };
+
+private: /* Fields: */
+
+    std::vector<Filter> m_filters;
+
+}; /* class TdbHdf5ChunkFilters { */
+
+/* Registers the filters with the HDF5 library, may be called repeatedly: */
+bool registerTdbHdf5Filters() __attribute__ ((visibility("internal")));
+
+/* Adds the encoding filter for values of the given size, which is 1, 2, 4 or
+   8 bytes, to a dataset creation property list: */
+bool setEncodingFilter(const hid_t plistId,
+                       const TdbHdf5Encoding encoding,
+                       const std::size_t valueSize,
+                       const bool isSigned)
+        __attribute__ ((visibility("internal")));
+
+/* Whether the bytes can be packed into bits: */
+bool isBitPackable(const void * const data, const std::size_t size)
+        __attribute__ ((visibility("internal")));
+
+} /* namespace sharemind { */
+
+#endif // SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5FILTERS_H
@@ -0,0 +1,648 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "TdbHdf5IoUringDriver.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <H5FDpublic.h>
+#include <H5Ppublic.h>
+#include <H5public.h>
+#include <limits>
+#include <memory>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+#if H5_VERSION_GE(1,13,0)
+#include <H5FDdevelop.h>
+#endif
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING
+#endif
+#endif
+
+
+#define IO_URING_DIRECT_ALIGN  (static_cast<size_t>(4096u))
+#define IO_URING_DIRECT_MIN    (static_cast<size_t>(1048576u))
+#define IO_URING_DRIVER_NAME   "sharemind_io_uring"
+#define IO_URING_QUEUE_DEPTH   (32u)
+#define IO_URING_SEGMENT_SIZE  (static_cast<size_t>(1048576u))
+
+#ifdef HAVE_IO_URING
+namespace {
+
+/* A single issuer ring, driven with the raw system calls: */
+class Ring {
+
+public: /* Types: */
+
+    struct Segment {
+        char * buffer;
+        size_t size;
+        off_t offset;
+    };
+
+public: /* Methods: */
+
+    Ring() noexcept {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        m_fd = static_cast<int>(::syscall(__NR_io_uring_setup,
+                                          IO_URING_QUEUE_DEPTH,
+                                          &params));
+        if (m_fd < 0)
+            return;
+
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        #ifdef IORING_FEAT_SINGLE_MMAP
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        #else
+        const bool singleMap = false;
+        #endif
+        if (singleMap)
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+        m_sqRing = map(m_sqRingSize, IORING_OFF_SQ_RING);
+        m_cqRing = singleMap ? m_sqRing : map(m_cqRingSize, IORING_OFF_CQ_RING);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe *>(map(m_sqesSize, IORING_OFF_SQES));
+        if (!m_sqRing || !m_cqRing || !m_sqes) {
+            release();
+            return;
+        }
+
+        char * const sq = static_cast<char *>(m_sqRing);
+        char * const cq = static_cast<char *>(m_cqRing);
+        m_entries = params.sq_entries;
+        m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    }
+
+    Ring(const Ring &) = delete;
+    Ring & operator=(const Ring &) = delete;
+    ~Ring() noexcept { release(); }
+
+    bool usable() const noexcept { return m_fd >= 0; }
+
+    /* Reads or writes the segments, returning the number of bytes done for
+       each of them in their sizes. Returns false if any of them failed, or if
+       the ring itself did, after which it is not used again: */
+    bool run(const bool write, const int fd, std::vector<Segment> & segments) {
+        std::vector<iovec> iovecs(std::min(segments.size(), size_t(m_entries)));
+        bool ok = true;
+
+        for (size_t first = 0u; first < segments.size(); first += m_entries) {
+            const unsigned count = static_cast<unsigned>(
+                        std::min(segments.size() - first, size_t(m_entries)));
+
+            unsigned tail = *m_sqTail;
+            for (unsigned i = 0u; i < count; ++i, ++tail) {
+                const Segment & segment = segments[first + i];
+                iovecs[i].iov_base = segment.buffer;
+                iovecs[i].iov_len = segment.size;
+
+                const unsigned index = tail & m_sqMask;
+                io_uring_sqe & sqe = m_sqes[index];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+                sqe.fd = fd;
+                sqe.off = static_cast<uint64_t>(segment.offset);
+                sqe.addr = reinterpret_cast<uint64_t>(&iovecs[i]);
+                sqe.len = 1u;
+                sqe.user_data = first + i;
+                m_sqArray[index] = index;
+            }
+            __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+            // Submit and wait for the completions, the buffers are in use
+            // until all of the submitted segments have completed
+            unsigned submitted = 0u;
+            unsigned completed = 0u;
+            bool broken = false;
+            while (completed < count) {
+                const unsigned toSubmit = broken ? 0u : count - submitted;
+                const long r = ::syscall(__NR_io_uring_enter,
+                                         m_fd,
+                                         toSubmit,
+                                         1u,
+                                         IORING_ENTER_GETEVENTS,
+                                         nullptr,
+                                         0u);
+                if (r < 0) {
+                    if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                        continue;
+                    broken = true;
+                } else {
+                    submitted += static_cast<unsigned>(r);
+                }
+
+                unsigned head = *m_cqHead;
+                const unsigned cqTail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+                for (; head != cqTail; ++head, ++completed) {
+                    const io_uring_cqe & cqe = m_cqes[head & m_cqMask];
+                    Segment & segment = segments[cqe.user_data];
+                    if (cqe.res < 0) {
+                        errno = -cqe.res;
+                        segment.size = 0u;
+                        ok = false;
+                    } else {
+                        segment.size = static_cast<size_t>(cqe.res);
+                    }
+                }
+                __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+                // The segments not submitted are dropped with the ring
+                if (broken && submitted == completed) {
+                    release();
+                    return false;
+                }
+            }
+        }
+
+        return ok;
+    }
+
+private: /* Methods: */
+
+    void * map(const size_t size, const off_t offset) noexcept {
+        void * const p = ::mmap(nullptr,
+                                size,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE,
+                                m_fd,
+                                offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    void release() noexcept {
+        if (m_sqes)
+            ::munmap(m_sqes, m_sqesSize);
+        if (m_cqRing && m_cqRing != m_sqRing)
+            ::munmap(m_cqRing, m_cqRingSize);
+        if (m_sqRing)
+            ::munmap(m_sqRing, m_sqRingSize);
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_sqes = nullptr;
+        m_cqRing = m_sqRing = nullptr;
+        m_fd = -1;
+    }
+
+private: /* Fields: */
+
+    int m_fd = -1;
+    unsigned m_entries = 0u;
+    void * m_sqRing = nullptr;
+    void * m_cqRing = nullptr;
+    size_t m_sqRingSize = 0u;
+    size_t m_cqRingSize = 0u;
+    io_uring_sqe * m_sqes = nullptr;
+    size_t m_sqesSize = 0u;
+    unsigned * m_sqTail = nullptr;
+    unsigned m_sqMask = 0u;
+    unsigned * m_sqArray = nullptr;
+    unsigned * m_cqHead = nullptr;
+    unsigned * m_cqTail = nullptr;
+    unsigned m_cqMask = 0u;
+    io_uring_cqe * m_cqes = nullptr;
+
+}; /* class Ring { */
+
+/* The ring of the calling thread, HDF5 does the I/O of a file on the thread
+   calling into the library: */
+Ring & threadRing() {
+    thread_local Ring ring;
+    return ring;
+}
+
+struct IoUringFapl {
+    hbool_t directIo;
+};
+
+struct IoUringFile {
+    H5FD_t pub; /* Must be the first member. */
+    int fd;
+    int directFd;
+    haddr_t eoa;
+    haddr_t eof;
+    dev_t device;
+    ino_t inode;
+    void * bounce;
+    size_t bounceSize;
+};
+
+hid_t ioUringDriverId = H5I_INVALID_HID;
+
+/* Reads or writes a whole range, zero filling the part of a read past the end
+   of the file: */
+bool transfer(const bool write,
+              const int fd,
+              char * buffer,
+              size_t size,
+              off_t offset,
+              const bool direct = false)
+{
+    Ring & ring = threadRing();
+    while (size > 0u) {
+        if (!ring.usable()) {
+            const ssize_t r = write
+                              ? ::pwrite(fd, buffer, size, offset)
+                              : ::pread(fd, buffer, size, offset);
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            if (r == 0) {
+                if (write)
+                    return false;
+                std::memset(buffer, 0, size);
+                return true;
+            }
+            buffer += r;
+            size -= static_cast<size_t>(r);
+            offset += r;
+            continue;
+        }
+
+        std::vector<Ring::Segment> segments;
+        for (size_t done = 0u; done < size; done += IO_URING_SEGMENT_SIZE)
+            segments.push_back(Ring::Segment{
+                                   buffer + done,
+                                   std::min(IO_URING_SEGMENT_SIZE, size - done),
+                                   offset + static_cast<off_t>(done)});
+        std::vector<size_t> sizes;
+        for (const Ring::Segment & segment : segments)
+            sizes.push_back(segment.size);
+
+        if (!ring.run(write, fd, segments)) {
+            if (ring.usable())
+                return false;
+            continue; // Redo the range without the ring
+        }
+
+        // Continue from the first segment cut short
+        size_t done = 0u;
+        for (size_t i = 0u; i < segments.size(); ++i) {
+            done += segments[i].size;
+            if (segments[i].size < sizes[i])
+                break;
+        }
+
+        if (done < size && !write) {
+            // Direct reads are only cut short at the end of the file, and
+            // so are the others unless interrupted
+            if (direct || segments.front().size == 0u) {
+                std::memset(buffer + done, 0, size - done);
+                return true;
+            }
+        }
+
+        if (done == 0u && write)
+            return false;
+
+        buffer += done;
+        size -= done;
+        offset += static_cast<off_t>(done);
+    }
+    return true;
+}
+
+herr_t ioUringClose(H5FD_t * const file);
+
+void * ioUringFaplCopy(const void * const fapl) {
+    void * const copy = std::malloc(sizeof(IoUringFapl));
+    if (copy)
+        std::memcpy(copy, fapl, sizeof(IoUringFapl));
+    return copy;
+}
+
+herr_t ioUringFaplFree(void * const fapl) {
+    std::free(fapl);
+    return 0;
+}
+
+void * ioUringFaplGet(H5FD_t * const file) {
+    const IoUringFile * const f = reinterpret_cast<IoUringFile *>(file);
+    const IoUringFapl fapl{f->directFd >= 0};
+    return ioUringFaplCopy(&fapl);
+}
+
+H5FD_t * ioUringOpen(const char * const name,
+                     const unsigned flags,
+                     const hid_t faplId,
+                     const haddr_t maxaddr)
+{
+    if (!name || !*name || maxaddr == 0u || maxaddr == HADDR_UNDEF)
+        return nullptr;
+
+    const IoUringFapl * const fapl =
+            static_cast<const IoUringFapl *>(H5Pget_driver_info(faplId));
+
+    int oflags = (flags & H5F_ACC_RDWR) ? O_RDWR : O_RDONLY;
+    if (flags & H5F_ACC_TRUNC)
+        oflags |= O_TRUNC;
+    if (flags & H5F_ACC_CREAT)
+        oflags |= O_CREAT;
+    if (flags & H5F_ACC_EXCL)
+        oflags |= O_EXCL;
+
+    const int fd = ::open(name, oflags | O_CLOEXEC, 0666);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    IoUringFile * const file =
+            static_cast<IoUringFile *>(std::calloc(1u, sizeof(IoUringFile)));
+    if (!file) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    file->fd = fd;
+    file->directFd = -1;
+    file->eof = static_cast<haddr_t>(st.st_size);
+    file->device = st.st_dev;
+    file->inode = st.st_ino;
+
+    // Not all file systems support direct I/O, do without it on those
+    if (fapl && fapl->directIo)
+        file->directFd = ::open(name, O_RDONLY | O_DIRECT | O_CLOEXEC);
+
+    return &file->pub;
+}
+
+herr_t ioUringClose(H5FD_t * const file) {
+    IoUringFile * const f = reinterpret_cast<IoUringFile *>(file);
+    herr_t r = 0;
+    if (f->directFd >= 0)
+        ::close(f->directFd);
+    if (::close(f->fd) != 0)
+        r = -1;
+    std::free(f->bounce);
+    std::free(f);
+    return r;
+}
+
+int ioUringCmp(const H5FD_t * const file1, const H5FD_t * const file2) {
+    const IoUringFile * const f1 = reinterpret_cast<const IoUringFile *>(file1);
+    const IoUringFile * const f2 = reinterpret_cast<const IoUringFile *>(file2);
+    if (f1->device != f2->device)
+        return f1->device < f2->device ? -1 : 1;
+    if (f1->inode != f2->inode)
+        return f1->inode < f2->inode ? -1 : 1;
+    return 0;
+}
+
+herr_t ioUringQuery(const H5FD_t *, unsigned long * const flags) {
+    if (flags) {
+        *flags = H5FD_FEAT_AGGREGATE_METADATA
+                 | H5FD_FEAT_ACCUMULATE_METADATA
+                 | H5FD_FEAT_DATA_SIEVE
+                 | H5FD_FEAT_AGGREGATE_SMALLDATA
+                 | H5FD_FEAT_POSIX_COMPAT_HANDLE
+                 | H5FD_FEAT_SUPPORTS_SWMR_IO
+                 #ifdef H5FD_FEAT_DEFAULT_VFD_COMPATIBLE
+                 | H5FD_FEAT_DEFAULT_VFD_COMPATIBLE
+                 #endif
+                 ;
+    }
+    return 0;
+}
+
+haddr_t ioUringGetEoa(const H5FD_t * const file, H5FD_mem_t)
+{ return reinterpret_cast<const IoUringFile *>(file)->eoa; }
+
+herr_t ioUringSetEoa(H5FD_t * const file, H5FD_mem_t, const haddr_t addr) {
+    reinterpret_cast<IoUringFile *>(file)->eoa = addr;
+    return 0;
+}
+
+haddr_t ioUringGetEof(const H5FD_t * const file, H5FD_mem_t)
+{ return reinterpret_cast<const IoUringFile *>(file)->eof; }
+
+herr_t ioUringGetHandle(H5FD_t * const file, hid_t, void ** const handle) {
+    if (!handle)
+        return -1;
+    *handle = &reinterpret_cast<IoUringFile *>(file)->fd;
+    return 0;
+}
+
+bool validRange(const haddr_t addr, const size_t size) noexcept {
+    constexpr haddr_t maxAddr =
+            static_cast<haddr_t>(std::numeric_limits<off_t>::max());
+    return addr != HADDR_UNDEF && addr <= maxAddr && size <= maxAddr - addr;
+}
+
+herr_t ioUringRead(H5FD_t * const file,
+                   H5FD_mem_t,
+                   hid_t,
+                   const haddr_t addr,
+                   const size_t size,
+                   void * const buffer)
+{
+    IoUringFile * const f = reinterpret_cast<IoUringFile *>(file);
+    if (!validRange(addr, size))
+        return -1;
+
+    // Large reads bypass the page cache through an aligned buffer
+    if (f->directFd >= 0 && size >= IO_URING_DIRECT_MIN) {
+        const haddr_t start = addr - addr % IO_URING_DIRECT_ALIGN;
+        const haddr_t end = addr + size;
+        const size_t alignedSize = static_cast<size_t>(
+                    (end - start + IO_URING_DIRECT_ALIGN - 1u)
+                    / IO_URING_DIRECT_ALIGN * IO_URING_DIRECT_ALIGN);
+
+        if (f->bounceSize < alignedSize) {
+            std::free(f->bounce);
+            f->bounce = nullptr;
+            f->bounceSize = 0u;
+            if (::posix_memalign(&f->bounce, IO_URING_DIRECT_ALIGN, alignedSize) == 0)
+                f->bounceSize = alignedSize;
+        }
+
+        if (f->bounce
+            && transfer(false,
+                        f->directFd,
+                        static_cast<char *>(f->bounce),
+                        alignedSize,
+                        static_cast<off_t>(start),
+                        true))
+        {
+            std::memcpy(buffer,
+                        static_cast<char *>(f->bounce) + (addr - start),
+                        size);
+            return 0;
+        }
+    }
+
+    return transfer(false, f->fd, static_cast<char *>(buffer), size,
+                    static_cast<off_t>(addr))
+           ? 0 : -1;
+}
+
+herr_t ioUringWrite(H5FD_t * const file,
+                    H5FD_mem_t,
+                    hid_t,
+                    const haddr_t addr,
+                    const size_t size,
+                    const void * const buffer)
+{
+    IoUringFile * const f = reinterpret_cast<IoUringFile *>(file);
+    if (!validRange(addr, size))
+        return -1;
+
+    if (!transfer(true, f->fd,
+                  static_cast<char *>(const_cast<void *>(buffer)), size,
+                  static_cast<off_t>(addr)))
+        return -1;
+
+    f->eof = std::max(f->eof, addr + size);
+    return 0;
+}
+
+herr_t ioUringTruncate(H5FD_t * const file, hid_t, hbool_t) {
+    IoUringFile * const f = reinterpret_cast<IoUringFile *>(file);
+    if (f->eoa == f->eof)
+        return 0;
+
+    if (::ftruncate(f->fd, static_cast<off_t>(f->eoa)) != 0)
+        return -1;
+
+    f->eof = f->eoa;
+    return 0;
+}
+
+herr_t ioUringLock(H5FD_t * const file, const hbool_t rw) {
+    IoUringFile * const f = reinterpret_cast<IoUringFile *>(file);
+    if (::flock(f->fd, (rw ? LOCK_EX : LOCK_SH) | LOCK_NB) != 0)
+        return errno == ENOSYS ? 0 : -1;
+    return 0;
+}
+
+herr_t ioUringUnlock(H5FD_t * const file) {
+    IoUringFile * const f = reinterpret_cast<IoUringFile *>(file);
+    if (::flock(f->fd, LOCK_UN) != 0)
+        return errno == ENOSYS ? 0 : -1;
+    return 0;
+}
+
+/* Fills in the driver class by member, as its layout differs between the
+   versions of HDF5: */
+H5FD_class_t makeIoUringClass() {
+    H5FD_class_t cls;
+    std::memset(&cls, 0, sizeof(cls));
+    #if H5_VERSION_GE(1,13,2)
+    cls.version = H5FD_CLASS_VERSION;
+    // From the range HDF5 leaves for drivers not registered with it
+    cls.value = static_cast<H5FD_class_value_t>(400);
+    #endif
+    cls.name = IO_URING_DRIVER_NAME;
+    cls.maxaddr = static_cast<haddr_t>(std::numeric_limits<off_t>::max());
+    cls.fc_degree = H5F_CLOSE_WEAK;
+    cls.fapl_size = sizeof(IoUringFapl);
+    cls.fapl_get = ioUringFaplGet;
+    cls.fapl_copy = ioUringFaplCopy;
+    cls.fapl_free = ioUringFaplFree;
+    cls.open = ioUringOpen;
+    cls.close = ioUringClose;
+    cls.cmp = ioUringCmp;
+    cls.query = ioUringQuery;
+    cls.get_eoa = ioUringGetEoa;
+    cls.set_eoa = ioUringSetEoa;
+    cls.get_eof = ioUringGetEof;
+    cls.get_handle = ioUringGetHandle;
+    cls.read = ioUringRead;
+    cls.write = ioUringWrite;
+    cls.truncate = ioUringTruncate;
+    cls.lock = ioUringLock;
+    cls.unlock = ioUringUnlock;
+
+    const H5FD_mem_t flMap[] = H5FD_FLMAP_DICHOTOMY;
+    std::copy(std::begin(flMap), std::end(flMap), cls.fl_map);
+    return cls;
+}
+
+hid_t registerIoUringDriver() {
+    if (ioUringDriverId >= 0 && H5Iis_valid(ioUringDriverId) > 0)
+        return ioUringDriverId;
+
+    static const H5FD_class_t cls(makeIoUringClass());
+    ioUringDriverId = H5FDregister(&cls);
+    return ioUringDriverId;
+}
+
+} // anonymous namespace
+#endif
+
+namespace sharemind {
+
+bool ioUringAvailable() {
+    #ifdef HAVE_IO_URING
+    return threadRing().usable();
+    #else
+    return false;
+    #endif
+}
+
+bool setIoUringFileDriver(const hid_t faplId, const bool directIo) {
+    #ifdef HAVE_IO_URING
+    const hid_t driverId = registerIoUringDriver();
+    if (driverId < 0)
+        return false;
+
+    const IoUringFapl fapl{directIo};
+    return H5Pset_driver(faplId, driverId, &fapl) >= 0;
+    #else
+    (void) faplId; (void) directIo;
+    return false;
+    #endif
+}
+
+bool isIoUringFileDriver(const hid_t faplId) {
+    #ifdef HAVE_IO_URING
+    return ioUringDriverId >= 0 && H5Pget_driver(faplId) == ioUringDriverId;
+    #else
+    (void) faplId;
+    return false;
+    #endif
+}
+
+} /* namespace sharemind { */
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5IOURINGDRIVER_H
+#define SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5IOURINGDRIVER_H
+
+#include <H5Ipublic.h>
+
+
+namespace sharemind {
+
+/*
+  An HDF5 file driver doing the I/O of the table files through io_uring. The
+  files are the same as those of the default sec2 driver. Large requests are
+  split into segments submitted together, and with direct I/O the large reads
+  bypass the page cache through aligned buffers. I/O falls back to pread and
+  pwrite on threads where a ring can not be set up.
+*/
+
+/* Whether the kernel lets the process set up io_uring rings: */
+bool ioUringAvailable() __attribute__ ((visibility("internal")));
+
+/* Sets the driver on a file access property list: */
+bool setIoUringFileDriver(const hid_t faplId, const bool directIo)
+        __attribute__ ((visibility("internal")));
+
+/* Whether a file access property list has the driver set: */
+bool isIoUringFileDriver(const hid_t faplId)
+        __attribute__ ((visibility("internal")));
+
+} /* namespace sharemind { */
+
+#endif // SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5IOURINGDRIVER_H
@@ -28,47 +28,68 @@ namespace fs = boost::filesystem;
 
 namespace sharemind {
 
-TdbHdf5Manager::TdbHdf5Manager(LogHard::Logger logger)
+TdbHdf5Manager::TdbHdf5Manager(LogHard::Logger logger,
+                               std::size_t const maxRetainedConnections)
     : m_previousLogger(std::move(logger))
     , m_logger(m_previousLogger, "[TdbHdf5Manager]")
+    , m_connectionCache(maxRetainedConnections)
 {}
 
 TdbHdf5Manager::TdbHdf5Manager(TdbHdf5Manager &&) noexcept = default;
 
 TdbHdf5Manager::~TdbHdf5Manager() noexcept = default;
 
+bool TdbHdf5Manager::ensureDirectory(fs::path const & path,
+                                     char const * const what)
+{
+    // Check if path exists
+    if (fs::exists(path)) {
+        // Check if the given path is a directory:
+        if (!fs::is_directory(path)) {
+            m_logger.error() << what << ' ' << path.string()
+                << " exists, but is not a directory!";
+            return false;
+        }
+    } else {
+        // Create the path
+        m_logger.fullDebug()
+                << what << " does not exist. Creating path "
+                << path.string() << '.';
+
+        if (!fs::create_directories(path)) {
+            m_logger.error()
+                    << "Failed to create path " << path.string() << '.';
+            return false;
+        }
+    }
+
+    return true;
+}
+
 std::shared_ptr<TdbHdf5Connection> TdbHdf5Manager::openConnection(
         TdbHdf5ConnectionConf const & config)
 {
     try {
         fs::path dbPath(config.databasePath());
 
-        // Check if path exists
-        if (fs::exists(dbPath)) {
-            // Check if the given path is a directory:
-            if (!fs::is_directory(dbPath)) {
-                m_logger.error() << "Database path " << dbPath.string()
-                    << " exists, but is not a directory!";
-                return std::shared_ptr<TdbHdf5Connection>();
-            }
-        } else {
-            // Create the path to the data source
-            m_logger.fullDebug()
-                    << "Database path does not exist. Creating path "
-                    << dbPath.string() << '.';
-
-            if (!fs::create_directories(dbPath)) {
-                m_logger.error()
-                        << "Failed to create path " << dbPath.string() << '.';
+        if (!ensureDirectory(dbPath, "Database path"))
+            return std::shared_ptr<TdbHdf5Connection>();
+
+        // The additional storage paths must exist as well
+        for (auto const & storagePath : config.storagePaths()) {
+            if (!ensureDirectory(storagePath, "Storage path"))
                 return std::shared_ptr<TdbHdf5Connection>();
-            }
         }
 
         // Return the connection object from the cache or construct a new one
         return m_connectionCache.get(
                     fs::canonical(std::move(dbPath)),
-                    [this](boost::filesystem::path const & key)
-                    { return new TdbHdf5Connection(m_previousLogger, key); });
+                    [this, &config](boost::filesystem::path const & key) {
+                        return new TdbHdf5Connection(m_previousLogger,
+                                                     key,
+                                                     config);
+                    },
+                    config.keepAliveTimeout());
     } catch (fs::filesystem_error const &) {
         {
             auto const logLock(m_logger.retrieveBackendLock());
@@ -21,6 +21,7 @@
 #define SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5MANAGER_H
 
 #include <boost/filesystem/path.hpp>
+#include <cstddef>
 #include <LogHard/Logger.h>
 #include <memory>
 #include "KeyValueCache.h"
@@ -35,7 +36,8 @@ class __attribute__ ((visibility("internal"))) TdbHdf5Manager {
 
 public: /* Methods: */
 
-    TdbHdf5Manager(LogHard::Logger logger);
+    TdbHdf5Manager(LogHard::Logger logger,
+                   std::size_t const maxRetainedConnections);
 
     TdbHdf5Manager(TdbHdf5Manager &&) noexcept;
     TdbHdf5Manager(TdbHdf5Manager const &) = delete;
@@ -48,6 +50,11 @@ public: /* Methods: */
     std::shared_ptr<TdbHdf5Connection> openConnection(
                 TdbHdf5ConnectionConf const & config);
 
+private: /* Methods: */
+
+    bool ensureDirectory(boost::filesystem::path const & path,
+                         char const * const what);
+
 private: /* Fields: */
 
     LogHard::Logger const m_previousLogger;
@@ -19,9 +19,12 @@
 
 #include "TdbHdf5Module.h"
 
+#include <boost/scope_exit.hpp>
 #include <cstring>
+#include <utility>
 #include "TdbHdf5ConnectionConf.h"
 #include "TdbHdf5Manager.h"
+#include "TdbHdf5ModuleConf.h"
 
 
 namespace {
@@ -35,6 +38,27 @@ namespace sharemind {
 
 namespace {
 
+/* Connection of a process, dropping the temporary tables of the process when
+   the process closes the connection or exits: */
+struct ProcessConnection {
+
+    ProcessConnection(std::shared_ptr<TdbHdf5Connection> connection_,
+                      const void * const owner_)
+        : connection(std::move(connection_))
+        , owner(owner_)
+    {}
+
+    ~ProcessConnection() noexcept {
+        try {
+            connection->dropTemporaryTables(owner);
+        } catch (...) {}
+    }
+
+    std::shared_ptr<TdbHdf5Connection> connection;
+    /* Process data store of the connection, identifying the process: */
+    const void * const owner;
+};
+
 struct TransactionData {
 
     TransactionData(TdbHdf5Transaction & strategy_)
@@ -105,10 +129,15 @@ void commit(const SharemindConsensusDatum * proposals,
             *static_cast<TransactionData *>(callbackPtr);
     transaction.globalResult = err;
 
-    // If the operation succeeded locally but not on all miners
-    if (transaction.localResult == SHAREMIND_TDB_OK
-            && transaction.globalResult != SHAREMIND_TDB_OK)
-        transaction.strategy.rollback();
+    // If the operation succeeded locally, keep its changes only if it
+    // succeeded on all miners
+    if (transaction.localResult == SHAREMIND_TDB_OK) {
+        if (transaction.globalResult == SHAREMIND_TDB_OK) {
+            transaction.strategy.commit();
+        } else {
+            transaction.strategy.rollback();
+        }
+    }
 }
 
 SharemindOperationType const databaseOperation = {
@@ -151,15 +180,32 @@ SharemindDataStore * getVectorMaps(
 
 } /* namespace { */
 
+SharemindTdbError TdbHdf5Transaction::execute() {
+    m_connection.setUndoRecord(&m_undo);
+    BOOST_SCOPE_EXIT_ALL(this) {
+        m_connection.setUndoRecord(nullptr);
+    };
+    return m_exec();
+}
+
+void TdbHdf5Transaction::commit() {
+    m_connection.commit(m_undo);
+}
+
+void TdbHdf5Transaction::rollback() {
+    m_connection.rollback(m_undo);
+}
+
 TdbHdf5Module::TdbHdf5Module(const LogHard::Logger & logger,
                              SharemindDataSourceManager & dataSourceManager,
                              SharemindTdbVectorMapUtil & mapUtil,
-                             SharemindConsensusFacility * consensusService)
+                             SharemindConsensusFacility * consensusService,
+                             const TdbHdf5ModuleConf & conf)
     : m_logger(logger, "[TdbHdf5Module]")
     , m_dataSourceManager(dataSourceManager)
     , m_mapUtil(mapUtil)
     , m_consensusService(consensusService)
-    , m_dbManager(logger)
+    , m_dbManager(logger, conf.maxRetainedConnections())
 {
     if (m_consensusService)
         m_consensusService->add_operation_type(m_consensusService, &databaseOperation);
@@ -202,58 +248,28 @@ bool TdbHdf5Module::openConnection(const SharemindModuleApi0x1SyscallContext * c
     }
 
     // Check if we already have the connection
-    if (static_cast<std::shared_ptr<TdbHdf5Connection> *>(
+    if (static_cast<ProcessConnection *>(
                 connections->get(connections, dsName.c_str())))
     {
         return true;
     }
 
-    TdbHdf5ConnectionConf * cfg = nullptr;
-
-    {
-        std::lock_guard<std::mutex> lock(m_dsConfMutex);
-
-        // Get configuration from file or load a cached configuration
-        auto const it(m_dsConf.find(dsName));
-        if (it == m_dsConf.cend()) {
-            SharemindDataSource * src = m_dataSourceManager.get_source(&m_dataSourceManager, dsName.c_str());
-            if (!src) {
-                m_logger.error() << "Failed to get configuration for data source \"" << dsName << "\".";
-                return false;
-            }
-
-            std::unique_ptr<TdbHdf5ConnectionConf> configuration;
-            try {
-                configuration = std::make_unique<TdbHdf5ConnectionConf>(
-                                    src->conf(src));
-            } catch (...) {
-                auto const loggerLock(m_logger.retrieveBackendLock());
-                m_logger.error()
-                        << "Failed to parse configuration for data source \""
-                        << dsName << "\":";
-                m_logger.printCurrentException();
-                return false;
-            }
-
-            cfg = configuration.get();
-            auto const rv(m_dsConf.emplace(dsName, std::move(configuration)));
-            assert(rv.second);
-        } else {
-            cfg = it->second.get();
-        }
-    }
+    TdbHdf5ConnectionConf * const cfg = getConfiguration(dsName);
+    if (!cfg)
+        return false;
 
     // Open the connection
     std::shared_ptr<TdbHdf5Connection> conn = m_dbManager.openConnection(*cfg);
     if (!conn.get())
         return false;
 
-    // Store the connection
-    std::shared_ptr<TdbHdf5Connection> * connPtr = new std::shared_ptr<TdbHdf5Connection>(conn);
+    // Store the connection, the temporary tables of the process are kept
+    // apart from the ones of the other processes sharing it
+    ProcessConnection * connPtr = new ProcessConnection(conn, connections);
     if (!connections->set(connections,
                           dsName.c_str(),
                           connPtr,
-                          &destroy<std::shared_ptr<TdbHdf5Connection> >))
+                          &destroy<ProcessConnection>))
     {
         delete connPtr;
         return false;
@@ -262,6 +278,41 @@ bool TdbHdf5Module::openConnection(const SharemindModuleApi0x1SyscallContext * c
     return true;
 }
 
+bool TdbHdf5Module::warmUp(const TdbHdf5ModuleConf & conf) {
+    // HDF5 is not thread-safe, so the data sources are warmed up one by one
+    bool success = true;
+    for (auto const & dsName : conf.warmUpDataSources()) {
+        TdbHdf5ConnectionConf * const cfg = getConfiguration(dsName);
+        if (!cfg) {
+            success = false;
+            continue;
+        }
+
+        std::shared_ptr<TdbHdf5Connection> conn;
+        try {
+            conn = m_dbManager.openConnection(*cfg);
+        } catch (...) {
+            auto const loggerLock(m_logger.retrieveBackendLock());
+            m_logger.error() << "Failed to open data source \"" << dsName
+                             << "\" for warm-up:";
+            m_logger.printCurrentException();
+        }
+
+        if (!conn) {
+            success = false;
+            continue;
+        }
+
+        conn->warmUp(cfg->warmUpTables(), cfg->warmUpRecentTables());
+
+        // Keep the connection and its open table files for the lifetime of
+        // the module
+        m_warmConnections.emplace_back(std::move(conn));
+    }
+
+    return success;
+}
+
 bool TdbHdf5Module::closeConnection(const SharemindModuleApi0x1SyscallContext * ctx,
                                     const std::string & dsName)
 {
@@ -272,14 +323,28 @@ bool TdbHdf5Module::closeConnection(const SharemindModuleApi0x1SyscallContext *
         return false;
     }
 
-    // Remove the connection
+    // Report the table file cache of the connection the process lets go of
+    if (auto const * const conn =
+            static_cast<ProcessConnection *>(
+                connections->get(connections, dsName.c_str())))
+    {
+        const TdbHdf5Connection::TableFileCacheStats stats(
+                conn->connection->tableFileCacheStats());
+        m_logger.fullDebug() << "Table file cache of data source \"" << dsName
+                             << "\": " << stats.hits << " hits, "
+                             << stats.misses << " misses, " << stats.evictions
+                             << " evictions, " << stats.openFiles << " open.";
+    }
+
+    // Remove the connection, dropping the temporary tables of the process
     connections->remove(connections, dsName.c_str());
 
     return true;
 }
 
 TdbHdf5Connection * TdbHdf5Module::getConnection(const SharemindModuleApi0x1SyscallContext * ctx,
-                                                 const std::string & dsName) const
+                                                 const std::string & dsName,
+                                                 const void * & owner) const
 {
     // Get connection store
     SharemindDataStore * const connections = getConnections(ctx, m_logger);
@@ -289,14 +354,52 @@ TdbHdf5Connection * TdbHdf5Module::getConnection(const SharemindModuleApi0x1Sysc
     }
 
     // Return the connection object
-    std::shared_ptr<TdbHdf5Connection> * const conn =
-        static_cast<std::shared_ptr<TdbHdf5Connection> *>(connections->get(connections, dsName.c_str()));
+    ProcessConnection * const conn =
+        static_cast<ProcessConnection *>(connections->get(connections, dsName.c_str()));
     if (!conn) {
         m_logger.error() << "No open connection for data source \"" << dsName << "\".";
         return nullptr;
     }
 
-    return conn->get();
+    // Show the process its own temporary tables only
+    owner = conn->owner;
+
+    return conn->connection.get();
+}
+
+TdbHdf5ConnectionConf * TdbHdf5Module::getConfiguration(
+        const std::string & dsName)
+{
+    std::lock_guard<std::mutex> lock(m_dsConfMutex);
+
+    // Get configuration from file or load a cached configuration
+    auto const it(m_dsConf.find(dsName));
+    if (it != m_dsConf.cend())
+        return it->second.get();
+
+    SharemindDataSource * src = m_dataSourceManager.get_source(&m_dataSourceManager, dsName.c_str());
+    if (!src) {
+        m_logger.error() << "Failed to get configuration for data source \"" << dsName << "\".";
+        return nullptr;
+    }
+
+    std::unique_ptr<TdbHdf5ConnectionConf> configuration;
+    try {
+        configuration = std::make_unique<TdbHdf5ConnectionConf>(
+                            src->conf(src));
+    } catch (...) {
+        auto const loggerLock(m_logger.retrieveBackendLock());
+        m_logger.error()
+                << "Failed to parse configuration for data source \""
+                << dsName << "\":";
+        m_logger.printCurrentException();
+        return nullptr;
+    }
+
+    TdbHdf5ConnectionConf * const cfg = configuration.get();
+    auto const rv(m_dsConf.emplace(dsName, std::move(configuration)));
+    assert(rv.second);
+    return cfg;
 }
 
 SharemindTdbVectorMap * TdbHdf5Module::newVectorMap(const SharemindModuleApi0x1SyscallContext * ctx,
@@ -384,16 +487,24 @@ SharemindTdbError TdbHdf5Module::executeTransaction(
                                                     guidSize,
                                                     guidData,
                                                     &transaction);
-            if (ret == SHAREMIND_CONSENSUS_FACILITY_OK) {
+            if (ret == SHAREMIND_CONSENSUS_FACILITY_OK)
                 return transaction.globalResult;
-            } else if (ret == SHAREMIND_CONSENSUS_FACILITY_OUT_OF_MEMORY) {
+
+            // Do not leave behind changes we could not agree on
+            strategy.rollback();
+
+            if (ret == SHAREMIND_CONSENSUS_FACILITY_OUT_OF_MEMORY) {
                 throw std::bad_alloc();
             } else {
                 throw std::runtime_error("Unknown ConsensusService exception.");
             }
         }
     }
-    return strategy.execute();
+
+    const SharemindTdbError ecode = strategy.execute();
+    if (ecode == SHAREMIND_TDB_OK)
+        strategy.commit();
+    return ecode;
 }
 
 } // namespace sharemind {
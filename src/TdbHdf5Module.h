@@ -33,38 +33,43 @@
 #include <sharemind/mod_tabledb/tdbvectormapapi.h>
 #include <sharemind/module-apis/api_0x1.h>
 #include <string>
+#include <vector>
+#include "TdbHdf5Connection.h"
 #include "TdbHdf5ConnectionConf.h"
 #include "TdbHdf5Manager.h"
 
 
 namespace sharemind  {
 
-class TdbHdf5Connection;
+class TdbHdf5ModuleConf;
 
-class TdbHdf5Transaction {
+class __attribute__ ((visibility("internal"))) TdbHdf5Transaction {
 
 public: /* Methods: */
 
     template <typename F, typename ... Args>
     TdbHdf5Transaction(TdbHdf5Connection & connection,
+                       const void * const owner,
                        F&& exec,
                        Args && ... args)
-        : m_exec(std::bind(std::forward<F>(exec),
+        : m_connection(connection)
+        , m_exec(std::bind(std::forward<F>(exec),
                            std::ref(connection),
+                           owner,
                            std::forward<Args>(args) ...))
-    { }
+    { m_undo.owner = owner; }
 
-    SharemindTdbError execute() {
-        return m_exec();
-    }
+    SharemindTdbError execute();
 
-    void rollback() {
-        // TODO
-    }
+    void commit();
+    void rollback();
 
 private: /* Fields: */
 
+    TdbHdf5Connection & m_connection;
     std::function<SharemindTdbError ()> m_exec;
+    TdbHdf5Connection::UndoRecord m_undo;
+
 };
 
 class __attribute__ ((visibility("internal"))) TdbHdf5Module {
@@ -74,7 +79,8 @@ public: /* Methods: */
     TdbHdf5Module(const LogHard::Logger & logger,
                   SharemindDataSourceManager & dsManager,
                   SharemindTdbVectorMapUtil & mapUtil,
-                  SharemindConsensusFacility * consensusService);
+                  SharemindConsensusFacility * consensusService,
+                  const TdbHdf5ModuleConf & conf);
 
     bool setErrorCode(const SharemindModuleApi0x1SyscallContext * ctx,
             const std::string & dsName,
@@ -84,8 +90,12 @@ public: /* Methods: */
                         const std::string & dsName);
     bool closeConnection(const SharemindModuleApi0x1SyscallContext * ctx,
                          const std::string & dsName);
+    bool warmUp(const TdbHdf5ModuleConf & conf);
+    /* Also gives the owner of the temporary tables of the calling process,
+       to be passed on to the operations on the connection: */
     TdbHdf5Connection * getConnection(const SharemindModuleApi0x1SyscallContext * ctx,
-                                      const std::string & dsName) const;
+                                      const std::string & dsName,
+                                      const void * & owner) const;
 
     SharemindTdbVectorMap * newVectorMap(const SharemindModuleApi0x1SyscallContext * ctx,
                                          uint64_t & vmapId);
@@ -103,6 +113,10 @@ public: /* Methods: */
     inline SharemindTdbVectorMapUtil & vectorMapUtil() { return m_mapUtil; }
     inline const SharemindTdbVectorMapUtil & vectorMapUtil() const { return m_mapUtil; }
 
+private: /* Methods: */
+
+    TdbHdf5ConnectionConf * getConfiguration(const std::string & dsName);
+
 private: /* Fields: */
 
     const LogHard::Logger m_logger;
@@ -117,6 +131,9 @@ private: /* Fields: */
     std::mutex m_dsConfMutex;
     std::map<std::string, std::unique_ptr<TdbHdf5ConnectionConf> > m_dsConf;
 
+    /* Connections opened at module initialization: */
+    std::vector<std::shared_ptr<TdbHdf5Connection> > m_warmConnections;
+
 }; /* class TdbHdf5Module { */
 
 } /* namespace sharemind { */
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2015-2017 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "TdbHdf5ModuleConf.h"
+
+#include <sharemind/libconfiguration/Configuration.h>
+#include <sstream>
+
+
+namespace sharemind {
+
+TdbHdf5ModuleConf::TdbHdf5ModuleConf() = default;
+
+TdbHdf5ModuleConf::TdbHdf5ModuleConf(std::string const & filename) {
+    Configuration const conf(filename);
+
+    /* Data sources to open at module initialization, given as a
+       whitespace-separated list: */
+    std::istringstream warmUpDataSources(
+                conf.get<std::string>("WarmUpDataSources", std::string()));
+    for (std::string dsName; warmUpDataSources >> dsName;)
+        m_warmUpDataSources.emplace_back(std::move(dsName));
+
+    /* Upper bound on the connections kept open with no process using them,
+       see the KeepAliveTimeout data source option: */
+    m_maxRetainedConnections =
+            conf.get<std::size_t>("MaxRetainedConnections",
+                                  m_maxRetainedConnections);
+}
+
+} /* namespace sharemind { */
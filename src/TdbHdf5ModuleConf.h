@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2015-2017 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5MODULECONF_H
+#define SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5MODULECONF_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace sharemind {
+
+class __attribute__ ((visibility("internal"))) TdbHdf5ModuleConf {
+
+public: /* Methods: */
+
+    TdbHdf5ModuleConf();
+    TdbHdf5ModuleConf(std::string const & filename);
+
+    std::vector<std::string> const & warmUpDataSources() const noexcept
+    { return m_warmUpDataSources; }
+
+    std::size_t maxRetainedConnections() const noexcept
+    { return m_maxRetainedConnections; }
+
+private: /* Fields: */
+
+    std::vector<std::string> m_warmUpDataSources;
+    std::size_t m_maxRetainedConnections = 16u;
+
+}; /* class TdbHdf5ModuleConf { */
+
+} /* namespace sharemind */
+
+#endif /* SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5MODULECONF_H */
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "TdbHdf5Storage.h"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+
+
+namespace fs = boost::filesystem;
+
+#define FNV_OFFSET_BASIS       (UINT64_C(14695981039346656037))
+#define FNV_PRIME              (UINT64_C(1099511628211))
+#define PARTITIONS_DIR_EXT     ".parts"
+
+namespace {
+
+/* FNV-1a, as the locations of the tables must not change between runs: */
+std::uint64_t nameHash(const std::string & tbl) {
+    std::uint64_t hash = FNV_OFFSET_BASIS;
+    for (const char c : tbl) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= FNV_PRIME;
+    }
+
+    // Mix the bits, as the upper bits of FNV-1a barely differ for similar
+    // names (the MurmurHash3 finalizer)
+    hash ^= hash >> 33u;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33u;
+    hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 33u;
+    return hash;
+}
+
+std::string hexByte(const std::uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    return std::string{digits[(value >> 4u) & 0xfu], digits[value & 0xfu]};
+}
+
+bool isHexByte(const std::string & name) {
+    return name.size() == 2u
+            && std::isxdigit(static_cast<unsigned char>(name[0u]))
+            && std::isxdigit(static_cast<unsigned char>(name[1u]));
+}
+
+} /* namespace { */
+
+namespace sharemind {
+
+TdbHdf5Storage::TdbHdf5Storage(const LogHard::Logger & logger,
+                               const fs::path & path,
+                               const std::vector<std::string> & storagePaths,
+                               const Placement placement,
+                               const Layout layout,
+                               const std::string & tableFileExtension,
+                               const bool migrate)
+    : m_logger(logger, "[TdbHdf5Storage]")
+    , m_paths(1u, path)
+    , m_placement(placement)
+    , m_layout(layout)
+    , m_tableFileExtension(tableFileExtension)
+{
+    for (auto const & storagePath : storagePaths) {
+        fs::path p(fs::canonical(storagePath));
+        if (std::find(m_paths.begin(), m_paths.end(), p) != m_paths.end()) {
+            m_logger.warning() << "Ignoring duplicate storage path "
+                               << p.string() << '.';
+            continue;
+        }
+        m_paths.emplace_back(std::move(p));
+    }
+
+    if (m_layout == Layout::Hashed && migrate) {
+        for (std::size_t i = 0u; i < m_paths.size(); ++i)
+            migrateToHashedLayout(i);
+    }
+}
+
+fs::path TdbHdf5Storage::tablePath(const std::string & tbl) {
+    assert(!tbl.empty());
+
+    if (m_paths.size() == 1u)
+        return makePath(0u, tbl);
+
+    auto const it(m_tablePaths.find(tbl));
+    if (it != m_tablePaths.end())
+        return makePath(it->second, tbl);
+
+    // Look in the path the table would be placed in first
+    const std::size_t first =
+            m_placement == Placement::Hash ? hashedPath(tbl) : 0u;
+    for (std::size_t i = 0u; i < m_paths.size(); ++i) {
+        const std::size_t path = (first + i) % m_paths.size();
+        fs::path p(makePath(path, tbl));
+
+        boost::system::error_code ec;
+        if (fs::exists(p, ec)) {
+            m_tablePaths.emplace(tbl, path);
+            return p;
+        }
+    }
+
+    return makePath(first, tbl);
+}
+
+fs::path TdbHdf5Storage::placeTable(const std::string & tbl) {
+    assert(!tbl.empty());
+
+    std::size_t path = 0u;
+    switch (m_placement) {
+        case Placement::Hash:
+            path = hashedPath(tbl);
+            break;
+        case Placement::RoundRobin:
+            path = m_nextPath;
+            m_nextPath = (m_nextPath + 1u) % m_paths.size();
+            break;
+        case Placement::FreeSpace: {
+            boost::uintmax_t maxAvailable = 0u;
+            for (std::size_t i = 0u; i < m_paths.size(); ++i) {
+                boost::system::error_code ec;
+                const fs::space_info info(fs::space(m_paths[i], ec));
+                if (ec) {
+                    m_logger.warning() << "Failed to get the available space "
+                                          "in storage path "
+                                       << m_paths[i].string() << ": "
+                                       << ec.message() << '.';
+                } else if (info.available > maxAvailable) {
+                    maxAvailable = info.available;
+                    path = i;
+                }
+            }
+            break;
+        }
+    }
+
+    m_tablePaths[tbl] = path;
+
+    fs::path p(makePath(path, tbl));
+    if (m_layout == Layout::Hashed) {
+        boost::system::error_code ec;
+        fs::create_directories(p.parent_path(), ec);
+        if (ec)
+            m_logger.warning() << "Failed to create directory "
+                               << p.parent_path().string() << ": "
+                               << ec.message() << '.';
+    }
+
+    return p;
+}
+
+void TdbHdf5Storage::forgetTable(const std::string & tbl) {
+    m_tablePaths.erase(tbl);
+}
+
+void TdbHdf5Storage::tableFiles(std::map<std::string, fs::path> & files) const {
+    for (auto const & path : m_paths) {
+        if (m_layout == Layout::Flat) {
+            addTableFiles(path, files);
+            continue;
+        }
+
+        for (fs::directory_iterator it(path);
+             it != fs::directory_iterator();
+             ++it)
+        {
+            if (!isHexByte(it->path().filename().string())
+                || !fs::is_directory(it->status()))
+                continue;
+
+            for (fs::directory_iterator it2(it->path());
+                 it2 != fs::directory_iterator();
+                 ++it2)
+            {
+                if (isHexByte(it2->path().filename().string())
+                    && fs::is_directory(it2->status()))
+                    addTableFiles(it2->path(), files);
+            }
+        }
+    }
+}
+
+fs::path TdbHdf5Storage::partitionsPath(const fs::path & tblPath) {
+    fs::path path(tblPath);
+    path += PARTITIONS_DIR_EXT;
+    return path;
+}
+
+std::size_t TdbHdf5Storage::hashedPath(const std::string & tbl) const
+{ return static_cast<std::size_t>(nameHash(tbl) % m_paths.size()); }
+
+fs::path TdbHdf5Storage::makePath(const std::size_t path,
+                                  const std::string & tbl) const
+{
+    assert(path < m_paths.size());
+    fs::path p(m_paths[path]);
+
+    // Take the subdirectories from the upper bits of the hash, as the lower
+    // bits choose the storage path
+    if (m_layout == Layout::Hashed) {
+        const std::uint64_t hash = nameHash(tbl);
+        p /= hexByte(hash >> 56u);
+        p /= hexByte(hash >> 48u);
+    }
+
+    p /= tbl + m_tableFileExtension;
+    return p;
+}
+
+void TdbHdf5Storage::addTableFiles(const fs::path & dir,
+        std::map<std::string, fs::path> & files) const
+{
+    for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it) {
+        const fs::path & filepath = it->path();
+        if (filepath.extension().string() != m_tableFileExtension)
+            continue;
+
+        if (!files.emplace(filepath.stem().string(), filepath).second)
+            m_logger.warning() << "Ignoring duplicate table file "
+                               << filepath.string() << '.';
+    }
+}
+
+void TdbHdf5Storage::migrateToHashedLayout(const std::size_t path) {
+    assert(m_layout == Layout::Hashed);
+
+    // Collect the files first, as renaming invalidates the iterator
+    std::map<std::string, fs::path> files;
+    addTableFiles(m_paths[path], files);
+    if (files.empty())
+        return;
+
+    m_logger.fullDebug() << "Moving " << files.size() << " table files in "
+                         << m_paths[path].string()
+                         << " to the hashed layout.";
+
+    std::size_t moved = 0u;
+    for (auto const & vp : files) {
+        const fs::path newPath(makePath(path, vp.first));
+        try {
+            if (fs::exists(newPath)) {
+                m_logger.error() << "Not moving table file "
+                                 << vp.second.string() << ": "
+                                 << newPath.string() << " already exists.";
+                continue;
+            }
+
+            fs::create_directories(newPath.parent_path());
+
+            // Move the partitions first, so that an interrupted move is
+            // completed on the next run
+            const fs::path partsPath(partitionsPath(vp.second));
+            if (fs::exists(partsPath))
+                fs::rename(partsPath, partitionsPath(newPath));
+
+            fs::rename(vp.second, newPath);
+            ++moved;
+        } catch (const fs::filesystem_error & e) {
+            m_logger.error() << "Failed to move table file "
+                             << vp.second.string() << ": " << e.what() << '.';
+        }
+    }
+
+    m_logger.fullDebug() << "Moved " << moved << " table files in "
+                         << m_paths[path].string()
+                         << " to the hashed layout.";
+}
+
+} /* namespace sharemind { */
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5STORAGE_H
+#define SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5STORAGE_H
+
+#include <boost/filesystem/path.hpp>
+#include <cstddef>
+#include <LogHard/Logger.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "TdbHdf5ConnectionConf.h"
+
+
+namespace sharemind {
+
+/*
+  Locations of the table files of a data source. The table files may be spread
+  over several storage paths, in which case new tables are placed according to
+  the configured policy and existing tables are looked up in all of them. With
+  the hashed layout, the table files of a storage path are kept in two levels of
+  subdirectories to keep the directories small.
+*/
+class __attribute__ ((visibility("internal"))) TdbHdf5Storage {
+
+public: /* Types: */
+
+    typedef TdbHdf5ConnectionConf::StoragePlacement Placement;
+    typedef TdbHdf5ConnectionConf::StorageLayout Layout;
+
+public: /* Methods: */
+
+    TdbHdf5Storage(const LogHard::Logger & logger,
+                   const boost::filesystem::path & path,
+                   const std::vector<std::string> & storagePaths,
+                   const Placement placement,
+                   const Layout layout,
+                   const std::string & tableFileExtension,
+                   const bool migrate);
+
+    TdbHdf5Storage(const TdbHdf5Storage &) = delete;
+    TdbHdf5Storage & operator=(const TdbHdf5Storage &) = delete;
+
+    const boost::filesystem::path & path() const noexcept
+    { return m_paths.front(); }
+
+    boost::filesystem::path tablePath(const std::string & tbl);
+    boost::filesystem::path placeTable(const std::string & tbl);
+    void forgetTable(const std::string & tbl);
+
+    void tableFiles(
+            std::map<std::string, boost::filesystem::path> & files) const;
+
+    static boost::filesystem::path partitionsPath(
+            const boost::filesystem::path & tblPath);
+
+private: /* Methods: */
+
+    std::size_t hashedPath(const std::string & tbl) const;
+    boost::filesystem::path makePath(const std::size_t path,
+                                     const std::string & tbl) const;
+    void addTableFiles(const boost::filesystem::path & dir,
+            std::map<std::string, boost::filesystem::path> & files) const;
+    void migrateToHashedLayout(const std::size_t path);
+
+private: /* Fields: */
+
+    const LogHard::Logger m_logger;
+
+    /* The database path, followed by the additional storage paths: */
+    std::vector<boost::filesystem::path> m_paths;
+    const Placement m_placement;
+    const Layout m_layout;
+    const std::string m_tableFileExtension;
+
+    /* Storage path indexes of the tables looked up or placed so far: */
+    std::map<std::string, std::size_t> m_tablePaths;
+    std::size_t m_nextPath = 0u;
+
+}; /* class TdbHdf5Storage { */
+
+} /* namespace sharemind { */
+
+#endif // SHAREMIND_MOD_TABLEDB_HDF5_TDBHDF5STORAGE_H
@@ -18,6 +18,9 @@
  */
 
 #include <cassert>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <new>
 #include <sstream>
 #include <string>
@@ -30,6 +33,7 @@
 #include <sharemind/module-apis/api_0x1.h>
 #include "TdbHdf5Connection.h"
 #include "TdbHdf5Module.h"
+#include "TdbHdf5ModuleConf.h"
 
 
 namespace {
@@ -94,6 +98,68 @@ template <typename T>
 std::string refToString(T const & ref)
 { return std::string(static_cast<char const *>(ref.pData), ref.size - 1u); }
 
+/* Gets an optional single string parameter, value is left unchanged if the
+   parameter is not set: */
+bool getStringOption(const LogHard::Logger & logger,
+                     SharemindTdbVectorMap * const pmap,
+                     char const * const name,
+                     char const *& value)
+{
+    bool rv = false;
+    if (pmap->is_string_vector(pmap, name, &rv) != TDB_VECTOR_MAP_OK || !rv)
+        return true;
+
+    SharemindTdbString ** strings;
+    size_t size = 0u;
+    if (pmap->get_string_vector(pmap, name, &strings, &size)
+        != TDB_VECTOR_MAP_OK)
+    {
+        logger.error() << "Failed to get \"" << name << "\" string vector "
+                          "parameter.";
+        return false;
+    }
+
+    if (size != 1u) {
+        logger.error() << "Expected a single \"" << name << "\" string "
+                          "parameter.";
+        return false;
+    }
+
+    value = strings[0u]->str;
+    return true;
+}
+
+/* Gets an optional single index parameter, value is left unchanged if the
+   parameter is not set: */
+bool getIndexOption(const LogHard::Logger & logger,
+                    SharemindTdbVectorMap * const pmap,
+                    char const * const name,
+                    uint64_t & value)
+{
+    bool rv = false;
+    if (pmap->is_index_vector(pmap, name, &rv) != TDB_VECTOR_MAP_OK || !rv)
+        return true;
+
+    SharemindTdbIndex ** indexes;
+    size_t size = 0u;
+    if (pmap->get_index_vector(pmap, name, &indexes, &size)
+        != TDB_VECTOR_MAP_OK)
+    {
+        logger.error() << "Failed to get \"" << name << "\" index vector "
+                          "parameter.";
+        return false;
+    }
+
+    if (size != 1u) {
+        logger.error() << "Expected a single \"" << name << "\" index "
+                          "parameter.";
+        return false;
+    }
+
+    value = indexes[0u]->idx;
+    return true;
+}
+
 } // anonymous namespace
 
 MOD_TABLEDB_HDF5_SYSCALL(tdb_open) {
@@ -172,7 +238,8 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_create) {
         auto & m = GETMODULEHANDLE;
 
         // Get the connection
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
@@ -216,10 +283,12 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_create) {
 
         // Execute the transaction
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::tblCreate,
                                        std::cref(tblName),
                                        std::cref(namesVec),
-                                       std::cref(typesVec));
+                                       std::cref(typesVec),
+                                       TdbHdf5Connection::TableOptions());
         const SharemindTdbError ecode = m.executeTransaction(transaction, c);
 
         if (!m.setErrorCode(c, dsName, ecode))
@@ -290,17 +359,153 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_create2) {
 
         const std::vector<SharemindTdbType *> typesVec(types, types + size);
 
+        // Parse the optional table options
+        TdbHdf5Connection::TableOptions options;
+
+        char const * layout = nullptr;
+        if (!getStringOption(m.logger(), pmap, "layout", layout))
+            return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+
+        if (layout) {
+            if (std::strcmp(layout, "column") == 0) {
+                options.layout = TdbHdf5Connection::TableLayout::ColumnDatasets;
+            } else if (std::strcmp(layout, "type") != 0) {
+                m.logger().error() << "Unknown table layout \"" << layout
+                                   << "\".";
+                return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+            }
+        }
+
+        char const * chunking = nullptr;
+        if (!getStringOption(m.logger(), pmap, "chunking", chunking))
+            return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+
+        if (chunking) {
+            if (std::strcmp(chunking, "row") == 0) {
+                options.chunkLayout = TdbHdf5Connection::ChunkLayout::Rows;
+            } else if (std::strcmp(chunking, "column") != 0) {
+                m.logger().error() << "Unknown chunk layout \"" << chunking
+                                   << "\".";
+                return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+            }
+        }
+
+        char const * vlen = nullptr;
+        if (!getStringOption(m.logger(), pmap, "vlen", vlen))
+            return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+
+        if (vlen) {
+            if (std::strcmp(vlen, "heap") == 0) {
+                options.vlenLayout = TdbHdf5Connection::VlenLayout::Heap;
+            } else if (std::strcmp(vlen, "offsets") != 0) {
+                m.logger().error() << "Unknown variable length value layout \""
+                                   << vlen << "\".";
+                return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+            }
+        }
+
+        char const * bits = nullptr;
+        if (!getStringOption(m.logger(), pmap, "bits", bits))
+            return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+
+        if (bits) {
+            if (std::strcmp(bits, "packed") == 0) {
+                options.packBits = true;
+            } else if (std::strcmp(bits, "unpacked") != 0) {
+                m.logger().error() << "Unknown bit value layout \"" << bits
+                                   << "\".";
+                return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+            }
+        }
+
+        uint64_t partitionRows = 0u;
+        if (!getIndexOption(m.logger(), pmap, "partitionRows", partitionRows))
+            return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+
+        options.partitionRows = partitionRows;
+
+        char const * lifetime = nullptr;
+        if (!getStringOption(m.logger(), pmap, "lifetime", lifetime))
+            return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+
+        if (lifetime) {
+            if (std::strcmp(lifetime, "temporary") == 0) {
+                options.temporary = true;
+            } else if (std::strcmp(lifetime, "persistent") != 0) {
+                m.logger().error() << "Unknown table lifetime \"" << lifetime
+                                   << "\".";
+                return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+            }
+        }
+
+        uint64_t spillRows = 0u;
+        if (!getIndexOption(m.logger(), pmap, "spillRows", spillRows))
+            return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+
+        options.spillRows = spillRows;
+
+        // Parse the optional "encodings" parameter, either one per column or
+        // a single one for all columns
+        bool haveEncodings = false;
+        if (pmap->is_string_vector(pmap, "encodings", &haveEncodings)
+                == TDB_VECTOR_MAP_OK
+            && haveEncodings)
+        {
+            SharemindTdbString ** encodings;
+            if (pmap->get_string_vector(pmap, "encodings", &encodings, &size)
+                != TDB_VECTOR_MAP_OK)
+            {
+                m.logger().error() << "Failed to get \"encodings\" string "
+                                      "vector parameter.";
+                return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+            }
+
+            if (size != 1u && size != typesVec.size()) {
+                m.logger().error() << "Expected a single \"encodings\" string "
+                                      "parameter or one per column.";
+                return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+            }
+
+            using E = TdbHdf5Connection::ColumnEncoding;
+            for (size_t i = 0u; i < size; ++i) {
+                char const * const encoding = encodings[i]->str;
+                E e;
+                if (std::strcmp(encoding, "none") == 0) {
+                    e = E::None;
+                } else if (std::strcmp(encoding, "auto") == 0) {
+                    e = E::Auto;
+                } else if (std::strcmp(encoding, "dictionary") == 0) {
+                    e = E::Dictionary;
+                } else if (std::strcmp(encoding, "delta") == 0) {
+                    e = E::Delta;
+                } else if (std::strcmp(encoding, "for") == 0) {
+                    e = E::FrameOfReference;
+                } else {
+                    m.logger().error() << "Unknown column encoding \""
+                                       << encoding << "\".";
+                    return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+                }
+                options.encodings.push_back(e);
+            }
+
+            if (size == 1u)
+                options.encodings.resize(typesVec.size(), options.encodings[0u]);
+        }
+
         // Get the connection
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
         // Execute transaction
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::tblCreate,
                                        std::cref(tblName),
                                        std::cref(namesVec),
-                                       std::cref(typesVec));
+                                       std::cref(typesVec),
+                                       options);
         const SharemindTdbError ecode = m.executeTransaction(transaction, c);
 
         if (!m.setErrorCode(c, dsName, ecode))
@@ -337,12 +542,14 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_delete) {
 
         auto & m = GETMODULEHANDLE;
 
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
         // Execute the transaction
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::tblDelete,
                                        std::cref(tblName));
         const SharemindTdbError ecode = m.executeTransaction(transaction, c);
@@ -365,6 +572,54 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_delete) {
     }
 }
 
+MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_compact) {
+    assert(c);
+    (void) args;
+    if (!CHECKARGS(0u, false, 0u, 2u) && !CHECKARGS(0u, false, 1u, 2u))
+        return SHAREMIND_MODULE_API_0x1_INVALID_CALL;
+
+    if (refs && refs[0u].size != sizeof(int64_t))
+        return SHAREMIND_MODULE_API_0x1_INVALID_CALL;
+
+    if (!haveNtcsRefs(crefs, 2u))
+        return SHAREMIND_MODULE_API_0x1_INVALID_CALL;
+
+    try {
+        auto const dsName(refToString(crefs[0u]));
+        auto const tblName(refToString(crefs[1u]));
+
+        auto & m = GETMODULEHANDLE;
+
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
+        if (!conn)
+            return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+
+        // Execute the transaction
+        TdbHdf5Transaction transaction(*conn,
+                                       owner,
+                                       &TdbHdf5Connection::tblCompact,
+                                       std::cref(tblName));
+        const SharemindTdbError ecode = m.executeTransaction(transaction, c);
+
+        if (!m.setErrorCode(c, dsName, ecode))
+            return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+
+        if (refs) {
+            *static_cast<int64_t *>(refs[0u].pData) = ecode;
+        } else {
+            if (ecode != SHAREMIND_TDB_OK)
+                return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+        }
+
+        return SHAREMIND_MODULE_API_0x1_OK;
+    } catch (const std::bad_alloc &) {
+        return SHAREMIND_MODULE_API_0x1_OUT_OF_MEMORY;
+    } catch (...) {
+        return SHAREMIND_MODULE_API_0x1_MODULE_ERROR;
+    }
+}
+
 MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_exists) {
     assert(c);
     (void) args;
@@ -383,13 +638,15 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_exists) {
 
         auto & m = GETMODULEHANDLE;
 
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
         // Execute the transaction
         bool exists = false;
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::tblExists,
                                        std::cref(tblName),
                                        std::ref(exists));
@@ -436,13 +693,15 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_col_count) {
 
         auto & m = GETMODULEHANDLE;
 
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
         // Execute the transaction
         uint64_t count = 0;
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::tblColCount,
                                        std::cref(tblName),
                                        std::ref(count));
@@ -489,13 +748,15 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_col_names) {
 
         auto & m = GETMODULEHANDLE;
 
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
         // Execute the transaction
         std::vector<SharemindTdbString *> namesVec;
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::tblColNames,
                                        std::cref(tblName),
                                        std::ref(namesVec));
@@ -579,13 +840,15 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_col_types) {
 
         auto & m = GETMODULEHANDLE;
 
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
         // Execute the transaction
         std::vector<SharemindTdbType *> typesVec;
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::tblColTypes,
                                        std::cref(tblName),
                                        std::ref(typesVec));
@@ -669,13 +932,15 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_tbl_row_count) {
 
         auto & m = GETMODULEHANDLE;
 
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
         // Execute the transaction
         uint64_t count = 0;
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::tblRowCount,
                                        std::cref(tblName),
                                        std::ref(count));
@@ -739,7 +1004,8 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_insert_row) {
         auto & m = GETMODULEHANDLE;
 
         // Get the connection
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
@@ -763,13 +1029,17 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_insert_row) {
 
         const std::vector<std::vector<SharemindTdbValue *> > valuesBatch { {  val.get () } };
         const std::vector<bool> valueAsColumnBatch { valueAsColumn };
+        const std::vector<std::vector<TdbHdf5Connection::size_type> >
+                lengthsBatch(1u);
 
         // Execute the transaction
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::insertRow,
                                        std::cref(tblName),
                                        std::cref(valuesBatch),
-                                       std::cref(valueAsColumnBatch));
+                                       std::cref(valueAsColumnBatch),
+                                       std::cref(lengthsBatch));
         const SharemindTdbError ecode = m.executeTransaction(transaction, c);
 
         if (!m.setErrorCode(c, dsName, ecode))
@@ -827,6 +1097,8 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_insert_row2) {
         ValuesBatchVector valuesBatch(batchCount);
         std::vector<bool> valueAsColumnBatch;
         valueAsColumnBatch.reserve(batchCount);
+        std::vector<std::vector<TdbHdf5Connection::size_type> >
+                lengthsBatch(batchCount);
 
         // Process each parameter batch
         for (size_t i = 0; i < batchCount; ++i) {
@@ -880,19 +1152,47 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_insert_row2) {
                 // Set the default value
                 valueAsColumnBatch.push_back(false);
             }
+
+            // Check if the optional parameter "lengths" is set
+            rv = false;
+            if ((pmap->is_index_vector(pmap, "lengths", &rv)
+                 == TDB_VECTOR_MAP_OK)
+                && rv)
+            {
+                // Parse the "lengths" parameter
+                SharemindTdbIndex ** lengths;
+                if (pmap->get_index_vector(pmap,
+                                           "lengths",
+                                           &lengths,
+                                           &size) != TDB_VECTOR_MAP_OK)
+                {
+                    m.logger().error() << "Failed to get \"lengths\" index "
+                                          "vector parameter.";
+                    return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
+                }
+
+                std::vector<TdbHdf5Connection::size_type> & lengthsVec =
+                        lengthsBatch[i];
+                lengthsVec.reserve(size);
+                for (size_t j = 0u; j < size; ++j)
+                    lengthsVec.push_back(lengths[j]->idx);
+            }
         }
 
         // Get the connection
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
         // Execute transaction
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::insertRow,
                                        std::cref(tblName),
                                        std::cref(valuesBatch),
-                                       std::cref(valueAsColumnBatch));
+                                       std::cref(valueAsColumnBatch),
+                                       std::cref(lengthsBatch));
         const SharemindTdbError ecode = m.executeTransaction(transaction, c);
 
         if (!m.setErrorCode(c, dsName, ecode))
@@ -932,7 +1232,8 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_read_col) {
         auto & m = GETMODULEHANDLE;
 
         // Get the connection
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
@@ -955,11 +1256,13 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_read_col) {
             const std::vector<SharemindTdbIndex *> colIdBatch(1, idx);
 
             // Execute the transaction
-            typedef SharemindTdbError (TdbHdf5Connection::*ExecFunc)(const std::string &,
+            typedef SharemindTdbError (TdbHdf5Connection::*ExecFunc)(const void *,
+                                                                     const std::string &,
                                                                      const std::vector<SharemindTdbIndex *> &,
                                                                      std::vector<std::vector<SharemindTdbValue *> > &);
 
             TdbHdf5Transaction transaction(*conn,
+                                           owner,
                                            static_cast<ExecFunc>(&TdbHdf5Connection::readColumn),
                                            std::cref(tblName),
                                            std::cref(colIdBatch),
@@ -983,11 +1286,13 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_read_col) {
             const std::vector<SharemindTdbString *> colIdBatch(1, idx);
 
             // Execute the transaction
-            typedef SharemindTdbError (TdbHdf5Connection::*ExecFunc)(const std::string &,
+            typedef SharemindTdbError (TdbHdf5Connection::*ExecFunc)(const void *,
+                                                                     const std::string &,
                                                                      const std::vector<SharemindTdbString *> &,
                                                                      std::vector<std::vector<SharemindTdbValue *> > &);
 
             TdbHdf5Transaction transaction(*conn,
+                                           owner,
                                            static_cast<ExecFunc>(&TdbHdf5Connection::readColumn),
                                            std::cref(tblName),
                                            std::cref(colIdBatch),
@@ -1071,30 +1376,53 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_read_col) {
     }
 }
 
+/*
+  Optionally takes a table name prefix as the second constant reference and
+  an offset and a limit (0 for no limit) as arguments to page through the
+  names in lexicographical order.
+*/
 MOD_TABLEDB_HDF5_SYSCALL(tdb_table_names) {
     assert(c);
-    (void) args;
-    if (!CHECKARGS(0u, true, 0u, 1u) && !CHECKARGS(0u, true, 1u, 1u))
+    if (!CHECKARGS(0u, true, 0u, 1u) && !CHECKARGS(0u, true, 1u, 1u)
+        && !CHECKARGS(0u, true, 0u, 2u) && !CHECKARGS(0u, true, 1u, 2u)
+        && !CHECKARGS(2u, true, 0u, 2u) && !CHECKARGS(2u, true, 1u, 2u))
         return SHAREMIND_MODULE_API_0x1_INVALID_CALL;
 
     if (refs && refs[0u].size != sizeof(int64_t)) {
         return SHAREMIND_MODULE_API_0x1_INVALID_CALL;
     }
 
-    if (!haveNtcsRefs(crefs, 1u))
+    const bool havePrefix = crefs[1u].pData;
+    if (!haveNtcsRefs(crefs, havePrefix ? 2u : 1u))
         return SHAREMIND_MODULE_API_0x1_INVALID_CALL;
 
     try {
         auto const dsName(refToString(crefs[0u]));
+        auto const prefix(havePrefix ? refToString(crefs[1u]) : std::string());
+        const uint64_t offset = num_args == 2u ? args[0u].uint64[0u] : 0u;
+        const uint64_t limit = num_args == 2u && args[1u].uint64[0u]
+                             ? args[1u].uint64[0u]
+                             : std::numeric_limits<uint64_t>::max();
         auto & m = GETMODULEHANDLE;
 
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
         std::vector<SharemindTdbString *> namesVec;
+        typedef SharemindTdbError (TdbHdf5Connection::*ExecFunc)(const void *,
+                                                                 const std::string &,
+                                                                 const TdbHdf5Connection::size_type,
+                                                                 const TdbHdf5Connection::size_type,
+                                                                 std::vector<SharemindTdbString *> &);
+
         TdbHdf5Transaction transaction(*conn,
-                                       &TdbHdf5Connection::tblNames,
+                                       owner,
+                                       static_cast<ExecFunc>(&TdbHdf5Connection::tblNames),
+                                       std::cref(prefix),
+                                       offset,
+                                       limit,
                                        std::ref(namesVec));
         const SharemindTdbError ecode = m.executeTransaction(transaction, c);
 
@@ -1169,12 +1497,14 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_get_attributes) {
         auto const tblName(refToString(crefs[1u]));
         auto & m = GETMODULEHANDLE;
 
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
         std::vector<std::pair<SharemindTdbString *, SharemindTdbString *>> attributes;
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::getAttributes,
                                        std::ref(tblName),
                                        std::ref(attributes));
@@ -1258,7 +1588,8 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_set_attributes) {
         auto & m = GETMODULEHANDLE;
 
         // Get the connection
-        TdbHdf5Connection * const conn = m.getConnection(c, dsName);
+        const void * owner = nullptr;
+        TdbHdf5Connection * const conn = m.getConnection(c, dsName, owner);
         if (!conn)
             return SHAREMIND_MODULE_API_0x1_GENERAL_ERROR;
 
@@ -1296,6 +1627,7 @@ MOD_TABLEDB_HDF5_SYSCALL(tdb_set_attributes) {
 
         // Execute the transaction
         TdbHdf5Transaction transaction(*conn,
+                                       owner,
                                        &TdbHdf5Connection::setAttributes,
                                        std::cref(tblName),
                                        std::ref(attributes));
@@ -1358,15 +1690,38 @@ SHAREMIND_MODULE_API_0x1_INITIALIZER(c) {
     auto & mapUtil =
             *static_cast<SharemindTdbVectorMapUtil *>(fvmaputil->facility);
 
+    /*
+     * Parse the optional module configuration file
+     */
+    sharemind::TdbHdf5ModuleConf moduleConf;
+    if (c->conf && *c->conf) {
+        try {
+            moduleConf = sharemind::TdbHdf5ModuleConf(c->conf);
+        } catch (...) {
+            auto const loggerLock(logger.retrieveBackendLock());
+            logger.error() << "Failed to parse module configuration:";
+            logger.printCurrentException();
+            return SHAREMIND_MODULE_API_0x1_INVALID_MODULE_CONFIGURATION;
+        }
+    }
+
     /*
      * Initialize the module handle
      */
     try {
-        c->moduleHandle =
+        std::unique_ptr<sharemind::TdbHdf5Module> module(
                 new sharemind::TdbHdf5Module(logger,
                                              dataSourceManager,
                                              mapUtil,
-                                             consensusService);
+                                             consensusService,
+                                             moduleConf));
+
+        // Open the configured data sources and their hot tables, so that
+        // the first queries after a restart do not have to
+        if (!module->warmUp(moduleConf))
+            logger.warning() << "Failed to warm up some data sources.";
+
+        c->moduleHandle = module.release();
         return SHAREMIND_MODULE_API_0x1_OK;
     } catch (std::bad_alloc const &) {
         return SHAREMIND_MODULE_API_0x1_OUT_OF_MEMORY;
@@ -1397,6 +1752,7 @@ SHAREMIND_MODULE_API_0x1_SYSCALL_DEFINITIONS(
     , { "tdb_tbl_create",       &tdb_tbl_create }
     , { "tdb_tbl_create2",      &tdb_tbl_create2 }
     , { "tdb_tbl_delete",       &tdb_tbl_delete }
+    , { "tdb_tbl_compact",      &tdb_tbl_compact }
     , { "tdb_tbl_exists",       &tdb_tbl_exists }
     , { "tdb_tbl_col_count",    &tdb_tbl_col_count }
     , { "tdb_tbl_col_names",    &tdb_tbl_col_names }
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2015 Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+/*
+  Compacts tables of a data source while no server has it open:
+
+    sharemind-tabledb-hdf5-compact <data source configuration> <table>...
+
+  The configuration is the one of the data source in the module
+  configuration, e.g. /etc/sharemind/tabledb_hdf5-DS1.conf.
+*/
+
+#include <boost/filesystem.hpp>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <LogHard/Backend.h>
+#include <LogHard/CFileAppender.h>
+#include <LogHard/Logger.h>
+#include <memory>
+#include "TdbHdf5Connection.h"
+#include "TdbHdf5ConnectionConf.h"
+
+
+namespace fs = boost::filesystem;
+
+int main(int argc, char * argv[]) {
+    using sharemind::TdbHdf5Connection;
+    using sharemind::TdbHdf5ConnectionConf;
+
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <data source configuration> <table>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto backend(std::make_shared<LogHard::Backend>());
+    backend->addAppender(std::make_shared<LogHard::CFileAppender>(stderr));
+    const LogHard::Logger logger(backend, "[Compact]");
+
+    try {
+        const TdbHdf5ConnectionConf config(argv[1]);
+        TdbHdf5Connection conn(logger,
+                               fs::canonical(config.databasePath()),
+                               config);
+
+        int status = EXIT_SUCCESS;
+        for (int i = 2; i < argc; ++i) {
+            if (conn.tblCompact(nullptr, argv[i]) != SHAREMIND_TDB_OK) {
+                status = EXIT_FAILURE;
+                continue;
+            }
+
+            std::cout << "Compacted table \"" << argv[i] << "\"." << std::endl;
+        }
+
+        return status;
+    } catch (const std::exception & e) {
+        std::cerr << "Failed to open data source: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}